@@ -32,6 +32,8 @@
 #include "InternalClipboard.h"
 #include "FontSerializer.h"
 #include "FileUtils.h"
+#include "HelioTrace.h"
+#include "HelioProfiler.h"
 
 #include "MainLayout.h"
 #include "Document.h"
@@ -44,6 +46,7 @@
 #include "MainWindow.h"
 #include "Workspace.h"
 #include "RootTreeItem.h"
+#include "ProjectTreeItem.h"
 
 App::App()
 {
@@ -263,12 +266,169 @@ static void handleCrash(void *)
     App::Helio()->getSupervisor()->trackCrash();
 }
 
+// Runs the app initialisers with their dependencies declared explicitly:
+// background ones go to a thread pool as soon as their dependencies are done,
+// the others are run on the message thread, in the order they were added
+class StartupTasks final
+{
+public:
+
+    StartupTasks() : numRunningJobs(0) {}
+
+    void add(const String &name, const StringArray &dependencies,
+             bool inBackground, std::function<void()> function)
+    {
+        this->tasks.add(new Task({ name, dependencies, inBackground, std::move(function), false }));
+    }
+
+    void runAll()
+    {
+        ThreadPool pool(jlimit(1, 4, SystemStats::getNumCpus()));
+
+        while (true)
+        {
+            // if nothing was running during the scan, nothing could have been unblocked meanwhile
+            const int numJobsRunningBeforeScan = this->numRunningJobs.get();
+            bool hasPendingTasks = false;
+            bool hasStartedTasks = false;
+
+            for (auto task : this->tasks)
+            {
+                if (task->isStarted)
+                { continue; }
+
+                hasPendingTasks = true;
+
+                if (! this->dependenciesAreDone(*task))
+                { continue; }
+
+                task->isStarted = true;
+                hasStartedTasks = true;
+
+                if (task->inBackground)
+                {
+                    ++this->numRunningJobs;
+                    pool.addJob(new StartupJob(*this, *task), true);
+                }
+                else
+                {
+                    this->run(*task);
+                }
+            }
+
+            if (! hasPendingTasks)
+            {
+                break;
+            }
+
+            if (! hasStartedTasks)
+            {
+                if (numJobsRunningBeforeScan == 0)
+                {
+                    jassertfalse; // circular or missing dependency
+                    break;
+                }
+
+                this->taskDone.wait();
+            }
+        }
+
+        while (this->numRunningJobs.get() > 0)
+        {
+            this->taskDone.wait();
+        }
+    }
+
+private:
+
+    struct Task final
+    {
+        String name;
+        StringArray dependencies;
+        bool inBackground;
+        std::function<void()> function;
+        bool isStarted;
+    };
+
+    class StartupJob final : public ThreadPoolJob
+    {
+    public:
+
+        StartupJob(StartupTasks &owner, Task &task) :
+            ThreadPoolJob(task.name), owner(owner), task(task) {}
+
+        JobStatus runJob() override
+        {
+            this->owner.run(this->task);
+            --this->owner.numRunningJobs;
+            this->owner.taskDone.signal();
+            return jobHasFinished;
+        }
+
+    private:
+
+        StartupTasks &owner;
+        Task &task;
+
+        JUCE_DECLARE_NON_COPYABLE(StartupJob)
+    };
+
+    void run(Task &task)
+    {
+        {
+            HELIO_TRACE_SCOPE(task.name);
+            task.function();
+        }
+
+        const ScopedLock lock(this->doneTasksLock);
+        this->doneTasks.add(task.name);
+    }
+
+    bool dependenciesAreDone(const Task &task) const
+    {
+        const ScopedLock lock(this->doneTasksLock);
+
+        for (const auto &dependency : task.dependencies)
+        {
+            if (! this->doneTasks.contains(dependency))
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    OwnedArray<Task> tasks;
+
+    StringArray doneTasks;
+    CriticalSection doneTasksLock;
+
+    Atomic<int> numRunningJobs;
+    WaitableEvent taskDone;
+
+    JUCE_DECLARE_NON_COPYABLE(StartupTasks)
+};
+
 void App::initialise(const String &commandLine)
 {
     this->runMode = detectRunMode(commandLine);
 
     if (this->runMode == App::NORMAL)
     {
+        if (commandLine.contains("--trace-startup"))
+        {
+            HelioTrace::start(FileUtils::getConfigSlot("startup.json"));
+        }
+
+        // Frame times and per-component timings overlay, see MainLayout
+        if (commandLine.contains("--profile-ui"))
+        {
+            HelioProfiler::start(FileUtils::getConfigSlot("ui-profile.json"));
+        }
+        
+        HELIO_TRACE_SCOPE("App::initialise");
+        
         SystemStats::setApplicationCrashHandler(handleCrash);
         
         Desktop::getInstance().setOrientationsEnabled(Desktop::rotatedClockwise + Desktop::rotatedAntiClockwise);
@@ -280,23 +440,71 @@ void App::initialise(const String &commandLine)
         
         Logger::writeToLog(this->collectSomeSystemInfo());
         
-        this->config = new Config();
-        this->supervisor = new Supervisor();
-        this->updater = new UpdateManager();
-
-        this->theme = new HelioTheme();
-        this->theme->initResources();
-        LookAndFeel::setDefaultLookAndFeel(this->theme);
-
-        this->authorizationManager = new AuthorizationManager();
-        this->clipboard = new InternalClipboard();
-
-        TranslationManager::getInstance().initialise(commandLine);
-        ArpeggiatorsManager::getInstance().initialise(commandLine);
-        ColourSchemeManager::getInstance().initialise(commandLine);
+        StartupTasks startup;
+        
+        startup.add("Config", {}, true, [this]()
+        {
+            this->config = new Config();
+        });
+        
+        startup.add("Supervisor", { "Config" }, true, [this]()
+        {
+            this->supervisor = new Supervisor();
+        });
+        
+        startup.add("UpdateManager", {}, false, [this]()
+        {
+            this->updater = new UpdateManager();
+        });
+        
+        // fonts and built-in icons
+        startup.add("HelioTheme", {}, true, [this]()
+        {
+            this->theme = new HelioTheme();
+            this->theme->initResources();
+        });
+        
+        startup.add("LookAndFeel", { "HelioTheme" }, false, [this]()
+        {
+            LookAndFeel::setDefaultLookAndFeel(this->theme);
+        });
+        
+        startup.add("AuthorizationManager", { "Config" }, false, [this]()
+        {
+            this->authorizationManager = new AuthorizationManager();
+        });
+        
+        startup.add("InternalClipboard", {}, false, [this]()
+        {
+            this->clipboard = new InternalClipboard();
+        });
+        
+        startup.add("Translations", { "Config" }, true, [&commandLine]()
+        {
+            TranslationManager::getInstance().initialise(commandLine);
+        });
+        
+        startup.add("Arpeggiators", { "Config" }, true, [&commandLine]()
+        {
+            ArpeggiatorsManager::getInstance().initialise(commandLine);
+        });
+        
+        startup.add("ColourSchemes", { "Config" }, true, [&commandLine]()
+        {
+            ColourSchemeManager::getInstance().initialise(commandLine);
+        });
+        
+        startup.runAll();
 
-        this->workspace = new class Workspace();
-        this->window = new MainWindow();
+        {
+            HELIO_TRACE_SCOPE("Workspace");
+            this->workspace = new class Workspace();
+        }
+        
+        {
+            HELIO_TRACE_SCOPE("MainWindow");
+            this->window = new MainWindow();
+        }
         
         TranslationManager::getInstance().addChangeListener(this);
         
@@ -304,11 +512,24 @@ void App::initialise(const String &commandLine)
 #if HELIO_MOBILE
         App::Workspace().init();
         App::Layout().init();
+        HelioTrace::flush();
 #endif
     }
+    else if (this->runMode == App::MIDI_EXPORT)
+    {
+        // Headless, like the plugin check: no windows and no audio devices,
+        // and the workspace is never initialized, so it is not loaded or autosaved
+        this->config = new Config();
+        this->workspace = new class Workspace();
+
+        const bool exportedOk = this->exportMidi(commandLine);
+        this->setApplicationReturnValue(exportedOk ? 0 : 1);
+        this->quit();
+    }
     else if (this->runMode == App::PLUGIN_CHECK)
     {
-        this->checkPlugin(commandLine);
+        const bool checkedOk = this->checkPlugin(commandLine);
+        this->setApplicationReturnValue(checkedOk ? 0 : 1);
         this->quit();
     }
     else if (this->runMode == App::FONT_SERIALIZE)
@@ -326,6 +547,7 @@ void App::shutdown()
         TranslationManager::getInstance().removeChangeListener(this);
 
         Logger::writeToLog("App::shutdown");
+        HelioProfiler::flush();
 
         this->window = nullptr;
         this->workspace = nullptr;
@@ -351,6 +573,11 @@ void App::shutdown()
         
         Logger::setCurrentLogger(nullptr);
     }
+    else if (this->runMode == App::MIDI_EXPORT)
+    {
+        this->workspace = nullptr;
+        this->config = nullptr;
+    }
     else if (this->runMode == App::PLUGIN_CHECK)
     {
 
@@ -535,76 +762,165 @@ String App::getMacAddressList()
 
 App::RunMode App::detectRunMode(const String &commandLine)
 {
-    if (commandLine != "")
+    // whole arguments only: a plugin path or a project name
+    // may well contain something like "-f" or "-F"
+    StringArray args;
+    args.addTokens(commandLine, true);
+
+    if (args.contains("--scan-plugin"))
     {
-        if (commandLine.contains("-F") && commandLine.contains("-f"))
+        return App::PLUGIN_CHECK;
+    }
+
+    if (args.contains("--export-midi"))
+    {
+        return App::MIDI_EXPORT;
+    }
+
+    if (args.contains("-F") && args.contains("-f"))
+    {
+        return App::FONT_SERIALIZE;
+    }
+
+    return App::NORMAL;
+}
+
+// A headless project only needs an orchestra to link its tracks with,
+// and there are no instruments to play anything when exporting
+class HeadlessOrchestra final : public OrchestraPit
+{
+public:
+
+    Array<Instrument *> getInstruments() const override
+    { return {}; }
+
+    Instrument *findInstrumentById(const String &id) const override
+    { return nullptr; }
+
+};
+
+static void printToConsole(FILE *stream, const String &message)
+{
+    const String line(message + "\n");
+    fwrite(line.toRawUTF8(), 1, line.getNumBytesAsUTF8(), stream);
+    fflush(stream);
+}
+
+// Usage: --export-midi project1.hp project2.hp ...
+// Writes a midi file next to each of the given projects;
+// the projects are loaded on their own, without the user's workspace,
+// and the result is non-zero, if any of them has failed
+bool App::exportMidi(const String &commandLine)
+{
+    StringArray args;
+    args.addTokens(commandLine, true);
+
+    HeadlessOrchestra orchestra;
+    bool allExported = true;
+    int numProjects = 0;
+
+    for (const auto &arg : args)
+    {
+        if (arg.startsWith("-"))
+        { continue; }
+
+        numProjects++;
+
+        const File projectFile(File::getCurrentWorkingDirectory().getChildFile(arg.unquoted()));
+
+        if (! projectFile.existsAsFile())
+        {
+            printToConsole(stderr, "Project not found: " + projectFile.getFullPathName());
+            allExported = false;
+            continue;
+        }
+
+        ScopedPointer<ProjectTreeItem> project(new ProjectTreeItem(projectFile, orchestra));
+
+        if (! project->getDocument()->load(projectFile.getFullPathName()))
         {
-            return App::FONT_SERIALIZE;
+            printToConsole(stderr, "Failed to open project: " + projectFile.getFullPathName());
+            allExported = false;
+            continue;
         }
-        if (FileUtils::getTempSlot(commandLine).existsAsFile())
+
+        File midiFile(projectFile.withFileExtension("mid"));
+
+        if (project->exportMidi(midiFile))
         {
-            return App::PLUGIN_CHECK;
+            printToConsole(stdout, "Exported: " + midiFile.getFullPathName());
+        }
+        else
+        {
+            printToConsole(stderr, "Failed to export: " + midiFile.getFullPathName());
+            allExported = false;
         }
     }
 
-    return App::NORMAL;
+    if (numProjects == 0)
+    {
+        printToConsole(stderr, "Usage: --export-midi project1.hp project2.hp ...");
+        return false;
+    }
+
+    return allExported;
 }
 
-void App::checkPlugin(const String &markerFile)
+// Usage: --scan-plugin "path or identifier"
+// Prints found plugin descriptions to stdout, which is read by PluginManager through a pipe;
+// plugins may print their own stuff there too, so the results are wrapped with markers.
+// If the plugin crashes or hangs, only this process dies
+bool App::checkPlugin(const String &commandLine)
 {
 #if JUCE_MAC
     Process::setDockIconVisible(false);
 #endif
 
-    const File tempFile(FileUtils::getTemporaryFolder() + File::separatorString + markerFile);
+    StringArray args;
+    args.addTokens(commandLine, true);
+
+    const int flagIndex = args.indexOf("--scan-plugin");
+    const String pluginPath = args[flagIndex + 1].unquoted();
+
+    if (flagIndex < 0 || pluginPath.isEmpty())
+    {
+        return false;
+    }
 
     try
     {
-        if (tempFile.existsAsFile())
-        {
-            if (tempFile.getSize() < 32768)
-            {
-                const String pluginPath = tempFile.loadFileAsString();
+        KnownPluginList scanner;
+        OwnedArray<PluginDescription> typesFound;
 
-                // сразу удаляем файл, если плагин накосячит, хост об этом узнает
-                tempFile.deleteFile();
+        AudioPluginFormatManager formatManager;
+        AudioCore::initAudioFormats(formatManager);
 
-                const File pluginFile(pluginPath);
+        for (int i = 0; i < formatManager.getNumFormats(); ++i)
+        {
+            AudioPluginFormat *format = formatManager.getFormat(i);
+            scanner.scanAndAddFile(pluginPath, false, typesFound, *format);
+        }
 
-                //if (pluginFile.existsAsFile()) // может быть и id
-                {
-                    KnownPluginList scanner;
-                    OwnedArray<PluginDescription> typesFound;
-
-                    AudioPluginFormatManager formatManager;
-                    AudioCore::initAudioFormats(formatManager);
-
-                    for (int i = 0; i < formatManager.getNumFormats(); ++i)
-                    {
-                        AudioPluginFormat *format = formatManager.getFormat(i);
-                        scanner.scanAndAddFile(pluginPath, false, typesFound, *format);
-                    }
-
-                    // если мы дошли до сих пор, то все хорошо и плагин нас не обрушил
-                    // так и запишем.
-                    if (typesFound.size() != 0)
-                    {
-                        ScopedPointer<XmlElement> typesXml(new XmlElement(Serialization::Core::instrumentRoot));
-
-                        for (auto i : typesFound)
-                        {
-                            typesXml->addChildElement(i->createXml());
-                        }
-
-                        DataEncoder::saveObfuscated(tempFile, typesXml);
-                    }
-                }
-            }
+        // если мы дошли до сих пор, то все хорошо и плагин нас не обрушил
+        // так и запишем.
+        ScopedPointer<XmlElement> typesXml(new XmlElement(Serialization::Core::instrumentRoot));
+
+        for (auto i : typesFound)
+        {
+            typesXml->addChildElement(i->createXml());
         }
+
+        const String output(PluginManager::scanOutputBegin +
+                            typesXml->createDocument("", true, false) +
+                            PluginManager::scanOutputEnd);
+
+        fwrite(output.toRawUTF8(), 1, output.getNumBytesAsUTF8(), stdout);
+        fflush(stdout);
+        return true;
     }
     catch (...)
     {
-        JUCEApplication::quit();
+        return false;
     }
 }
 
@@ -134,7 +134,8 @@ private:
     String collectSomeSystemInfo();
     String getMacAddressList();
 
-    void checkPlugin(const String &markerFile);
+    bool checkPlugin(const String &commandLine);
+    bool exportMidi(const String &commandLine);
     void changeListenerCallback(ChangeBroadcaster *source) override;
 
 private:
@@ -143,7 +144,8 @@ private:
     {
         NORMAL,
         PLUGIN_CHECK,
-        FONT_SERIALIZE
+        FONT_SERIALIZE,
+        MIDI_EXPORT
     };
 
     App::RunMode detectRunMode(const String &commandLine);
@@ -0,0 +1,210 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Common.h"
+#include "HelioProfiler.h"
+
+// Keep the trace file reasonably sized in long sessions
+#define HELIO_PROFILER_MAX_TRACE_EVENTS 500000
+
+Atomic<int> HelioProfiler::enabled;
+
+struct HelioProfilerEvent
+{
+    const char *name;
+    Thread::ThreadID threadId;
+    double startMs;
+    double endMs;
+};
+
+struct HelioProfilerState
+{
+    SpinLock sitesLock;
+    Array<HelioProfiler::Site *> sites;
+
+    SpinLock eventsLock;
+    Array<HelioProfilerEvent> events;
+    int numFrames = 0;
+    double frameStartMs = 0.0;
+    double lastFrameMs = 0.0;
+    double totalFrameMs = 0.0;
+    double maxFrameMs = 0.0;
+
+    File outputFile;
+    double originMs = 0.0;
+};
+
+static HelioProfilerState &getProfilerState()
+{
+    static HelioProfilerState state;
+    return state;
+}
+
+struct SiteStatsComparator
+{
+    static int compareElements(const HelioProfiler::SiteStats &first, const HelioProfiler::SiteStats &second)
+    {
+        return (first.totalMs > second.totalMs) ? -1 : ((first.totalMs < second.totalMs) ? 1 : 0);
+    }
+};
+
+HelioProfiler::Site::Site(const char *name, bool isCounter) :
+    name(name), isCounter(isCounter)
+{
+    HelioProfilerState &state = getProfilerState();
+    const SpinLock::ScopedLockType lock(state.sitesLock);
+    state.sites.add(this);
+}
+
+void HelioProfiler::start(const File &outputFile)
+{
+    HelioProfilerState &state = getProfilerState();
+    const SpinLock::ScopedLockType lock(state.eventsLock);
+    state.outputFile = outputFile;
+    state.originMs = Time::getMillisecondCounterHiRes();
+    enabled = 1;
+}
+
+void HelioProfiler::addEvent(Site &site, double startMs, double endMs)
+{
+    const double durationMs = endMs - startMs;
+
+    {
+        const SpinLock::ScopedLockType lock(site.lock);
+        site.numCalls++;
+        site.totalMs += durationMs;
+        site.maxMs = jmax(site.maxMs, durationMs);
+    }
+
+    HelioProfilerState &state = getProfilerState();
+    const SpinLock::ScopedLockType lock(state.eventsLock);
+
+    if (state.events.size() < HELIO_PROFILER_MAX_TRACE_EVENTS)
+    {
+        state.events.add({ site.name, Thread::getCurrentThreadId(), startMs, endMs });
+    }
+}
+
+void HelioProfiler::addCount(Site &site, int count)
+{
+    const SpinLock::ScopedLockType lock(site.lock);
+    site.numCalls += count;
+}
+
+void HelioProfiler::beginFrame() noexcept
+{
+    if (! isEnabled())
+    { return; }
+
+    HelioProfilerState &state = getProfilerState();
+    const SpinLock::ScopedLockType lock(state.eventsLock);
+    state.frameStartMs = Time::getMillisecondCounterHiRes();
+}
+
+void HelioProfiler::endFrame()
+{
+    if (! isEnabled())
+    { return; }
+
+    HelioProfilerState &state = getProfilerState();
+    const SpinLock::ScopedLockType lock(state.eventsLock);
+
+    // the layout's paint() is skipped, when opaque children cover all the dirty area,
+    // so a frame without a matching start is not counted at all
+    if (state.frameStartMs <= 0.0)
+    { return; }
+
+    const double frameMs = Time::getMillisecondCounterHiRes() - state.frameStartMs;
+    state.frameStartMs = 0.0;
+
+    state.numFrames++;
+    state.lastFrameMs = frameMs;
+    state.totalFrameMs += frameMs;
+    state.maxFrameMs = jmax(state.maxFrameMs, frameMs);
+}
+
+HelioProfiler::FrameStats HelioProfiler::takeFrameStats()
+{
+    HelioProfilerState &state = getProfilerState();
+    const SpinLock::ScopedLockType lock(state.eventsLock);
+
+    const FrameStats result = { state.numFrames, state.lastFrameMs,
+        (state.numFrames > 0) ? (state.totalFrameMs / state.numFrames) : 0.0,
+        state.maxFrameMs };
+
+    state.numFrames = 0;
+    state.totalFrameMs = 0.0;
+    state.maxFrameMs = 0.0;
+    return result;
+}
+
+Array<HelioProfiler::SiteStats> HelioProfiler::takeSiteStats()
+{
+    HelioProfilerState &state = getProfilerState();
+    const SpinLock::ScopedLockType sitesLock(state.sitesLock);
+
+    Array<SiteStats> result;
+    for (auto *site : state.sites)
+    {
+        const SpinLock::ScopedLockType lock(site->lock);
+        if (site->numCalls > 0)
+        {
+            result.add({ site->name, site->isCounter, site->numCalls, site->totalMs, site->maxMs });
+            site->numCalls = 0;
+            site->totalMs = 0.0;
+            site->maxMs = 0.0;
+        }
+    }
+
+    SiteStatsComparator comparator;
+    result.sort(comparator);
+    return result;
+}
+
+void HelioProfiler::flush()
+{
+    if (! isEnabled())
+    { return; }
+
+    HelioProfilerState &state = getProfilerState();
+
+    Array<HelioProfilerEvent> events;
+    File outputFile;
+    double originMs = 0.0;
+
+    // the events are taken out under the lock, and written without holding it,
+    // so the other threads don't spin while the file is being saved
+    {
+        const SpinLock::ScopedLockType lock(state.eventsLock);
+        events.swapWith(state.events);
+        outputFile = state.outputFile;
+        originMs = state.originMs;
+    }
+
+    Array<ChromeTraceWriter::Event> traceEvents;
+    traceEvents.ensureStorageAllocated(events.size());
+
+    for (const auto &e : events)
+    {
+        traceEvents.add({ e.name, e.threadId, e.startMs, e.endMs });
+    }
+
+    if (ChromeTraceWriter::write(outputFile, traceEvents, originMs))
+    {
+        Logger::writeToLog("UI profile saved to " + outputFile.getFullPathName());
+    }
+}
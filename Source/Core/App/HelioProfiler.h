@@ -0,0 +1,128 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "HelioTrace.h"
+
+// Opt-in UI profiler, enabled with --profile-ui: collects the timings
+// of instrumented scopes (paint, layout, async updates and model callbacks)
+// aggregated per site, together with the frame times of the main layout;
+// the overlay displays them, and the whole session is exported in the
+// Chrome trace format on exit
+class HelioProfiler final
+{
+public:
+
+    // One instrumented place in the code, registered on first use
+    class Site final
+    {
+    public:
+
+        explicit Site(const char *name, bool isCounter = false);
+
+        const char *const name;
+        const bool isCounter;
+
+        SpinLock lock;
+        int numCalls = 0;
+        double totalMs = 0.0;
+        double maxMs = 0.0;
+
+        JUCE_DECLARE_NON_COPYABLE(Site)
+    };
+
+    struct SiteStats
+    {
+        const char *name;
+        bool isCounter;
+        int numCalls;
+        double totalMs;
+        double maxMs;
+    };
+
+    struct FrameStats
+    {
+        int numFrames;
+        double lastMs;
+        double averageMs;
+        double maxMs;
+    };
+
+    static void start(const File &outputFile);
+
+    static bool isEnabled() noexcept
+    {
+        return enabled.get() != 0;
+    }
+
+    static void addEvent(Site &site, double startMs, double endMs);
+
+    // Counters only accumulate the number of events, not adding them to the trace
+    static void addCount(Site &site, int count);
+
+    // Called at the start and at the end of a main layout repaint
+    static void beginFrame() noexcept;
+    static void endFrame();
+
+    // Returns the stats collected since the previous call and resets them
+    static FrameStats takeFrameStats();
+
+    // Returns the per-site stats collected since the previous call,
+    // the most expensive sites first, and resets them
+    static Array<SiteStats> takeSiteStats();
+
+    static void flush();
+
+    class Scope final
+    {
+    public:
+
+        explicit Scope(Site &site) :
+            site(site),
+            startMs(HelioProfiler::isEnabled() ? Time::getMillisecondCounterHiRes() : 0.0) {}
+
+        ~Scope()
+        {
+            if (HelioProfiler::isEnabled())
+            {
+                HelioProfiler::addEvent(this->site, this->startMs, Time::getMillisecondCounterHiRes());
+            }
+        }
+
+    private:
+
+        Site &site;
+        const double startMs;
+
+        JUCE_DECLARE_NON_COPYABLE(Scope)
+    };
+
+private:
+
+    static Atomic<int> enabled;
+
+};
+
+#define HELIO_PROFILE_COUNT(name, count) \
+    do { if (HelioProfiler::isEnabled()) { \
+        static HelioProfiler::Site helioProfilerCounter(name, true); \
+        HelioProfiler::addCount(helioProfilerCounter, count); } } while (0)
+
+#define HELIO_PROFILE_SCOPE(name) \
+    static HelioProfiler::Site JUCE_JOIN_MACRO(helioProfilerSite, __LINE__)(name); \
+    const HelioProfiler::Scope JUCE_JOIN_MACRO(helioProfilerScope, __LINE__)(JUCE_JOIN_MACRO(helioProfilerSite, __LINE__))
@@ -0,0 +1,128 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Common.h"
+#include "HelioTrace.h"
+
+//===----------------------------------------------------------------------===//
+// ChromeTraceWriter
+//===----------------------------------------------------------------------===//
+
+bool ChromeTraceWriter::write(const File &outputFile, const Array<Event> &events, double originMs)
+{
+    TemporaryFile tempFile(outputFile);
+
+    {
+        FileOutputStream out(tempFile.getFile());
+
+        if (! out.openedOk())
+        { return false; }
+
+        // threads are numbered in the order of appearance
+        Array<Thread::ThreadID> threads;
+
+        out << "{\"traceEvents\":[";
+
+        for (int i = 0; i < events.size(); ++i)
+        {
+            const Event &e = events.getReference(i);
+
+            int threadIndex = threads.indexOf(e.threadId);
+            if (threadIndex < 0)
+            {
+                threadIndex = threads.size();
+                threads.add(e.threadId);
+            }
+
+            out << ((i > 0) ? ",\n" : "\n")
+                << "{\"name\":" << JSON::toString(var(e.name))
+                << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << threadIndex
+                << ",\"ts\":" << int64((e.startMs - originMs) * 1000.0)
+                << ",\"dur\":" << int64((e.endMs - e.startMs) * 1000.0) << "}";
+        }
+
+        out << "\n]}\n";
+        out.flush();
+
+        if (out.getStatus().failed())
+        { return false; }
+    }
+
+    return tempFile.overwriteTargetFileWithTemporary();
+}
+
+//===----------------------------------------------------------------------===//
+// HelioTrace
+//===----------------------------------------------------------------------===//
+
+Atomic<int> HelioTrace::enabled;
+
+struct HelioTraceState
+{
+    CriticalSection lock;
+    Array<ChromeTraceWriter::Event> events;
+    File outputFile;
+    double originMs = 0.0;
+};
+
+static HelioTraceState &getTraceState()
+{
+    static HelioTraceState state;
+    return state;
+}
+
+void HelioTrace::start(const File &outputFile)
+{
+    HelioTraceState &state = getTraceState();
+    const ScopedLock lock(state.lock);
+    state.outputFile = outputFile;
+    state.originMs = Time::getMillisecondCounterHiRes();
+    enabled = 1;
+}
+
+void HelioTrace::addEvent(const String &name, double startMs, double endMs)
+{
+    HelioTraceState &state = getTraceState();
+    const ScopedLock lock(state.lock);
+    state.events.add({ name, Thread::getCurrentThreadId(), startMs, endMs });
+}
+
+void HelioTrace::flush()
+{
+    if (! isEnabled())
+    { return; }
+
+    HelioTraceState &state = getTraceState();
+
+    Array<ChromeTraceWriter::Event> events;
+    File outputFile;
+    double originMs = 0.0;
+
+    // the file is written without holding the lock, so the events are copied:
+    // each flush rewrites the whole timeline collected so far
+    {
+        const ScopedLock lock(state.lock);
+        events = state.events;
+        outputFile = state.outputFile;
+        originMs = state.originMs;
+    }
+
+    if (ChromeTraceWriter::write(outputFile, events, originMs))
+    {
+        Logger::writeToLog("Startup trace saved to " + outputFile.getFullPathName());
+    }
+}
@@ -0,0 +1,86 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+// Writes events in the Chrome trace format (see chrome://tracing),
+// shared by the startup trace and the UI profiler
+class ChromeTraceWriter final
+{
+public:
+
+    struct Event
+    {
+        String name;
+        Thread::ThreadID threadId;
+        double startMs;
+        double endMs;
+    };
+
+    static bool write(const File &outputFile, const Array<Event> &events, double originMs);
+
+};
+
+// A timeline of the app startup,
+// collected only when the app is started with --trace-startup
+class HelioTrace final
+{
+public:
+
+    static void start(const File &outputFile);
+
+    static bool isEnabled() noexcept
+    {
+        return enabled.get() != 0;
+    }
+
+    static void addEvent(const String &name, double startMs, double endMs);
+
+    // Rewrites the output file with all events collected so far
+    static void flush();
+
+    class Scope final
+    {
+    public:
+
+        explicit Scope(const String &name) :
+            name(name),
+            startMs(HelioTrace::isEnabled() ? Time::getMillisecondCounterHiRes() : 0.0) {}
+
+        ~Scope()
+        {
+            if (HelioTrace::isEnabled())
+            {
+                HelioTrace::addEvent(this->name, this->startMs, Time::getMillisecondCounterHiRes());
+            }
+        }
+
+    private:
+
+        const String name;
+        const double startMs;
+
+        JUCE_DECLARE_NON_COPYABLE(Scope)
+    };
+
+private:
+
+    static Atomic<int> enabled;
+
+};
+
+#define HELIO_TRACE_SCOPE(name) const HelioTrace::Scope JUCE_JOIN_MACRO(helioTraceScope, __LINE__)(name)
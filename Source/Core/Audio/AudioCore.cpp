@@ -19,6 +19,7 @@
 #include "AudioCore.h"
 #include "InternalPluginFormat.h"
 #include "BuiltInSynthFormat.h"
+#include "BuiltInSynthPiano.h"
 #include "PluginWindow.h"
 #include "OrchestraPit.h"
 #include "Instrument.h"
@@ -42,6 +43,10 @@ AudioCore::AudioCore()
     this->deviceManager.addAudioCallback(this->audioMonitor);
 
     AudioCore::initAudioFormats(this->formatManager);
+    
+    // the default piano samples are decoded in background
+    // while the workspace and the projects are loading
+    this->pianoSamples->startLoading();
 
     // requesting 0 inputs and only 2 outputs because of fucking alsa
     this->deviceManager.initialise(0, 2, nullptr, true);
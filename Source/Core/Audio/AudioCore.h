@@ -19,6 +19,7 @@
 
 class Instrument;
 class AudioMonitor;
+class BuiltInSynthPianoSamples;
 
 #include "Serializable.h"
 #include "OrchestraPit.h"
@@ -118,6 +119,9 @@ private:
     void addInstrumentToDevice(Instrument *instrument);
     void removeInstrumentFromDevice(Instrument *instrument);
 
+    // holds the shared samples for the whole app lifetime
+    SharedResourcePointer<BuiltInSynthPianoSamples> pianoSamples;
+
     OwnedArray<Instrument> instruments;
     ScopedPointer<AudioMonitor> audioMonitor;
 
@@ -23,25 +23,143 @@
 #define RELEASE_TIME 1.0
 #define MAX_PLAY_TIME 5.0
 
-#if HELIO_DESKTOP
-#   define BUILTIN_PIANO_DEFERRED_INIT 1
-#elif HELIO_MOBILE
-#   define BUILTIN_PIANO_DEFERRED_INIT 0
-#endif
+//===----------------------------------------------------------------------===//
+// Shared samples
+//===----------------------------------------------------------------------===//
 
+class GrandSampleDecodingJob : public ThreadPoolJob
+{
+public:
+
+    GrandSampleDecodingJob(BuiltInSynthPianoSamples &owner, int index) :
+        ThreadPoolJob("Grand Sample Decoding Job"),
+        owner(owner),
+        index(index) {}
+
+    JobStatus runJob() override
+    {
+        this->owner.decodeSample(this->index);
+        return jobHasFinished;
+    }
+
+private:
+
+    BuiltInSynthPianoSamples &owner;
+    const int index;
+
+    JUCE_DECLARE_NON_COPYABLE(GrandSampleDecodingJob)
+};
+
+BuiltInSynthPianoSamples::BuiltInSynthPianoSamples() :
+    loadingStarted(0),
+    numSamplesLeft(-1) {}
+
+BuiltInSynthPianoSamples::~BuiltInSynthPianoSamples()
+{
+    this->decodingPool = nullptr;
+}
+
+void BuiltInSynthPianoSamples::startLoading()
+{
+    if (! this->loadingStarted.compareAndSetBool(1, 0))
+    { return; }
+
+    this->samples.add(new GrandSample("A0v9", 21, 22, 22, BinaryData::A0v9_ogg, BinaryData::A0v9_oggSize));
+    this->samples.add(new GrandSample("C1v9", 23, 25, 24, BinaryData::C1v9_ogg, BinaryData::C1v9_oggSize));
+    this->samples.add(new GrandSample("D#1v9", 26, 28, 27, BinaryData::D1v9_ogg, BinaryData::D1v9_oggSize));
+    this->samples.add(new GrandSample("F#1v9", 29, 31, 30, BinaryData::F1v9_ogg, BinaryData::F1v9_oggSize));
+    
+    this->samples.add(new GrandSample("A1v9", 32, 34, 33, BinaryData::A1v9_ogg, BinaryData::A1v9_oggSize));
+    this->samples.add(new GrandSample("C2v9", 35, 37, 36, BinaryData::C2v9_ogg, BinaryData::C2v9_oggSize));
+    this->samples.add(new GrandSample("D#2v9", 38, 40, 39, BinaryData::D2v9_ogg, BinaryData::D2v9_oggSize));
+    this->samples.add(new GrandSample("F#2v9", 41, 43, 42, BinaryData::F2v9_ogg, BinaryData::F2v9_oggSize));
+    
+    this->samples.add(new GrandSample("A2v9", 44, 46, 45, BinaryData::A2v9_ogg, BinaryData::A2v9_oggSize));
+    this->samples.add(new GrandSample("C3v9", 47, 49, 48, BinaryData::C3v9_ogg, BinaryData::C3v9_oggSize));
+    this->samples.add(new GrandSample("D#3v9", 50, 52, 51, BinaryData::D3v9_ogg, BinaryData::D3v9_oggSize));
+    this->samples.add(new GrandSample("F#3v9", 53, 55, 54, BinaryData::F3v9_ogg, BinaryData::F3v9_oggSize));
+    
+    this->samples.add(new GrandSample("A3v9", 56, 58, 57, BinaryData::A3v9_ogg, BinaryData::A3v9_oggSize));
+    this->samples.add(new GrandSample("C4v9", 59, 61, 60, BinaryData::C4v9_ogg, BinaryData::C4v9_oggSize));
+    this->samples.add(new GrandSample("D#4v9", 62, 64, 63, BinaryData::D4v9_ogg, BinaryData::D4v9_oggSize));
+    this->samples.add(new GrandSample("F#4v9", 65, 67, 66, BinaryData::F4v9_ogg, BinaryData::F4v9_oggSize));
+    
+    this->samples.add(new GrandSample("A4v9", 68, 70, 69, BinaryData::A4v9_ogg, BinaryData::A4v9_oggSize));
+    this->samples.add(new GrandSample("C5v9", 71, 73, 72, BinaryData::C5v9_ogg, BinaryData::C5v9_oggSize));
+    this->samples.add(new GrandSample("D#5v9", 74, 76, 75, BinaryData::D5v9_ogg, BinaryData::D5v9_oggSize));
+    this->samples.add(new GrandSample("F#5v9", 77, 79, 78, BinaryData::F5v9_ogg, BinaryData::F5v9_oggSize));
+    
+    this->samples.add(new GrandSample("A5v9", 80, 82, 81, BinaryData::A5v9_ogg, BinaryData::A5v9_oggSize));
+    this->samples.add(new GrandSample("C6v9", 83, 85, 84, BinaryData::C6v9_ogg, BinaryData::C6v9_oggSize));
+    this->samples.add(new GrandSample("D#6v9", 86, 88, 87, BinaryData::D6v9_ogg, BinaryData::D6v9_oggSize));
+    this->samples.add(new GrandSample("F#6v9", 89, 91, 90, BinaryData::F6v9_ogg, BinaryData::F6v9_oggSize));
+    
+    this->samples.add(new GrandSample("A6v9", 92, 94, 93, BinaryData::A6v9_ogg, BinaryData::A6v9_oggSize));
+    this->samples.add(new GrandSample("C7v9", 95, 97, 96, BinaryData::C7v9_ogg, BinaryData::C7v9_oggSize));
+    this->samples.add(new GrandSample("D#7v9", 98, 100, 99, BinaryData::D7v9_ogg, BinaryData::D7v9_oggSize));
+    this->samples.add(new GrandSample("F#7v9", 101, 103, 102, BinaryData::F7v9_ogg, BinaryData::F7v9_oggSize));
+    
+    this->samples.add(new GrandSample("A7v9", 104, 106, 105, BinaryData::A7v9_ogg, BinaryData::A7v9_oggSize));
+    this->samples.add(new GrandSample("C8v9", 107, 108, 108, BinaryData::C8v9_ogg, BinaryData::C8v9_oggSize));
+
+    // every job only writes its own slot, so no locking is needed here
+    this->sounds.insertMultiple(0, nullptr, this->samples.size());
+    this->numSamplesLeft = this->samples.size();
+
+    const int numThreads = jlimit(1, 4, SystemStats::getNumCpus());
+    this->decodingPool = new ThreadPool(numThreads);
+
+    for (int i = 0; i < this->samples.size(); ++i)
+    {
+        this->decodingPool->addJob(new GrandSampleDecodingJob(*this, i), true);
+    }
+}
+
+bool BuiltInSynthPianoSamples::isLoaded() const noexcept
+{
+    return this->numSamplesLeft.get() == 0;
+}
+
+const Array<SynthesiserSound::Ptr> &BuiltInSynthPianoSamples::getSounds() const noexcept
+{
+    return this->sounds;
+}
+
+void BuiltInSynthPianoSamples::decodeSample(int index)
+{
+    GrandSample *s = this->samples.getUnchecked(index);
+
+    this->sounds.set(index, new SamplerSound(s->name,
+                                             *s->reader,
+                                             s->midiNotes,
+                                             s->midiNoteForNormalPitch,
+                                             ATTACK_TIME,
+                                             RELEASE_TIME,
+                                             MAX_PLAY_TIME));
+
+    // the compressed data is not needed anymore
+    s->reader = nullptr;
+    --this->numSamplesLeft;
+}
+
+
+//===----------------------------------------------------------------------===//
+// Piano
+//===----------------------------------------------------------------------===//
 
 BuiltInSynthPiano::BuiltInSynthPiano(bool empty /*= false*/)
 {
     if (! empty)
     {
-        this->initSamples();
         this->initVoices();
         
-#if ! BUILTIN_PIANO_DEFERRED_INIT
-        // This takes about 400ms on app load.
-        // If defined, avioding this and doing a deferred init on first processBlock
-        this->initSampler();
-#endif
+        // Usually the samples are already decoded on app load,
+        // otherwise the sampler is initialized on the first processBlock after that
+        this->sharedSamples->startLoading();
+        if (this->sharedSamples->isLoaded())
+        {
+            this->initSampler();
+        }
     }
 
     this->setPlayConfigDetails(0,
@@ -52,7 +170,7 @@ BuiltInSynthPiano::BuiltInSynthPiano(bool empty /*= false*/)
 
 BuiltInSynthPiano::~BuiltInSynthPiano()
 {
-    this->samples.clear();
+    this->synth.clearSounds();
 }
 
 const String BuiltInSynthPiano::getName() const
@@ -70,14 +188,12 @@ void BuiltInSynthPiano::initVoices()
 
 void BuiltInSynthPiano::processBlock(AudioSampleBuffer &buffer, MidiBuffer &midiMessages)
 {
-#if BUILTIN_PIANO_DEFERRED_INIT
     if (this->synth.getNumSounds() == 0 &&
-        midiMessages.getNumEvents() > 0)
+        this->sharedSamples->isLoaded())
     {
-        Logger::writeToLog("BuiltInSynthPiano deferred init.");
+        // just a few pointers to share, no decoding here
         this->initSampler();
     }
-#endif
     
     BuiltInSynthAudioPlugin::processBlock(buffer, midiMessages);
 }
@@ -91,60 +207,12 @@ void BuiltInSynthPiano::initSampler()
 {
     this->synth.clearSounds();
 
-    for (auto s : this->samples)
+    for (const auto &sound : this->sharedSamples->getSounds())
     {
-        this->synth.addSound(new SamplerSound(s->name,
-                                              *s->reader,
-                                              s->midiNotes,
-                                              s->midiNoteForNormalPitch,
-                                              ATTACK_TIME,
-                                              RELEASE_TIME,
-                                              MAX_PLAY_TIME));
+        this->synth.addSound(sound);
     }
 }
 
-void BuiltInSynthPiano::initSamples()
-{
-    this->samples.clear();
-    this->samples.add(new GrandSample("A0v9", 21, 22, 22, BinaryData::A0v9_ogg, BinaryData::A0v9_oggSize));
-    this->samples.add(new GrandSample("C1v9", 23, 25, 24, BinaryData::C1v9_ogg, BinaryData::C1v9_oggSize));
-    this->samples.add(new GrandSample("D#1v9", 26, 28, 27, BinaryData::D1v9_ogg, BinaryData::D1v9_oggSize));
-    this->samples.add(new GrandSample("F#1v9", 29, 31, 30, BinaryData::F1v9_ogg, BinaryData::F1v9_oggSize));
-    
-    this->samples.add(new GrandSample("A1v9", 32, 34, 33, BinaryData::A1v9_ogg, BinaryData::A1v9_oggSize));
-    this->samples.add(new GrandSample("C2v9", 35, 37, 36, BinaryData::C2v9_ogg, BinaryData::C2v9_oggSize));
-    this->samples.add(new GrandSample("D#2v9", 38, 40, 39, BinaryData::D2v9_ogg, BinaryData::D2v9_oggSize));
-    this->samples.add(new GrandSample("F#2v9", 41, 43, 42, BinaryData::F2v9_ogg, BinaryData::F2v9_oggSize));
-    
-    this->samples.add(new GrandSample("A2v9", 44, 46, 45, BinaryData::A2v9_ogg, BinaryData::A2v9_oggSize));
-    this->samples.add(new GrandSample("C3v9", 47, 49, 48, BinaryData::C3v9_ogg, BinaryData::C3v9_oggSize));
-    this->samples.add(new GrandSample("D#3v9", 50, 52, 51, BinaryData::D3v9_ogg, BinaryData::D3v9_oggSize));
-    this->samples.add(new GrandSample("F#3v9", 53, 55, 54, BinaryData::F3v9_ogg, BinaryData::F3v9_oggSize));
-    
-    this->samples.add(new GrandSample("A3v9", 56, 58, 57, BinaryData::A3v9_ogg, BinaryData::A3v9_oggSize));
-    this->samples.add(new GrandSample("C4v9", 59, 61, 60, BinaryData::C4v9_ogg, BinaryData::C4v9_oggSize));
-    this->samples.add(new GrandSample("D#4v9", 62, 64, 63, BinaryData::D4v9_ogg, BinaryData::D4v9_oggSize));
-    this->samples.add(new GrandSample("F#4v9", 65, 67, 66, BinaryData::F4v9_ogg, BinaryData::F4v9_oggSize));
-    
-    this->samples.add(new GrandSample("A4v9", 68, 70, 69, BinaryData::A4v9_ogg, BinaryData::A4v9_oggSize));
-    this->samples.add(new GrandSample("C5v9", 71, 73, 72, BinaryData::C5v9_ogg, BinaryData::C5v9_oggSize));
-    this->samples.add(new GrandSample("D#5v9", 74, 76, 75, BinaryData::D5v9_ogg, BinaryData::D5v9_oggSize));
-    this->samples.add(new GrandSample("F#5v9", 77, 79, 78, BinaryData::F5v9_ogg, BinaryData::F5v9_oggSize));
-    
-    this->samples.add(new GrandSample("A5v9", 80, 82, 81, BinaryData::A5v9_ogg, BinaryData::A5v9_oggSize));
-    this->samples.add(new GrandSample("C6v9", 83, 85, 84, BinaryData::C6v9_ogg, BinaryData::C6v9_oggSize));
-    this->samples.add(new GrandSample("D#6v9", 86, 88, 87, BinaryData::D6v9_ogg, BinaryData::D6v9_oggSize));
-    this->samples.add(new GrandSample("F#6v9", 89, 91, 90, BinaryData::F6v9_ogg, BinaryData::F6v9_oggSize));
-    
-    this->samples.add(new GrandSample("A6v9", 92, 94, 93, BinaryData::A6v9_ogg, BinaryData::A6v9_oggSize));
-    this->samples.add(new GrandSample("C7v9", 95, 97, 96, BinaryData::C7v9_ogg, BinaryData::C7v9_oggSize));
-    this->samples.add(new GrandSample("D#7v9", 98, 100, 99, BinaryData::D7v9_ogg, BinaryData::D7v9_oggSize));
-    this->samples.add(new GrandSample("F#7v9", 101, 103, 102, BinaryData::F7v9_ogg, BinaryData::F7v9_oggSize));
-    
-    this->samples.add(new GrandSample("A7v9", 104, 106, 105, BinaryData::A7v9_ogg, BinaryData::A7v9_oggSize));
-    this->samples.add(new GrandSample("C8v9", 107, 108, 108, BinaryData::C8v9_ogg, BinaryData::C8v9_oggSize));
-}
-
 
 //sample=A0v9.ogg   lokey=21    hikey=22    pitch_keycenter=21
 //sample=C1v9.ogg   lokey=23    hikey=25    pitch_keycenter=24
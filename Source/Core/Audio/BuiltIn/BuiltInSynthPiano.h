@@ -51,6 +51,41 @@ private:
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(GrandSample)
 };
 
+// Decoded piano samples, shared by all piano instances in the process:
+// decoding takes about 400ms, so it is done once, in parallel, in background
+class BuiltInSynthPianoSamples final
+{
+public:
+
+    BuiltInSynthPianoSamples();
+    ~BuiltInSynthPianoSamples();
+
+    // Starts decoding, if not started yet, safe to call from any thread
+    void startLoading();
+
+    // Safe to call from the audio thread
+    bool isLoaded() const noexcept;
+
+    // Empty until loaded
+    const Array<SynthesiserSound::Ptr> &getSounds() const noexcept;
+
+private:
+
+    void decodeSample(int index);
+
+    OwnedArray<GrandSample> samples;
+    Array<SynthesiserSound::Ptr> sounds;
+
+    Atomic<int> loadingStarted;
+    Atomic<int> numSamplesLeft;
+
+    ScopedPointer<ThreadPool> decodingPool;
+
+    friend class GrandSampleDecodingJob;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(BuiltInSynthPianoSamples)
+};
+
 class BuiltInSynthPiano : public BuiltInSynthAudioPlugin
 {
 public:
@@ -73,9 +108,7 @@ protected:
 
     void initSampler() override;
 
-    void initSamples();
-
-    OwnedArray<GrandSample> samples;
+    SharedResourcePointer<BuiltInSynthPianoSamples> sharedSamples;
     
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(BuiltInSynthPiano)
 
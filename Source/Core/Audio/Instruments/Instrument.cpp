@@ -20,6 +20,7 @@
 #include "PluginWindow.h"
 #include "InternalPluginFormat.h"
 #include "PluginSmartDescription.h"
+#include "BuiltInSynthFormat.h"
 #include "SerializationKeys.h"
 
 const int Instrument::midiChannelNumber = 0x1000;
@@ -28,6 +29,7 @@ Instrument::Instrument(AudioPluginFormatManager &formatManager, String name) :
     formatManager(formatManager),
     instrumentName(std::move(name)),
     lastUID(0),
+    numNodesLoading(0),
     instrumentID()
 {
     this->processorGraph = new AudioProcessorGraph();
@@ -37,6 +39,10 @@ Instrument::Instrument(AudioPluginFormatManager &formatManager, String name) :
 
 Instrument::~Instrument()
 {
+    // waits for the nodes being restored,
+    // their callbacks will find this instrument gone and just delete them
+    this->loadingPool = nullptr;
+    
     this->masterReference.clear();
     this->processorPlayer.setProcessor(nullptr);
     
@@ -91,6 +97,11 @@ String Instrument::getIdAndHash() const
     return this->getInstrumentID() + this->getInstrumentHash();
 }
 
+bool Instrument::isReady() const noexcept
+{
+    return this->numNodesLoading.get() == 0;
+}
+
 
 void Instrument::initializeFrom(const PluginDescription &pluginDescription)
 {
@@ -171,6 +182,8 @@ void Instrument::addNodeAsync(const PluginDescription &desc,
                               double x, double y,
                               std::function<void (AudioProcessorGraph::Node *)> f)
 {
+    ++this->numNodesLoading;
+    
     this->formatManager.
     createPluginInstanceAsync(desc,
                               this->processorGraph->getSampleRate(),
@@ -186,6 +199,7 @@ void Instrument::addNodeAsync(const PluginDescription &desc,
                                   
                                   if (node == nullptr)
                                   {
+                                      --this->numNodesLoading;
                                       f(nullptr);
                                       return;
                                   }
@@ -194,6 +208,7 @@ void Instrument::addNodeAsync(const PluginDescription &desc,
                                   this->sendChangeMessage();
                                   
                                   f(node);
+                                  --this->numNodesLoading;
                               });
 }
 
@@ -485,6 +500,66 @@ XmlElement *Instrument::createNodeXml(AudioProcessorGraph::Node *const node) con
     return nullptr;
 }
 
+// Creates a plugin instance and restores its state on a background thread,
+// then hands it over to the message thread
+class InstrumentNodeLoadingJob : public ThreadPoolJob
+{
+public:
+    
+    using Callback = std::function<void (AudioPluginInstance *, bool)>;
+    
+    InstrumentNodeLoadingJob(AudioPluginFormatManager &formatManager,
+                             const PluginDescription &description,
+                             const MemoryBlock &state,
+                             double sampleRate, int blockSize,
+                             Callback callback) :
+        ThreadPoolJob("Instrument Node Loading Job"),
+        formatManager(formatManager),
+        description(description),
+        state(state),
+        sampleRate(sampleRate),
+        blockSize(blockSize),
+        callback(std::move(callback)) {}
+    
+    JobStatus runJob() override
+    {
+        String errorMessage;
+        
+        AudioPluginInstance *instance =
+            this->formatManager.createPluginInstance(this->description,
+                                                     this->sampleRate,
+                                                     this->blockSize,
+                                                     errorMessage);
+        
+        const bool stateIsRestored = (instance != nullptr && this->state.getSize() > 0);
+        
+        if (stateIsRestored)
+        {
+            instance->setStateInformation(this->state.getData(),
+                                          static_cast<int>(this->state.getSize()));
+        }
+        
+        const Callback f(this->callback);
+        MessageManager::callAsync([f, instance, stateIsRestored]()
+                                  {
+                                      f(instance, stateIsRestored);
+                                  });
+        
+        return jobHasFinished;
+    }
+    
+private:
+    
+    AudioPluginFormatManager &formatManager;
+    const PluginDescription description;
+    const MemoryBlock state;
+    const double sampleRate;
+    const int blockSize;
+    const Callback callback;
+    
+    JUCE_DECLARE_NON_COPYABLE(InstrumentNodeLoadingJob)
+};
+
 void Instrument::createNodeFromXmlAsync(const XmlElement &xml,
                                         std::function<void (AudioProcessorGraph::Node *)> f)
 {
@@ -510,37 +585,74 @@ void Instrument::createNodeFromXmlAsync(const XmlElement &xml,
     const double nodeLastX = xml.getDoubleAttribute("uiLastX");
     const double nodeLastY = xml.getDoubleAttribute("uiLastY");
     
-    formatManager.
-    createPluginInstanceAsync(pd,
-                              this->processorGraph->getSampleRate(),
-                              this->processorGraph->getBlockSize(),
-                              [this, nodeStateBlock, nodeUid, nodeHash, nodeX, nodeY, nodeLastX, nodeLastY, f]
-                              (AudioPluginInstance *instance, const String &error)
-                              {
-                                  if (instance == nullptr)
-                                  {
-                                      f(nullptr);
-                                      return;
-                                  }
-                                  
-                                  AudioProcessorGraph::Node::Ptr node(this->processorGraph->addNode(instance, nodeUid));
-                                  
-                                  if (nodeStateBlock.getSize() > 0)
+    ++this->numNodesLoading;
+    
+    // the instrument might be deleted before the instance is ready
+    WeakReference<Instrument> weakThis(this);
+    
+    auto onInstanceCreated = [weakThis, nodeStateBlock, nodeUid, nodeHash, nodeX, nodeY, nodeLastX, nodeLastY, f]
+    (AudioPluginInstance *instance, bool stateIsRestored)
+    {
+        Instrument *self = weakThis.get();
+        
+        if (self == nullptr)
+        {
+            delete instance;
+            return;
+        }
+        
+        if (instance == nullptr)
+        {
+            --self->numNodesLoading;
+            f(nullptr);
+            return;
+        }
+        
+        AudioProcessorGraph::Node::Ptr node(self->processorGraph->addNode(instance, nodeUid));
+        
+        if (!stateIsRestored && nodeStateBlock.getSize() > 0)
+        {
+            node->getProcessor()->
+            setStateInformation(nodeStateBlock.getData(),
+                                static_cast<int>(nodeStateBlock.getSize()));
+        }
+        
+        Uuid fallbackRandomHash;
+        node->properties.set("x", nodeX);
+        node->properties.set("y", nodeY);
+        node->properties.set("hash", nodeHash.isNotEmpty() ? nodeHash : fallbackRandomHash.toString());
+        node->properties.set("uiLastX", nodeLastX);
+        node->properties.set("uiLastY", nodeLastY);
+        
+        f(node);
+        --self->numNodesLoading;
+    };
+    
+    // built-in synths are the heavy ones (samples), and they are safe to create anywhere,
+    // while the external plugin formats still want the message thread
+    if (pd.pluginFormatName == HELIO_BUILT_IN_PLUGIN_FORMAT_NAME)
+    {
+        if (this->loadingPool == nullptr)
+        {
+            this->loadingPool = new ThreadPool(1);
+        }
+        
+        this->loadingPool->addJob(new InstrumentNodeLoadingJob(this->formatManager, pd, nodeStateBlock,
+                                                               this->processorGraph->getSampleRate(),
+                                                               this->processorGraph->getBlockSize(),
+                                                               onInstanceCreated), true);
+    }
+    else
+    {
+        formatManager.
+        createPluginInstanceAsync(pd,
+                                  this->processorGraph->getSampleRate(),
+                                  this->processorGraph->getBlockSize(),
+                                  [onInstanceCreated](AudioPluginInstance *instance, const String &error)
                                   {
-                                      node->getProcessor()->
-                                      setStateInformation(nodeStateBlock.getData(),
-                                                          static_cast<int>(nodeStateBlock.getSize()));
-                                  }
-                                  
-                                  Uuid fallbackRandomHash;
-                                  node->properties.set("x", nodeX);
-                                  node->properties.set("y", nodeY);
-                                  node->properties.set("hash", nodeHash.isNotEmpty() ? nodeHash : fallbackRandomHash.toString());
-                                  node->properties.set("uiLastX", nodeLastX);
-                                  node->properties.set("uiLastY", nodeLastY);
-                                  
-                                  f(node);
-                              });
+                                      onInstanceCreated(instance, false);
+                                  });
+    }
 }
 
 void Instrument::createNodeFromXml(const XmlElement &xml)
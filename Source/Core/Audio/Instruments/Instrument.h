@@ -38,6 +38,10 @@ public:
     void setName(const String &name);
 
     String getIdAndHash() const; // эта строчка назначается слоям
+
+    // false while some of the nodes are still being created or restored,
+    // the player doesn't send anything to instruments that are not ready
+    bool isReady() const noexcept;
     
     
     void initializeFrom(const PluginDescription &pluginDescription);
@@ -177,6 +181,11 @@ private:
 
     uint32 getNextUID() noexcept;
 
+    Atomic<int> numNodesLoading;
+
+    // built-in synths with their states are restored here, off the message thread
+    ScopedPointer<ThreadPool> loadingPool;
+
     XmlElement *createNodeXml(AudioProcessorGraph::Node *const node) const;
     
     void createNodeFromXml(const XmlElement &xml);
@@ -26,10 +26,19 @@
 
 #include "BuiltInSynthFormat.h"
 
+#define PLUGIN_SCAN_TIMEOUT_MS 10000
+#define PLUGIN_SCAN_MAX_PROCESSES 8
+#define PLUGIN_SCAN_CACHE_FILE "pluginscan.helio"
+
+const String PluginManager::scanOutputBegin = "\n<<<HelioPluginScanBegin>>>\n";
+const String PluginManager::scanOutputEnd = "\n<<<HelioPluginScanEnd>>>\n";
+
 PluginManager::PluginManager() :
 Thread("Plugin Scanner Thread"),
 working(false),
-usingExternalProcess(false)
+usingExternalProcess(false),
+numFilesScanned(0),
+numFilesToScan(0)
 {
     this->startThread(0);
     Config::load(Serialization::Core::pluginManager, this);
@@ -66,6 +75,16 @@ StringArray PluginManager::getFilesToScan() const
     return this->filesToScan;
 }
 
+int PluginManager::getNumFilesScanned() const noexcept
+{
+    return this->numFilesScanned.get();
+}
+
+int PluginManager::getNumFilesToScan() const noexcept
+{
+    return this->numFilesToScan.get();
+}
+
 bool PluginManager::isWorking() const
 {
     ScopedReadLock lock(this->workingFlagLock);
@@ -174,6 +193,8 @@ void PluginManager::run()
     AudioPluginFormatManager formatManager;
     AudioCore::initAudioFormats(formatManager);
     
+    this->loadScanCache();
+    
     while (!this->threadShouldExit())
     {
         {
@@ -181,91 +202,35 @@ void PluginManager::run()
             this->working = true;
         }
         
-        StringArray uncheckedList = this->getFilesToScan();
+        const StringArray uncheckedList = this->getFilesToScan();
+        this->numFilesToScan = uncheckedList.size();
+        this->numFilesScanned = 0;
+
+        // unchanged plugins are taken from the cache without loading them
+        StringArray changedList;
+        
+        for (const auto &i : uncheckedList)
+        {
+            if (! this->addCachedResults(i))
+            {
+                changedList.add(i);
+            }
+        }
+        
+        this->sendChangeMessage();
 
         try
         {
-            for (const auto & i : uncheckedList)
+            if (this->usingExternalProcess)
             {
-                Logger::writeToLog(i);
-                if (this->usingExternalProcess)
-                {
-                    const Uuid tempFileName;
-                    const File tempFile(FileUtils::getTempSlot(tempFileName.toString()));
-                    tempFile.replaceWithText(i);
-                    
-                    const String myself = File::getSpecialLocation(File::currentExecutableFile).getFullPathName();
-                    
-                    ChildProcess checkerProcess;
-                    String commandLine(myself + " " + tempFileName.toString());
-                    checkerProcess.start(commandLine);
-                    
-                    if (!checkerProcess.waitForProcessToFinish(3000))
-                    {
-                        checkerProcess.kill();
-                    }
-                    else
-                    {
-                        if (tempFile.existsAsFile())
-                        {
-                            try
-                            {
-                                ScopedPointer<XmlElement> xml(DataEncoder::loadObfuscated(tempFile));
-                                
-                                // todo as Serialization::Core::smartPluginDescription
-                                if (xml)
-                                {
-                                    forEachXmlChildElementWithTagName(*xml, e, "PLUGIN")
-                                    {
-                                        const ScopedWriteLock lock(this->pluginsListLock);
-                                        PluginDescription pluginDescription;
-                                        pluginDescription.loadFromXml(*e);
-                                        this->pluginsList.addType(pluginDescription);
-                                    }
-                                    
-                                    this->sendChangeMessage();
-                                }
-                            }
-                            catch (...)
-                            { }
-                        }
-                    }
-                    
-                    tempFile.deleteFile();
-                }
-                else
-                {
-                    const String pluginPath(i);
-                    //const File pluginFile(pluginPath);
-                    
-                    KnownPluginList knownPluginList;
-                    OwnedArray<PluginDescription> typesFound;
-                    
-                    try
-                    {
-                        for (int j = 0; j < formatManager.getNumFormats(); ++j)
-                        {
-                            AudioPluginFormat *format = formatManager.getFormat(j);
-                            knownPluginList.scanAndAddFile(pluginPath, false, typesFound, *format);
-                        }
-                    }
-                    catch (...) {}
-                    
-                    // если мы дошли до сих пор, то все хорошо и плагин нас не обрушил
-                    if (typesFound.size() != 0)
-                    {
-                        for (auto type : typesFound)
-                        {
-                            const ScopedWriteLock lock(this->pluginsListLock);
-                            this->pluginsList.addType(*type);
-                        }
-                    }
-                    
-                    this->sendChangeMessage();
-                    Thread::sleep(150);
-                }
+                this->scanInSeparateProcesses(changedList);
+            }
+            else
+            {
+                this->scanInThisProcess(changedList, formatManager);
             }
 
+            this->saveScanCache();
             Config::save(Serialization::Core::pluginManager, this);
             Supervisor::track(Serialization::Activities::scanPlugins);
         }
@@ -284,6 +249,348 @@ void PluginManager::run()
 }
 
 
+//===----------------------------------------------------------------------===//
+// Scanning
+//===----------------------------------------------------------------------===//
+
+// Runs a sandboxed scanner process for a single plugin
+// and reads the descriptions it prints to stdout through the pipe;
+// the manager thread kills the scanner if it hangs.
+// Only a scanner that exited cleanly with well-formed results completes the scan,
+// others are not cached and will be retried next time
+class PluginScanJob : public ThreadPoolJob
+{
+public:
+    
+    explicit PluginScanJob(const String &pluginPath) :
+        ThreadPoolJob("Plugin Scan Job"),
+        fileOrIdentifier(pluginPath),
+        process(nullptr),
+        startTime(0),
+        timedOut(false),
+        completed(false) {}
+    
+    JobStatus runJob() override
+    {
+        const String myself = File::getSpecialLocation(File::currentExecutableFile).getFullPathName();
+        const String commandLine(myself.quoted() + " --scan-plugin " + this->fileOrIdentifier.quoted());
+        
+        ChildProcess scanner;
+        
+        {
+            const ScopedLock lock(this->processLock);
+            this->process = &scanner;
+            this->startTime = Time::getMillisecondCounter();
+        }
+        
+        // stderr is left out, plugins tend to spam it
+        if (scanner.start(commandLine, ChildProcess::wantStdOut))
+        {
+            // blocks until the scanner exits (or is killed)
+            const String output(scanner.readAllProcessOutput());
+            const bool finished = scanner.waitForProcessToFinish(PLUGIN_SCAN_TIMEOUT_MS);
+            const bool exitedOk = finished && (scanner.getExitCode() == 0);
+            
+            if (exitedOk && ! this->hasTimedOut())
+            {
+                this->completed = this->parseOutput(output);
+            }
+            else
+            {
+                Logger::writeToLog("Plugin scan failed: " + this->fileOrIdentifier);
+            }
+            
+            if (! finished)
+            {
+                scanner.kill();
+            }
+        }
+        
+        {
+            const ScopedLock lock(this->processLock);
+            this->process = nullptr;
+        }
+        
+        return jobHasFinished;
+    }
+    
+    void killIfTimedOut(bool force)
+    {
+        const ScopedLock lock(this->processLock);
+        
+        if (this->process == nullptr)
+        { return; }
+        
+        if (force ||
+            (Time::getMillisecondCounter() - this->startTime) > PLUGIN_SCAN_TIMEOUT_MS)
+        {
+            Logger::writeToLog("Plugin scan timed out: " + this->fileOrIdentifier);
+            this->timedOut = true;
+            this->process->kill();
+        }
+    }
+    
+    const String fileOrIdentifier;
+    OwnedArray<PluginDescription> typesFound;
+    
+    bool isCompleted() const noexcept
+    { return this->completed && !this->hasTimedOut(); }
+    
+private:
+    
+    bool hasTimedOut() const noexcept
+    {
+        const ScopedLock lock(this->processLock);
+        return this->timedOut;
+    }
+    
+    bool parseOutput(const String &output)
+    {
+        const int begin = output.indexOf(PluginManager::scanOutputBegin);
+        const int end = output.lastIndexOf(PluginManager::scanOutputEnd);
+        
+        if (begin < 0 || end < begin)
+        { return false; }
+        
+        const String results(output.substring(begin + PluginManager::scanOutputBegin.length(), end));
+        ScopedPointer<XmlElement> xml(XmlDocument::parse(results));
+        
+        if (xml == nullptr || ! xml->hasTagName(Serialization::Core::instrumentRoot))
+        { return false; }
+        
+        forEachXmlChildElementWithTagName(*xml, e, "PLUGIN")
+        {
+            auto description = new PluginDescription();
+            
+            if (description->loadFromXml(*e))
+            {
+                this->typesFound.add(description);
+            }
+            else
+            {
+                delete description;
+            }
+        }
+        
+        return true;
+    }
+    
+    CriticalSection processLock;
+    ChildProcess *process;
+    uint32 startTime;
+    
+    bool timedOut;
+    bool completed;
+    
+    JUCE_DECLARE_NON_COPYABLE(PluginScanJob)
+};
+
+void PluginManager::scanInSeparateProcesses(const StringArray &files)
+{
+    const int numProcesses = jlimit(1, PLUGIN_SCAN_MAX_PROCESSES, SystemStats::getNumCpus());
+    
+    OwnedArray<PluginScanJob> jobs;
+    ThreadPool pool(numProcesses);
+    
+    for (const auto &i : files)
+    {
+        auto job = new PluginScanJob(i);
+        jobs.add(job);
+        pool.addJob(job, false);
+    }
+    
+    // results are collected here as soon as each scanner is done,
+    // so the list fills up incrementally
+    while (jobs.size() > 0)
+    {
+        const bool shouldExit = this->threadShouldExit();
+        
+        if (shouldExit)
+        {
+            pool.removeAllJobs(true, 0);
+        }
+        
+        for (int i = jobs.size(); --i >= 0;)
+        {
+            PluginScanJob *job = jobs.getUnchecked(i);
+            
+            if (pool.contains(job))
+            {
+                job->killIfTimedOut(shouldExit);
+            }
+            else
+            {
+                if (! shouldExit)
+                {
+                    this->addScanResults(job->fileOrIdentifier, job->typesFound, job->isCompleted());
+                }
+                
+                jobs.remove(i);
+            }
+        }
+        
+        Thread::sleep(50);
+    }
+}
+
+void PluginManager::scanInThisProcess(const StringArray &files,
+                                      AudioPluginFormatManager &formatManager)
+{
+    for (const auto &pluginPath : files)
+    {
+        if (this->threadShouldExit())
+        { return; }
+        
+        Logger::writeToLog(pluginPath);
+        
+        KnownPluginList knownPluginList;
+        OwnedArray<PluginDescription> typesFound;
+        
+        try
+        {
+            for (int j = 0; j < formatManager.getNumFormats(); ++j)
+            {
+                AudioPluginFormat *format = formatManager.getFormat(j);
+                knownPluginList.scanAndAddFile(pluginPath, false, typesFound, *format);
+            }
+        }
+        catch (...) {}
+        
+        // если мы дошли до сих пор, то все хорошо и плагин нас не обрушил
+        this->addScanResults(pluginPath, typesFound, true);
+    }
+}
+
+void PluginManager::addScanResults(const String &fileOrIdentifier,
+                                   const OwnedArray<PluginDescription> &typesFound,
+                                   bool shouldCache)
+{
+    {
+        const ScopedWriteLock lock(this->pluginsListLock);
+        
+        for (auto type : typesFound)
+        {
+            this->pluginsList.addType(*type);
+        }
+    }
+    
+    if (shouldCache)
+    {
+        this->updateScanCache(fileOrIdentifier, typesFound);
+    }
+    
+    ++this->numFilesScanned;
+    this->sendChangeMessage();
+}
+
+
+//===----------------------------------------------------------------------===//
+// Scan cache
+//===----------------------------------------------------------------------===//
+
+void PluginManager::loadScanCache()
+{
+    this->scanCacheIndex.clear();
+    
+    const File cacheFile(FileUtils::getConfigSlot(PLUGIN_SCAN_CACHE_FILE));
+    
+    if (cacheFile.existsAsFile())
+    {
+        this->scanCache = DataEncoder::loadObfuscated(cacheFile);
+    }
+    
+    if (this->scanCache == nullptr ||
+        ! this->scanCache->hasTagName(Serialization::Core::pluginScanCache))
+    {
+        this->scanCache = new XmlElement(Serialization::Core::pluginScanCache);
+    }
+    
+    forEachXmlChildElementWithTagName(*this->scanCache, e, Serialization::Core::pluginScanCacheItem)
+    {
+        this->scanCacheIndex.set(e->getStringAttribute(Serialization::Core::pluginScanCachePath), e);
+    }
+}
+
+void PluginManager::saveScanCache() const
+{
+    const File cacheFile(FileUtils::getConfigSlot(PLUGIN_SCAN_CACHE_FILE));
+    
+    if (! cacheFile.getFullPathName().isEmpty())
+    {
+        DataEncoder::saveObfuscated(cacheFile, this->scanCache);
+    }
+}
+
+static bool isCacheableFile(const String &fileOrIdentifier)
+{
+    // built-in synths and some formats' identifiers are not files
+    return File::isAbsolutePath(fileOrIdentifier) && File(fileOrIdentifier).exists();
+}
+
+bool PluginManager::addCachedResults(const String &fileOrIdentifier)
+{
+    if (! isCacheableFile(fileOrIdentifier) ||
+        ! this->scanCacheIndex.contains(fileOrIdentifier))
+    {
+        return false;
+    }
+    
+    const File file(fileOrIdentifier);
+    const XmlElement *item = this->scanCacheIndex[fileOrIdentifier];
+    
+    const bool isUpToDate =
+        item->getStringAttribute(Serialization::Core::pluginScanCacheModified).getLargeIntValue() ==
+        file.getLastModificationTime().toMilliseconds() &&
+        item->getStringAttribute(Serialization::Core::pluginScanCacheSize).getLargeIntValue() ==
+        file.getSize();
+    
+    if (! isUpToDate)
+    {
+        return false;
+    }
+    
+    OwnedArray<PluginDescription> typesFound;
+    
+    forEachXmlChildElementWithTagName(*item, e, "PLUGIN")
+    {
+        auto description = new PluginDescription();
+        description->loadFromXml(*e);
+        typesFound.add(description);
+    }
+    
+    this->addScanResults(fileOrIdentifier, typesFound, false);
+    return true;
+}
+
+void PluginManager::updateScanCache(const String &fileOrIdentifier,
+                                    const OwnedArray<PluginDescription> &typesFound)
+{
+    if (! isCacheableFile(fileOrIdentifier))
+    {
+        return;
+    }
+    
+    if (XmlElement *oldItem = this->scanCacheIndex[fileOrIdentifier])
+    {
+        this->scanCache->removeChildElement(oldItem, true);
+    }
+    
+    const File file(fileOrIdentifier);
+    auto item = new XmlElement(Serialization::Core::pluginScanCacheItem);
+    item->setAttribute(Serialization::Core::pluginScanCachePath, fileOrIdentifier);
+    item->setAttribute(Serialization::Core::pluginScanCacheModified, String(file.getLastModificationTime().toMilliseconds()));
+    item->setAttribute(Serialization::Core::pluginScanCacheSize, String(file.getSize()));
+    
+    for (auto type : typesFound)
+    {
+        item->addChildElement(type->createXml());
+    }
+    
+    this->scanCache->addChildElement(item);
+    this->scanCacheIndex.set(fileOrIdentifier, item);
+}
+
+
 FileSearchPath PluginManager::getTypicalFolders()
 {
     FileSearchPath folders;
@@ -42,10 +42,18 @@ public:
 
     StringArray getFilesToScan() const;
 
+    // number of files processed in the current scan, and the total number of them
+    int getNumFilesScanned() const noexcept;
+    int getNumFilesToScan() const noexcept;
+
     void runInitialScan();
 
     void scanFolderAndAddResults(const File &dir);
 
+    // the scanner process wraps its results with these
+    static const String scanOutputBegin;
+    static const String scanOutputEnd;
+
 
     //===------------------------------------------------------------------===//
     // Thread
@@ -82,7 +90,40 @@ private:
     
     bool usingExternalProcess;
 
+    Atomic<int> numFilesScanned;
+    Atomic<int> numFilesToScan;
     
+
+    //===------------------------------------------------------------------===//
+    // Scanning
+    //===------------------------------------------------------------------===//
+
+    void scanInSeparateProcesses(const StringArray &files);
+
+    void scanInThisProcess(const StringArray &files,
+                           AudioPluginFormatManager &formatManager);
+
+    void addScanResults(const String &fileOrIdentifier,
+                        const OwnedArray<PluginDescription> &typesFound,
+                        bool shouldCache);
+
+
+    //===------------------------------------------------------------------===//
+    // Scan cache, accessed from the scanner thread only
+    //===------------------------------------------------------------------===//
+
+    // results are keyed by the plugin file path, and are valid
+    // while the file has the same modification time and size
+    ScopedPointer<XmlElement> scanCache;
+    HashMap<String, XmlElement *> scanCacheIndex;
+
+    void loadScanCache();
+    void saveScanCache() const;
+    bool addCachedResults(const String &fileOrIdentifier);
+    void updateScanCache(const String &fileOrIdentifier,
+                         const OwnedArray<PluginDescription> &typesFound);
+
+
     FileSearchPath getTypicalFolders();
 
     void scanPossibleSubfolders(const StringArray &possibleSubfolders,
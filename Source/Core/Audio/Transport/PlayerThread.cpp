@@ -67,7 +67,7 @@ void PlayerThread::run()
                                        currentTimeMs,
                                        msPerTick);
     
-    this->transport.broadcastTempoChanged(msPerTick);
+    this->transport.publishPlaybackState(absStartPosition, currentTimeMs, totalTimeMs, msPerTick);
     
     const double startPositionInTime = round(absStartPosition * this->transport.getTotalTime());
     const double endPositionInTime = round(absEndPosition * this->transport.getTotalTime());
@@ -145,10 +145,8 @@ void PlayerThread::run()
             
             while (deltaTime > UPDATE_TIME_MS)
             {
-                // fixme! extremely unsafe, no message manager lock gained
-                this->transport.broadcastSeek((targetTimeStamp - deltaTime / msPerTick) / this->transport.getTotalTime(),
-                                              currentTimeMs,
-                                              totalTimeMs);
+                this->transport.publishPlaybackState((targetTimeStamp - deltaTime / msPerTick) / this->transport.getTotalTime(),
+                                                     currentTimeMs, totalTimeMs, msPerTick);
                 
                 Time::waitForMillisecondCounter(Time::getMillisecondCounter() + UPDATE_TIME_MS);
                 
@@ -181,8 +179,8 @@ void PlayerThread::run()
                 //Logger::writeToLog("Track finished");
                 sendHoldingNotesOffAndMidiStop();
                 this->transport.allNotesControllersAndSoundOff();
-                this->transport.seekToPosition(this->transport.getSeekPosition());
-                this->transport.broadcastStop();
+                // the transport will rewind and notify listeners on the message thread
+                this->transport.publishPlaybackFinished();
                 return;
             }
         }
@@ -206,9 +204,8 @@ void PlayerThread::run()
         
         while (deltaTime > UPDATE_TIME_MS)
         {
-            this->transport.broadcastSeek((targetTimeStamp - deltaTime / msPerTick) / this->transport.getTotalTime(),
-                                          currentTimeMs,
-                                          totalTimeMs);
+            this->transport.publishPlaybackState((targetTimeStamp - deltaTime / msPerTick) / this->transport.getTotalTime(),
+                                                 currentTimeMs, totalTimeMs, msPerTick);
             
             Time::waitForMillisecondCounter(Time::getMillisecondCounter() + UPDATE_TIME_MS);
             
@@ -238,8 +235,8 @@ void PlayerThread::run()
         
         prevTimeStamp = nextEventTimeStamp;
 
-        this->transport.broadcastSeek(prevTimeStamp / this->transport.getTotalTime(),
-                                      currentTimeMs, totalTimeMs);
+        this->transport.publishPlaybackState(prevTimeStamp / this->transport.getTotalTime(),
+                                             currentTimeMs, totalTimeMs, msPerTick);
         
         if (shouldRewind)
         {
@@ -256,13 +253,15 @@ void PlayerThread::run()
             if (wrapper.message.isTempoMetaEvent())
             {
                 msPerTick = wrapper.message.getTempoSecondsPerQuarterNote() * 1000.f / TPQN;
-                this->transport.broadcastTempoChanged(msPerTick);
+                this->transport.publishPlaybackState(prevTimeStamp / this->transport.getTotalTime(),
+                                                     currentTimeMs, totalTimeMs, msPerTick);
                 
                 // Sends this to everybody (need to do that for drum-machines) - TODO test
                 sendTempoChangeToEverybody(wrapper.message);
             }
-            else
+            else if (wrapper.instrument == nullptr || wrapper.instrument->isReady())
             {
+                // instruments still being restored are just skipped
                 wrapper.listener->addMessageToQueue(wrapper.message);
             }
             
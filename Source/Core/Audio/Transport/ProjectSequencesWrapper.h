@@ -22,14 +22,34 @@
 
 class MidiSequence;
 
-struct SequenceWrapper : public ReferenceCountedObject
+// Midi messages of one track sequence, compiled once
+// and shared by all clip instances of that track
+struct CompiledSequence : public ReferenceCountedObject
 {
     MidiMessageSequence sequence;
+    typedef ReferenceCountedObjectPtr<CompiledSequence> Ptr;
+};
+
+// One clip instance: the shared messages plus the clip's offset,
+// which is applied to timestamps at read time
+struct SequenceWrapper : public ReferenceCountedObject
+{
+    CompiledSequence::Ptr compiled;
+    double timeOffset;
     int currentIndex;
     MidiMessageCollector *listener;
     Instrument *instrument;
     const MidiSequence *layer;
     typedef ReferenceCountedObjectPtr<SequenceWrapper> Ptr;
+
+    inline int getNumEvents() const noexcept
+    { return this->compiled->sequence.getNumEvents(); }
+
+    inline MidiMessageSequence::MidiEventHolder *getEventPointer(int index) const noexcept
+    { return this->compiled->sequence.getEventPointer(index); }
+
+    inline double getTimeStamp(int index) const noexcept
+    { return this->getEventPointer(index)->message.getTimeStamp() + this->timeOffset; }
 };
 
 struct MessageWrapper : public ReferenceCountedObject
@@ -130,25 +150,32 @@ public:
         for (int i = 0; i < this->sequences.size(); ++i)
         {
             SequenceWrapper *wrapper = this->sequences.getUnchecked(i);
-            wrapper->currentIndex = this->getNextIndexAtTime(wrapper->sequence, (position - DBL_MIN));
+            wrapper->currentIndex = this->getNextIndexAtTime(*wrapper, (position - DBL_MIN));
         }
     }
     
-    int getNextIndexAtTime(const MidiMessageSequence &sequence,
+    int getNextIndexAtTime(const SequenceWrapper &wrapper,
                            const double timeStamp) const
     {
-        const int numEvents = sequence.getNumEvents();
+        // the compiled messages are sorted by time, so just do a binary search
+        int start = 0;
+        int end = wrapper.getNumEvents();
         
-        int i = 0;
-        for (; i < numEvents; ++i)
+        while (start < end)
         {
-            if (sequence.getEventPointer(i)->message.getTimeStamp() >= timeStamp)
+            const int middle = (start + end) / 2;
+            
+            if (wrapper.getTimeStamp(middle) < timeStamp)
+            {
+                start = middle + 1;
+            }
+            else
             {
-                break;
+                end = middle;
             }
         }
         
-        return i;
+        return start;
     }
     
     void seekToZeroIndexes()
@@ -168,13 +195,13 @@ public:
         {
             SequenceWrapper *wrapper = this->sequences.getUnchecked(i);
 
-            if (wrapper->currentIndex < wrapper->sequence.getNumEvents())
+            if (wrapper->currentIndex < wrapper->getNumEvents())
             {
-                MidiMessage &message = wrapper->sequence.getEventPointer(wrapper->currentIndex)->message;
+                const double timeStamp = wrapper->getTimeStamp(wrapper->currentIndex);
 
-                if (message.getTimeStamp() < minTimeStamp)
+                if (timeStamp < minTimeStamp)
                 {
-                    minTimeStamp = message.getTimeStamp();
+                    minTimeStamp = timeStamp;
                     targetSequenceIndex = i;
                 }
             }
@@ -184,7 +211,7 @@ public:
         { return false; }
 
         SequenceWrapper *foundWrapper = this->sequences.getUnchecked(targetSequenceIndex);
-        MidiMessage &foundMessage = foundWrapper->sequence.getEventPointer(foundWrapper->currentIndex)->message;
+        const MidiMessage &foundMessage = foundWrapper->getEventPointer(foundWrapper->currentIndex)->message;
         foundWrapper->currentIndex++;
         
         //if (foundMessage.isTempoMetaEvent())
@@ -193,6 +220,7 @@ public:
         //}
         
         target.message = foundMessage;
+        target.message.addToTimeStamp(foundWrapper->timeOffset);
         target.listener = foundWrapper->listener;
         target.instrument = foundWrapper->instrument;
 
@@ -206,7 +234,7 @@ public:
         for (int i = 0; i < this->sequences.size(); ++i)
         {
             const SequenceWrapper *wrapper = this->sequences.getUnchecked(i);
-            const double &endTime = wrapper->sequence.getEndTime();
+            const double endTime = wrapper->compiled->sequence.getEndTime() + wrapper->timeOffset;
 
             if (lastEventTimestamp < endTime)
             {
@@ -18,6 +18,7 @@
 #include "Common.h"
 #include "Transport.h"
 #include "Instrument.h"
+#include "Pattern.h"
 #include "OrchestraPit.h"
 #include "PlayerThread.h"
 #include "RendererThread.h"
@@ -46,7 +47,10 @@ Transport::Transport(OrchestraPit &orchestraPit) :
     loopStart(0.0),
     loopEnd(0.0),
     projectFirstBeat(0.f),
-    projectLastBeat(DEFAULT_NUM_BARS * NUM_BEATS_IN_BAR)
+    projectLastBeat(DEFAULT_NUM_BARS * NUM_BEATS_IN_BAR),
+    playbackFinished(0),
+    lastDeliveredStateVersion(0),
+    lastDeliveredTempo(0.0)
 {
     this->player = new PlayerThread(*this);
     this->renderer = new RendererThread(*this);
@@ -56,6 +60,7 @@ Transport::Transport(OrchestraPit &orchestraPit) :
 
 Transport::~Transport()
 {
+    this->stopTimer();
     this->orchestra.removeOrchestraListener(this);
     
     if (this->player->isThreadRunning())
@@ -184,14 +189,14 @@ void Transport::probeSoundAt(double absTrackPosition, const MidiSequence *limitT
     {
         SequenceWrapper::Ptr seq(i);
 
-        for (int j = 0; j < seq->sequence.getNumEvents(); ++j)
+        for (int j = 0; j < seq->getNumEvents(); ++j)
         {
-            MidiMessageSequence::MidiEventHolder *noteOnHolder = seq->sequence.getEventPointer(j);
+            MidiMessageSequence::MidiEventHolder *noteOnHolder = seq->getEventPointer(j);
             
             if (MidiMessageSequence::MidiEventHolder *noteOffHolder = noteOnHolder->noteOffObject)
             {
-                const double noteOn(noteOnHolder->message.getTimeStamp());
-                const double noteOff(noteOffHolder->message.getTimeStamp());
+                const double noteOn(noteOnHolder->message.getTimeStamp() + seq->timeOffset);
+                const double noteOff(noteOffHolder->message.getTimeStamp() + seq->timeOffset);
                 
                 if (noteOn <= targetFlatTime && noteOff > targetFlatTime)
                 {
@@ -216,8 +221,10 @@ void Transport::startPlayback()
     }
     
     this->loopedMode = false;
+    this->playbackFinished = 0;
     
     this->player->startThread(10);
+    this->startTimerHz(60);
     this->broadcastPlay();
 }
 
@@ -235,8 +242,10 @@ void Transport::startPlaybackLooped(double absLoopStart, double absLoopEnd)
     this->loopedMode = true;
     this->loopStart = jmax(0.0, absLoopStart);
     this->loopEnd = jmin(1.0, absLoopEnd);
+    this->playbackFinished = 0;
     
     this->player->startThread(10);
+    this->startTimerHz(60);
     this->broadcastPlay();
 }
 
@@ -246,6 +255,8 @@ void Transport::stopPlayback()
         !this->player->threadShouldExit())
     {
         this->player->stopThread(PLAYER_THREAD_STOP_TIME_MS);
+        this->stopTimer();
+        this->playbackFinished = 0;
         this->allNotesControllersAndSoundOff();
         this->loopedMode = false;
         this->seekToPosition(this->getSeekPosition());
@@ -333,8 +344,13 @@ void Transport::sendMidiMessage(const String &layerId, const MidiMessage &messag
     messageTimestampedAsNow.setTimeStamp(Time::getMillisecondCounterHiRes() * 0.001);
 #endif
     
+    Instrument *instrument = this->linksCache[layerId];
+    
+    if (instrument == nullptr || !instrument->isReady())
+    { return; }
+    
     MidiMessageCollector *collector =
-    &this->linksCache[layerId]->getProcessorPlayer().getMidiMessageCollector();
+    &instrument->getProcessorPlayer().getMidiMessageCollector();
     
     collector->addMessageToQueue(messageTimestampedAsNow);
 }
@@ -450,7 +466,7 @@ void Transport::onChangeMidiEvent(const MidiEvent &oldEvent, const MidiEvent &ne
         this->seekToPosition(this->getSeekPosition());
     }
     
-    this->sequencesAreOutdated = true;
+    this->invalidateCompiledSequence(newEvent.getSequence());
 }
 
 void Transport::onAddMidiEvent(const MidiEvent &event)
@@ -466,7 +482,7 @@ void Transport::onAddMidiEvent(const MidiEvent &event)
         this->seekToPosition(this->getSeekPosition());
     }
     
-    this->sequencesAreOutdated = true;
+    this->invalidateCompiledSequence(event.getSequence());
 }
 
 void Transport::onRemoveMidiEvent(const MidiEvent &event)
@@ -476,7 +492,35 @@ void Transport::onRemoveMidiEvent(const MidiEvent &event)
     if (this->player->isThreadRunning())
     { this->stopPlayback(); }
     
-    this->sequencesAreOutdated = true;
+    this->invalidateCompiledSequence(event.getSequence());
+}
+
+// All events of a group belong to the same sequence,
+// and everything done above is per-sequence, so the first event is enough
+
+void Transport::onAddMidiEvents(const Array<const MidiEvent *> &events)
+{
+    if (events.size() > 0)
+    {
+        this->onAddMidiEvent(*events.getFirst());
+    }
+}
+
+void Transport::onChangeMidiEvents(const Array<const MidiEvent *> &oldEvents,
+    const Array<const MidiEvent *> &newEvents)
+{
+    if (newEvents.size() > 0)
+    {
+        this->onChangeMidiEvent(*oldEvents.getFirst(), *newEvents.getFirst());
+    }
+}
+
+void Transport::onRemoveMidiEvents(const Array<const MidiEvent *> &events)
+{
+    if (events.size() > 0)
+    {
+        this->onRemoveMidiEvent(*events.getFirst());
+    }
 }
 
 void Transport::onPostRemoveMidiEvent(MidiSequence *const layer)
@@ -490,7 +534,7 @@ void Transport::onPostRemoveMidiEvent(MidiSequence *const layer)
         this->seekToPosition(this->getSeekPosition());
     }
     
-    this->sequencesAreOutdated = true;
+    this->invalidateCompiledSequence(layer);
 }
 
 void Transport::onChangeTrackProperties(MidiTrack *const track)
@@ -504,10 +548,35 @@ void Transport::onResetTrackContent(MidiTrack *const track)
     if (this->player->isThreadRunning())
     { this->stopPlayback(); }
 
-    this->sequencesAreOutdated = true;
+    this->invalidateCompiledSequence(track->getSequence());
     this->updateLinkForTrack(track);
 }
 
+void Transport::onAddClip(const Clip &clip)
+{
+    if (this->player->isThreadRunning())
+    { this->stopPlayback(); }
+    
+    // clips only change the offsets, no need to recompile anything
+    this->sequencesAreOutdated = true;
+}
+
+void Transport::onChangeClip(const Clip &oldClip, const Clip &newClip)
+{
+    if (this->player->isThreadRunning())
+    { this->stopPlayback(); }
+    
+    this->sequencesAreOutdated = true;
+}
+
+void Transport::onRemoveClip(const Clip &clip)
+{
+    if (this->player->isThreadRunning())
+    { this->stopPlayback(); }
+    
+    this->sequencesAreOutdated = true;
+}
+
 void Transport::onAddTrack(MidiTrack *const track)
 {
     if (this->player->isThreadRunning())
@@ -523,7 +592,7 @@ void Transport::onRemoveTrack(MidiTrack *const track)
     if (this->player->isThreadRunning())
     {this->stopPlayback(); }
     
-    this->sequencesAreOutdated = true;
+    this->invalidateCompiledSequence(track->getSequence());
     this->tracksCache.removeAllInstancesOf(track);
     this->removeLinkForTrack(track);
 }
@@ -647,20 +716,52 @@ void Transport::rebuildSequencesIfNeeded()
         
         for (int i = 0; i < this->tracksCache.size(); ++i)
         {
-            const auto layer = this->tracksCache.getUnchecked(i)->getSequence();
-            MidiMessageSequence sequence(layer->exportMidi());
-            sequence.addTimeToMessages(-this->trackStartMs);
+            const auto track = this->tracksCache.getUnchecked(i);
+            const auto layer = track->getSequence();
+            
+            // each sequence is compiled only once, and only when it has changed,
+            // all the clips of the track share the same compiled messages
+            CompiledSequence::Ptr compiled(this->compiledSequences[layer]);
+            
+            if (compiled == nullptr)
+            {
+                compiled = new CompiledSequence();
+                compiled->sequence = layer->exportMidi();
+                this->compiledSequences.set(layer, compiled);
+            }
             
-            if (sequence.getNumEvents() > 0)
+            if (compiled->sequence.getNumEvents() == 0)
+            {
+                continue;
+            }
+            
+            Instrument *targetInstrument = this->linksCache[layer->getTrackId()];
+            
+            auto addClipInstance = [&](float clipBeat)
             {
-                Instrument *targetInstrument = this->linksCache[layer->getTrackId()];
                 auto wrapper = new SequenceWrapper();
                 wrapper->layer = layer;
-                wrapper->sequence = sequence;
+                wrapper->compiled = compiled;
+                wrapper->timeOffset = clipBeat * Transport::millisecondsPerBeat - this->trackStartMs;
                 wrapper->currentIndex = 0;
                 wrapper->instrument = targetInstrument;
                 wrapper->listener = &targetInstrument->getProcessorPlayer().getMidiMessageCollector();
                 this->sequences.addWrapper(wrapper);
+            };
+            
+            // tracks without any clips are played as is
+            const Pattern *pattern = track->getPattern();
+            
+            if (pattern == nullptr || pattern->size() == 0)
+            {
+                addClipInstance(0.f);
+            }
+            else
+            {
+                for (const auto &clip : *pattern)
+                {
+                    addClipInstance(clip.getStartBeat());
+                }
             }
         }
         
@@ -668,6 +769,12 @@ void Transport::rebuildSequencesIfNeeded()
     }
 }
 
+void Transport::invalidateCompiledSequence(const MidiSequence *sequence)
+{
+    this->compiledSequences.remove(sequence);
+    this->sequencesAreOutdated = true;
+}
+
 ProjectSequences Transport::getSequences()
 {
     // todo add lock
@@ -736,6 +843,17 @@ void Transport::broadcastSeek(const double newPosition,
     this->transportListeners.call(&TransportListener::onSeek, newPosition, currentTimeMs, totalTimeMs);
 }
 
+void Transport::publishPlaybackState(const double newPosition,
+    const double currentTimeMs, const double totalTimeMs, const double tempo) noexcept
+{
+    this->playbackState.publish(newPosition, currentTimeMs, totalTimeMs, tempo);
+}
+
+void Transport::publishPlaybackFinished() noexcept
+{
+    this->playbackFinished = 1;
+}
+
 void Transport::broadcastTempoChanged(const double newTempo)
 {
     this->transportListeners.call(&TransportListener::onTempoChanged, newTempo);
@@ -755,3 +873,88 @@ void Transport::broadcastStop()
 {
     this->transportListeners.call(&TransportListener::onStop);
 }
+
+
+//===----------------------------------------------------------------------===//
+// Playback state
+//===----------------------------------------------------------------------===//
+
+Transport::PlaybackStateSnapshot::PlaybackStateSnapshot() noexcept :
+    version(0),
+    position(0.0),
+    currentTimeMs(0.0),
+    totalTimeMs(0.0),
+    tempo(0.0) {}
+
+void Transport::PlaybackStateSnapshot::publish(double newPosition, double newCurrentTimeMs,
+    double newTotalTimeMs, double newTempo) noexcept
+{
+    // the only writer is the player thread (there's a single one, and it is
+    // always stopped before being started again), so no write lock is needed
+
+    this->version += 1; // odd means the state is being written
+    this->position = newPosition;
+    this->currentTimeMs = newCurrentTimeMs;
+    this->totalTimeMs = newTotalTimeMs;
+    this->tempo = newTempo;
+    this->version += 1;
+}
+
+uint32 Transport::PlaybackStateSnapshot::read(double &outPosition, double &outCurrentTimeMs,
+    double &outTotalTimeMs, double &outTempo) const noexcept
+{
+    while (true)
+    {
+        const uint32 versionBefore = this->version.get();
+
+        if ((versionBefore & 1) == 0)
+        {
+            outPosition = this->position.get();
+            outCurrentTimeMs = this->currentTimeMs.get();
+            outTotalTimeMs = this->totalTimeMs.get();
+            outTempo = this->tempo.get();
+
+            if (this->version.get() == versionBefore)
+            {
+                return versionBefore;
+            }
+        }
+    }
+}
+
+void Transport::deliverPlaybackState()
+{
+    double position = 0.0;
+    double currentTimeMs = 0.0;
+    double totalTimeMs = 0.0;
+    double tempo = 0.0;
+
+    const uint32 stateVersion = this->playbackState.read(position, currentTimeMs, totalTimeMs, tempo);
+
+    if (stateVersion == this->lastDeliveredStateVersion)
+    {
+        return;
+    }
+
+    this->lastDeliveredStateVersion = stateVersion;
+
+    if (tempo != this->lastDeliveredTempo)
+    {
+        this->lastDeliveredTempo = tempo;
+        this->broadcastTempoChanged(tempo);
+    }
+
+    this->broadcastSeek(position, currentTimeMs, totalTimeMs);
+}
+
+void Transport::timerCallback()
+{
+    this->deliverPlaybackState();
+
+    if (this->playbackFinished.compareAndSetBool(0, 1))
+    {
+        this->stopTimer();
+        this->seekToPosition(this->getSeekPosition());
+        this->broadcastStop();
+    }
+}
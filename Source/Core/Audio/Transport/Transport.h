@@ -27,7 +27,9 @@ class RendererThread;
 #include "ProjectListener.h"
 #include "OrchestraListener.h"
 
-class Transport : public ProjectListener, private OrchestraListener
+class Transport : public ProjectListener,
+                  private OrchestraListener,
+                  private Timer
 {
 public:
 
@@ -100,11 +102,20 @@ public:
     void onRemoveMidiEvent(const MidiEvent &event) override;
     void onPostRemoveMidiEvent(MidiSequence *const layer) override;
 
+    void onAddMidiEvents(const Array<const MidiEvent *> &events) override;
+    void onChangeMidiEvents(const Array<const MidiEvent *> &oldEvents,
+        const Array<const MidiEvent *> &newEvents) override;
+    void onRemoveMidiEvents(const Array<const MidiEvent *> &events) override;
+
     void onAddTrack(MidiTrack *const track) override;
     void onRemoveTrack(MidiTrack *const track) override;
     void onChangeTrackProperties(MidiTrack *const track) override;
     void onResetTrackContent(MidiTrack *const track) override;
 
+    void onAddClip(const Clip &clip) override;
+    void onChangeClip(const Clip &oldClip, const Clip &newClip) override;
+    void onRemoveClip(const Clip &clip) override;
+
     void onChangeProjectBeatRange(float firstBeat, float lastBeat) override;
     void onChangeViewBeatRange(float firstBeat, float lastBeat) override {}
 
@@ -128,6 +139,15 @@ protected:
                        const double currentTimeMs,
                        const double totalTimeMs);
 
+    // Called by the player thread instead of broadcasting directly:
+    // listeners are notified from the message thread at the display rate,
+    // no matter how dense the played events are
+    void publishPlaybackState(const double newPosition,
+                              const double currentTimeMs,
+                              const double totalTimeMs,
+                              const double tempo) noexcept;
+    void publishPlaybackFinished() noexcept;
+
 private:
     
     OrchestraPit &orchestra;
@@ -146,6 +166,9 @@ private:
     ProjectSequences sequences;
     bool sequencesAreOutdated;
     
+    HashMap<const MidiSequence *, CompiledSequence::Ptr> compiledSequences;
+    void invalidateCompiledSequence(const MidiSequence *sequence);
+    
     Array<const MidiTrack *> tracksCache;
     HashMap<String, Instrument *> linksCache; // layer id : instrument
     
@@ -174,5 +197,41 @@ private:
 
     ListenerList<TransportListener> transportListeners;
 
+private:
+
+    // A seqlock with a single writer, the player thread:
+    // the UI never blocks the player and never reads a torn state
+    class PlaybackStateSnapshot final
+    {
+    public:
+
+        PlaybackStateSnapshot() noexcept;
+
+        void publish(double position, double currentTimeMs,
+                     double totalTimeMs, double tempo) noexcept;
+
+        // Returns the version of the state read
+        uint32 read(double &position, double &currentTimeMs,
+                    double &totalTimeMs, double &tempo) const noexcept;
+
+    private:
+
+        Atomic<uint32> version;
+        Atomic<double> position;
+        Atomic<double> currentTimeMs;
+        Atomic<double> totalTimeMs;
+        Atomic<double> tempo;
+
+    };
+
+    PlaybackStateSnapshot playbackState;
+    Atomic<int> playbackFinished;
+
+    uint32 lastDeliveredStateVersion;
+    double lastDeliveredTempo;
+
+    void deliverPlaybackState();
+    void timerCallback() override;
+
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(Transport)
 };
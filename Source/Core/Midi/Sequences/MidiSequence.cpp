@@ -193,6 +193,28 @@ void MidiSequence::notifyEventRemovedPostAction()
     this->eventDispatcher.dispatchPostRemoveEvent(this);
 }
 
+void MidiSequence::notifyEventsChanged(const Array<const MidiEvent *> &oldEvents,
+                                       const Array<const MidiEvent *> &newEvents)
+{
+    if (oldEvents.size() == 0) { return; }
+    this->cacheIsOutdated = true;
+    this->eventDispatcher.dispatchChangeEvents(oldEvents, newEvents);
+}
+
+void MidiSequence::notifyEventsAdded(const Array<const MidiEvent *> &events)
+{
+    if (events.size() == 0) { return; }
+    this->cacheIsOutdated = true;
+    this->eventDispatcher.dispatchAddEvents(events);
+}
+
+void MidiSequence::notifyEventsRemoved(const Array<const MidiEvent *> &events)
+{
+    if (events.size() == 0) { return; }
+    this->cacheIsOutdated = true;
+    this->eventDispatcher.dispatchRemoveEvents(events);
+}
+
 void MidiSequence::notifySequenceChanged()
 {
     this->cacheIsOutdated = true;
@@ -103,6 +103,10 @@ public:
     void notifyEventAdded(const MidiEvent &event);
     void notifyEventRemoved(const MidiEvent &event);
     void notifyEventRemovedPostAction();
+    void notifyEventsChanged(const Array<const MidiEvent *> &oldEvents,
+                             const Array<const MidiEvent *> &newEvents);
+    void notifyEventsAdded(const Array<const MidiEvent *> &events);
+    void notifyEventsRemoved(const Array<const MidiEvent *> &events);
     void notifySequenceChanged();
     void notifyBeatRangeChanged();
     void updateBeatRange(bool shouldNotifyIfChanged);
@@ -41,14 +41,31 @@ PianoSequence::PianoSequence(MidiTrack &track,
 //===----------------------------------------------------------------------===//
 
 void PianoSequence::importMidi(const MidiMessageSequence &sequence)
+{
+    this->importNotes(PianoSequence::parseMidi(sequence));
+}
+
+void PianoSequence::importNotes(const Array<Note> &notes)
 {
     this->clearUndoHistory();
     this->checkpoint();
     this->reset();
 
+    this->silentImportAll(notes);
+
+    this->notifyBeatRangeChanged();
+    this->notifySequenceChanged();
+}
+
+Array<Note> PianoSequence::parseMidi(const MidiMessageSequence &sequence)
+{
+    Array<Note> result;
+    result.ensureStorageAllocated(sequence.getNumEvents() / 2);
+
     for (int i = 0; i < sequence.getNumEvents(); ++i)
     {
-        const MidiMessage &messageOn = sequence.getEventPointer(i)->message;
+        const MidiMessageSequence::MidiEventHolder *holderOn = sequence.getEventPointer(i);
+        const MidiMessage &messageOn = holderOn->message;
 
         if (messageOn.isNoteOn())
         {
@@ -58,27 +75,80 @@ void PianoSequence::importMidi(const MidiMessageSequence &sequence)
             const float beat = float(startTimestamp);
 
             // ищем соответствующий note-off:
-            const int noteOffIndex = sequence.getIndexOfMatchingKeyUp(i);
-
-            if (noteOffIndex > 0)
+            // getIndexOfMatchingKeyUp делает линейный поиск индекса,
+            // а нам достаточно самого события, которое midi file уже сопоставил
+            if (const MidiMessageSequence::MidiEventHolder *holderOff = holderOn->noteOffObject)
             {
-                const MidiMessage &messageOff = sequence.getEventPointer(noteOffIndex)->message;
-                const double endTimestamp = messageOff.getTimeStamp() / MIDI_IMPORT_SCALE;
+                const double endTimestamp = holderOff->message.getTimeStamp() / MIDI_IMPORT_SCALE;
 
                 if (endTimestamp > startTimestamp)
                 {
                     const float length = float(endTimestamp - startTimestamp);
-
-                    // bottleneck warning!
-                    const Note note(this, key, beat, length, velocity);
-                    this->silentImport(note);
+                    result.add(Note(nullptr, key, beat, length, velocity));
                 }
             }
         }
     }
 
-    this->notifyBeatRangeChanged();
-    this->notifySequenceChanged();
+    return result;
+}
+
+class MidiTrackParsingJob final : public ThreadPoolJob
+{
+public:
+
+    MidiTrackParsingJob(const MidiMessageSequence &sequence, Array<Note> &result) :
+        ThreadPoolJob("Midi Track Parsing Job"),
+        sequence(sequence),
+        result(result) {}
+
+    JobStatus runJob() override
+    {
+        this->result = PianoSequence::parseMidi(this->sequence);
+        return jobHasFinished;
+    }
+
+private:
+
+    const MidiMessageSequence &sequence;
+    Array<Note> &result;
+
+};
+
+void PianoSequence::parseMidiTracks(const MidiFile &file, OwnedArray<Array<Note>> &outTracks)
+{
+    const int numTracks = file.getNumTracks();
+
+    for (int i = 0; i < numTracks; ++i)
+    {
+        outTracks.add(new Array<Note>());
+    }
+
+    if (numTracks <= 1)
+    {
+        for (int i = 0; i < numTracks; ++i)
+        {
+            *outTracks[i] = PianoSequence::parseMidi(*file.getTrack(i));
+        }
+
+        return;
+    }
+
+    // the tracks are independent, so each one is converted on its own thread;
+    // the jobs are owned here, since the pool's destructor would drop the ones not started yet
+    ThreadPool pool(jmin(numTracks, SystemStats::getNumCpus()));
+    OwnedArray<MidiTrackParsingJob> jobs;
+
+    for (int i = 0; i < numTracks; ++i)
+    {
+        auto job = jobs.add(new MidiTrackParsingJob(*file.getTrack(i), *outTracks[i]));
+        pool.addJob(job, false);
+    }
+
+    for (auto job : jobs)
+    {
+        pool.waitForJobToFinish(job, -1);
+    }
 }
 
 
@@ -103,6 +173,31 @@ void PianoSequence::silentImport(const MidiEvent &eventToImport)
     this->updateBeatRange(false);
 }
 
+void PianoSequence::silentImportAll(const Array<Note> &notes)
+{
+    this->midiEvents.ensureStorageAllocated(this->midiEvents.size() + notes.size());
+
+    // avoid re-hashing the table over and over again while it grows
+    const int expectedNumNotes = this->midiEvents.size() + notes.size();
+    if (this->notesHashTable.getNumSlots() < expectedNumNotes)
+    {
+        this->notesHashTable.remapTable(expectedNumNotes);
+    }
+
+    for (const auto &note : notes)
+    {
+        if (this->notesHashTable.contains(note))
+        { continue; }
+
+        auto const storedNote = new Note(this, note);
+        this->midiEvents.add(storedNote); // sorted later
+        this->notesHashTable.set(note, storedNote);
+    }
+
+    this->sort();
+    this->updateBeatRange(false);
+}
+
 MidiEvent *PianoSequence::insert(const Note &note, const bool undoable)
 {
     if (this->notesHashTable.contains(note))
@@ -207,6 +302,9 @@ bool PianoSequence::insertGroup(Array<Note> &notes, bool undoable)
     }
     else
     {
+        Array<const MidiEvent *> addedNotes;
+        addedNotes.ensureStorageAllocated(notes.size());
+        
         for (int i = 0; i < notes.size(); ++i)
         {
             const Note &note = notes.getUnchecked(i);
@@ -214,9 +312,10 @@ bool PianoSequence::insertGroup(Array<Note> &notes, bool undoable)
             
             this->midiEvents.add(storedNote); // sorted later
             this->notesHashTable.set(note, storedNote);
-            this->notifyEventAdded(*storedNote);
+            addedNotes.add(storedNote);
         }
 
+        this->notifyEventsAdded(addedNotes);
         this->sort();
         this->updateBeatRange(true);
     }
@@ -234,21 +333,42 @@ bool PianoSequence::removeGroup(Array<Note> &notes, bool undoable)
     }
     else
     {
+        Array<const MidiEvent *> removedNotes;
+        removedNotes.ensureStorageAllocated(notes.size());
+        
         for (int i = 0; i < notes.size(); ++i)
         {
             const Note &note = notes.getUnchecked(i);
 
             if (Note *matchingNote = this->notesHashTable[note])
             {
-                this->notifyEventRemoved(*matchingNote);
-                
-                const int matchingNoteIndex = this->indexOfSorted(matchingNote);
-                this->midiEvents.remove(matchingNoteIndex, true);
-                //this->midiEvents.removeObject(matchingNote);
-                
+                removedNotes.add(matchingNote);
                 this->notesHashTable.remove(note);
             }
         }
+        
+        // listeners still need the notes alive
+        this->notifyEventsRemoved(removedNotes);
+        
+        // compact the array in a single pass instead of shifting it for every removed note
+        std::sort(removedNotes.begin(), removedNotes.end());
+
+        int numKeptNotes = 0;
+        for (int i = 0; i < this->midiEvents.size(); ++i)
+        {
+            MidiEvent *event = this->midiEvents.getUnchecked(i);
+
+            if (std::binary_search(removedNotes.begin(), removedNotes.end(), event))
+            {
+                delete event;
+            }
+            else
+            {
+                this->midiEvents.set(numKeptNotes++, event, false);
+            }
+        }
+
+        this->midiEvents.removeLast(this->midiEvents.size() - numKeptNotes, false);
 
         this->updateBeatRange(true);
         this->notifyEventRemovedPostAction();
@@ -272,20 +392,27 @@ bool PianoSequence::changeGroup(Array<Note> &notesBefore,
     }
     else
     {
+        Array<const MidiEvent *> oldNotes;
+        Array<const MidiEvent *> newNotes;
+        oldNotes.ensureStorageAllocated(notesBefore.size());
+        newNotes.ensureStorageAllocated(notesBefore.size());
+        
         for (int i = 0; i < notesBefore.size(); ++i)
         {
-            const Note &note = notesBefore.getUnchecked(i);
-            const Note &newNote = notesAfter.getUnchecked(i);
+            const Note &note = notesBefore.getReference(i);
+            const Note &newNote = notesAfter.getReference(i);
 
             if (Note *matchingNote = this->notesHashTable[note])
             {
                 (*matchingNote) = newNote;
 
                 this->notesHashTable.set(newNote, matchingNote);
-                this->notifyEventChanged(note, *matchingNote);
+                oldNotes.add(&note);
+                newNotes.add(matchingNote);
             }
         }
 
+        this->notifyEventsChanged(oldNotes, newNotes);
         this->sort();
         this->updateBeatRange(true);
     }
@@ -35,12 +35,23 @@ public:
 
     void importMidi(const MidiMessageSequence &sequence) override;
 
+    void importNotes(const Array<Note> &notes);
+
+    // Converts note-on/note-off pairs into notes without touching any sequence,
+    // so that the tracks of a midi file can be converted in parallel
+    static Array<Note> parseMidi(const MidiMessageSequence &sequence);
+    static void parseMidiTracks(const MidiFile &file, OwnedArray<Array<Note>> &outTracks);
+
 
     //===------------------------------------------------------------------===//
     // Undoable track editing
     //===------------------------------------------------------------------===//
 
     void silentImport(const MidiEvent &eventToImport) override;
+
+    // Same as silentImport, but for a whole bunch of notes:
+    // appends them all, sorts once and fills the hash table in one pass
+    void silentImportAll(const Array<Note> &notes);
     
     
     MidiEvent *insert(const Note &note, const bool undoable);
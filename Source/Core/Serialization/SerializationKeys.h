@@ -99,6 +99,11 @@ namespace Serialization
         static const String disabledState = "Disabled";
 
         static const String pluginManager = "PluginManager";
+        static const String pluginScanCache = "PluginScanCache";
+        static const String pluginScanCacheItem = "File";
+        static const String pluginScanCachePath = "Path";
+        static const String pluginScanCacheModified = "Modified";
+        static const String pluginScanCacheSize = "Size";
         static const String audioSettings = "AudioSettings";
         static const String audioCore = "AudioCore";
         static const String orchestra = "Orchestra";
@@ -259,6 +264,7 @@ namespace Serialization
         static const String packItem = "Record";
         static const String packItemRevId = "ItemId";
         static const String packItemDeltaId = "DeltaId";
+        static const String packItemContentHash = "Hash";
 
         static const String revision = "Revision";
         static const String head = "Head";
@@ -358,6 +364,7 @@ namespace Serialization
     {
         static const String undoStack = "UndoStack";
         static const String transaction = "Transaction";
+        static const String historyStamp = "UndoHistoryStamp";
 
         static const String name = "Name";
         static const String xPath = "Path";
@@ -388,6 +388,31 @@ void MidiTrackTreeItem::dispatchPostRemoveEvent(MidiSequence *const layer)
     }
 }
 
+void MidiTrackTreeItem::dispatchAddEvents(const Array<const MidiEvent *> &events)
+{
+    if (this->lastFoundParent != nullptr)
+    {
+        this->lastFoundParent->broadcastAddEvents(events);
+    }
+}
+
+void MidiTrackTreeItem::dispatchChangeEvents(const Array<const MidiEvent *> &oldEvents,
+                                             const Array<const MidiEvent *> &newEvents)
+{
+    if (this->lastFoundParent != nullptr)
+    {
+        this->lastFoundParent->broadcastChangeEvents(oldEvents, newEvents);
+    }
+}
+
+void MidiTrackTreeItem::dispatchRemoveEvents(const Array<const MidiEvent *> &events)
+{
+    if (this->lastFoundParent != nullptr)
+    {
+        this->lastFoundParent->broadcastRemoveEvents(events);
+    }
+}
+
 void MidiTrackTreeItem::dispatchChangeTrackProperties(MidiTrack *const track)
 {
     if (this->lastFoundParent != nullptr)
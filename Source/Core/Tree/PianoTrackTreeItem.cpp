@@ -333,10 +333,13 @@ void PianoTrackTreeItem::resetEventsDelta(const XmlElement *state)
     //this->reset(); // TODO test
     this->getSequence()->reset();
 
+    Array<Note> notes;
     forEachXmlChildElementWithTagName(*state, e, Serialization::Core::note)
     {
-        this->getSequence()->silentImport(Note(this->getSequence()).withParameters(*e));
+        notes.add(Note(this->getSequence()).withParameters(*e));
     }
+
+    static_cast<PianoSequence *>(this->getSequence())->silentImportAll(notes);
 }
 
 // TODO manage clip deltas
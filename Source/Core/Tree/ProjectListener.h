@@ -36,6 +36,30 @@ public:
     virtual void onRemoveMidiEvent(const MidiEvent &event) = 0;
     virtual void onPostRemoveMidiEvent(MidiSequence *const layer) {}
 
+    // Sent once for a group of events of the same sequence changed at once;
+    // listeners that can handle the whole group faster should override these,
+    // otherwise they fall back to the per-event callbacks above
+
+    virtual void onAddMidiEvents(const Array<const MidiEvent *> &events)
+    {
+        for (const auto event : events)
+        { this->onAddMidiEvent(*event); }
+    }
+
+    virtual void onChangeMidiEvents(const Array<const MidiEvent *> &oldEvents,
+                                    const Array<const MidiEvent *> &newEvents)
+    {
+        jassert(oldEvents.size() == newEvents.size());
+        for (int i = 0; i < oldEvents.size(); ++i)
+        { this->onChangeMidiEvent(*oldEvents.getUnchecked(i), *newEvents.getUnchecked(i)); }
+    }
+
+    virtual void onRemoveMidiEvents(const Array<const MidiEvent *> &events)
+    {
+        for (const auto event : events)
+        { this->onRemoveMidiEvent(*event); }
+    }
+
     virtual void onAddClip(const Clip &clip) {}
     virtual void onChangeClip(const Clip &oldClip, const Clip &newClip) {}
     virtual void onRemoveClip(const Clip &clip) {}
@@ -36,6 +36,9 @@
 #include "SequencerLayout.h"
 #include "MidiEvent.h"
 #include "MidiSequence.h"
+#include "MidiTrack.h"
+#include "Pattern.h"
+#include "Transport.h"
 #include "PianoSequence.h"
 #include "AutomationSequence.h"
 #include "Icons.h"
@@ -60,33 +63,53 @@
 #include "Config.h"
 #include "SerializationKeys.h"
 
+#include <queue>
+
+static File getUndoHistoryFile(const File &projectFile)
+{
+    return projectFile.withFileExtension("hpundo");
+}
 
 ProjectTreeItem::ProjectTreeItem(const String &name) :
     DocumentOwner(App::Workspace(), name, "hp"),
     TreeItem(name, Serialization::Core::project)
 {
-    this->initialize();
+    this->initialize(App::Workspace().getAudioCore(), false);
 }
 
 ProjectTreeItem::ProjectTreeItem(const File &existingFile) :
     DocumentOwner(App::Workspace(), existingFile),
     TreeItem(existingFile.getFileNameWithoutExtension(), Serialization::Core::project)
 {
-    this->initialize();
+    this->initialize(App::Workspace().getAudioCore(), false);
 }
 
-void ProjectTreeItem::initialize()
+ProjectTreeItem::ProjectTreeItem(const File &existingFile, OrchestraPit &orchestra) :
+    DocumentOwner(App::Workspace(), existingFile),
+    TreeItem(existingFile.getFileNameWithoutExtension(), Serialization::Core::project)
+{
+    this->initialize(orchestra, true);
+}
+
+void ProjectTreeItem::initialize(OrchestraPit &orchestra, bool headless)
 {
     this->isLayersHashOutdated = true;
+    this->isHeadless = headless;
     
     this->undoStack = new UndoStack(*this);
     
-    this->autosaver = new Autosaver(*this);
+    if (! this->isHeadless)
+    {
+        this->autosaver = new Autosaver(*this);
+    }
 
-    this->transport = new Transport(App::Workspace().getAudioCore());
+    this->transport = new Transport(orchestra);
     this->addListener(this->transport);
     
-    this->recentFilesList = &App::Workspace().getRecentFilesList();
+    if (! this->isHeadless)
+    {
+        this->recentFilesList = &App::Workspace().getRecentFilesList();
+    }
     
     this->info = new ProjectInfo(*this);
     this->vcsItems.add(this->info);
@@ -96,14 +119,20 @@ void ProjectTreeItem::initialize()
 
     this->transport->seekToPosition(0.0);
     
-    this->recreatePage();
+    if (! this->isHeadless)
+    {
+        this->recreatePage();
+    }
 }
 
 
 ProjectTreeItem::~ProjectTreeItem()
 {
     // the main policy: all data is to be autosaved
-    this->getDocument()->save();
+    if (! this->isHeadless)
+    {
+        this->getDocument()->save();
+    }
     
     this->transport->stopPlayback();
     this->transport->stopRender();
@@ -144,6 +173,7 @@ void ProjectTreeItem::deletePermanently()
         File localProjectFile(this->getDocument()->getFullPath());
         App::Workspace().unloadProjectById(this->getId());
         localProjectFile.deleteFile();
+        getUndoHistoryFile(localProjectFile).deleteFile();
         
         if (this->recentFilesList != nullptr)
         {
@@ -259,6 +289,7 @@ void ProjectTreeItem::safeRename(const String &newName)
     this->name = newName;
     
     this->getDocument()->renameFile(newName);
+    this->undoStack->setHistoryLogFile(getUndoHistoryFile(this->getDocument()->getFile()));
     this->broadcastChangeProjectInfo(this->info);
 
     // notify recent files list
@@ -511,13 +542,21 @@ Point<float> ProjectTreeItem::getProjectRangeInBeats() const
 
     for (auto track : tracks)
     {
-        const float layerFirstBeat = track->getSequence()->getFirstBeat();
-        const float layerLastBeat = track->getSequence()->getLastBeat();
+        float layerFirstBeat = track->getSequence()->getFirstBeat();
+        float layerLastBeat = track->getSequence()->getLastBeat();
+
+        // clips are sorted, so the first and the last ones define the range
+        const Pattern *pattern = track->getPattern();
+        if (pattern != nullptr && pattern->size() > 0 &&
+            track->getSequence()->size() > 0)
+        {
+            layerFirstBeat += pattern->getUnchecked(0).getStartBeat();
+            layerLastBeat += pattern->getUnchecked(pattern->size() - 1).getStartBeat();
+        }
+
         //Logger::writeToLog(">  " + String(layerFirstBeat) + " : " + String(layerLastBeat));
         firstBeat = jmin(firstBeat, layerFirstBeat);
         lastBeat = jmax(lastBeat, layerLastBeat);
-
-        // TODO also take into account patterns!!!!!!!
     }
     
     if (firstBeat == FLT_MAX)
@@ -600,7 +639,9 @@ XmlElement *ProjectTreeItem::save() const
     // UI state is now stored in config
     //xml->addChildElement(this->sequencerLayout->serialize());
 
-    xml->addChildElement(this->undoStack->serialize());
+    // undo history is now stored in a sidecar log, see onDocumentSave
+    //xml->addChildElement(this->undoStack->serialize());
+    xml->setAttribute(Serialization::Undo::historyStamp, this->undoStack->getHistoryStamp());
     
     TreeItemChildrenSerializer::serializeChildren(*this, *xml);
 
@@ -648,7 +689,10 @@ void ProjectTreeItem::load(const XmlElement &xml)
     // UI state is now stored in config
     //this->sequencerLayout->deserialize(*root);
     
+    // Legacy support: older projects keep undo history inside,
+    // it will be moved to the sidecar log on the next save
     this->undoStack->deserialize(*root);
+    this->undoStack->setHistoryStamp(root->getStringAttribute(Serialization::Undo::historyStamp));
     
     const float seek = float(root->getDoubleAttribute("seek", 0.f));
     this->transport->seekToPosition(seek);
@@ -675,13 +719,16 @@ void ProjectTreeItem::importMidi(File &file)
     // ‚‡ÊÌÓ.
     //tempFile.convertTimestampTicksToSeconds();
     
-    for (int trackNum = 0; trackNum < tempFile.getNumTracks(); trackNum++)
+    // the tracks are converted in parallel, then added one by one
+    OwnedArray<Array<Note>> tracksNotes;
+    PianoSequence::parseMidiTracks(tempFile, tracksNotes);
+
+    for (int trackNum = 0; trackNum < tracksNotes.size(); trackNum++)
     {
-        const MidiMessageSequence *currentTrack = tempFile.getTrack(trackNum);
         const String trackName = "Track " + String(trackNum);
         MidiTrackTreeItem *layer = new PianoTrackTreeItem(trackName);
         this->addChildTreeItem(layer);
-        layer->importMidi(*currentTrack);
+        static_cast<PianoSequence *>(layer->getSequence())->importNotes(*tracksNotes[trackNum]);
     }
     
     this->broadcastChangeProjectBeatRange();
@@ -739,6 +786,28 @@ void ProjectTreeItem::broadcastPostRemoveEvent(MidiSequence *const layer)
     this->sendChangeMessage();
 }
 
+void ProjectTreeItem::broadcastAddEvents(const Array<const MidiEvent *> &events)
+{
+    if (events.size() == 0) { return; }
+    this->changeListeners.call(&ProjectListener::onAddMidiEvents, events);
+    this->sendChangeMessage();
+}
+
+void ProjectTreeItem::broadcastChangeEvents(const Array<const MidiEvent *> &oldEvents,
+                                            const Array<const MidiEvent *> &newEvents)
+{
+    if (oldEvents.size() == 0) { return; }
+    this->changeListeners.call(&ProjectListener::onChangeMidiEvents, oldEvents, newEvents);
+    this->sendChangeMessage();
+}
+
+void ProjectTreeItem::broadcastRemoveEvents(const Array<const MidiEvent *> &events)
+{
+    if (events.size() == 0) { return; }
+    this->changeListeners.call(&ProjectListener::onRemoveMidiEvents, events);
+    this->sendChangeMessage();
+}
+
 void ProjectTreeItem::broadcastAddTrack(MidiTrack *const track)
 {
     this->isLayersHashOutdated = true;
@@ -848,6 +917,8 @@ bool ProjectTreeItem::onDocumentLoad(File &file)
         if (xml)
         {
             this->load(*xml);
+            this->undoStack->setHistoryLogFile(getUndoHistoryFile(file));
+            this->undoStack->loadHistoryLog();
             return true;
         }
     }
@@ -869,8 +940,26 @@ void ProjectTreeItem::onDocumentDidLoad(File &file)
 
 bool ProjectTreeItem::onDocumentSave(File &file)
 {
+    // "save as" copies don't take the history with them
+    const bool isOwnFile = (file == this->getDocument()->getFile());
+
+    // the project is written before the log, so if the app dies in between,
+    // the stamps won't match and the stale log is ignored on the next load
+    if (isOwnFile)
+    {
+        this->undoStack->renewHistoryStamp();
+    }
+
     ScopedPointer<XmlElement> xml(this->save());
-    return DataEncoder::saveObfuscated(file, xml);
+    const bool savedOk = DataEncoder::saveObfuscated(file, xml);
+
+    if (savedOk && isOwnFile)
+    {
+        this->undoStack->setHistoryLogFile(getUndoHistoryFile(file));
+        this->undoStack->flushHistoryLog();
+    }
+
+    return savedOk;
 }
 
 void ProjectTreeItem::onDocumentImport(File &file)
@@ -885,28 +974,257 @@ bool ProjectTreeItem::onDocumentExport(File &file)
 {
     if (file.hasFileExtension("mid") || file.hasFileExtension("midi"))
     {
-        this->exportMidi(file);
-        return true;
+        return this->exportMidi(file);
     }
 
     return false;
 }
 
-void ProjectTreeItem::exportMidi(File &file) const
+// Streams the sorted events of one or more sequences, expanded by clip instances,
+// into a single SMF track chunk, without building intermediate MidiMessageSequences
+class MidiTrackChunkWriter final
+{
+public:
+
+    void addSequence(const MidiSequence *sequence, float beatOffset = 0.f)
+    {
+        this->sources.add({ sequence, beatOffset, 0 });
+    }
+
+    void addTrack(const MidiTrack *track)
+    {
+        if (track->isTrackMuted())
+        { return; }
+
+        const Pattern *pattern = track->getPattern();
+
+        if (pattern == nullptr || pattern->size() == 0)
+        {
+            this->addSequence(track->getSequence());
+            return;
+        }
+
+        for (const auto &clip : *pattern)
+        {
+            this->addSequence(track->getSequence(), clip.getStartBeat());
+        }
+    }
+
+    void addMessage(const MidiMessage &message)
+    {
+        this->pending.push({ message, this->numPushed++ });
+    }
+
+    void writeTo(OutputStream &out)
+    {
+        MemoryOutputStream data;
+
+        while (true)
+        {
+            // k-way merge: pick the clip instance with the earliest next event
+            int nextSource = -1;
+            float nextBeat = 0.f;
+
+            for (int i = 0; i < this->sources.size(); ++i)
+            {
+                const Source &source = this->sources.getReference(i);
+
+                if (source.nextIndex < source.sequence->size())
+                {
+                    const float beat = source.sequence->getUnchecked(source.nextIndex)->getBeat() + source.beatOffset;
+
+                    if (nextSource < 0 || beat < nextBeat)
+                    {
+                        nextSource = i;
+                        nextBeat = beat;
+                    }
+                }
+            }
+
+            if (nextSource < 0)
+            { break; }
+
+            // note-offs and interpolated events that are due go first
+            this->flushPendingMessages(data, nextBeat * Transport::millisecondsPerBeat);
+
+            Source &source = this->sources.getReference(nextSource);
+            const MidiEvent *event = source.sequence->getUnchecked(source.nextIndex);
+            source.nextIndex++;
+
+            for (auto message : event->toMidiMessages())
+            {
+                message.addToTimeStamp(source.beatOffset * Transport::millisecondsPerBeat);
+                this->addMessage(message);
+            }
+        }
+
+        this->flushPendingMessages(data, std::numeric_limits<double>::max());
+        this->writeMessage(data, MidiMessage::endOfTrack());
+
+        out.writeIntBigEndian(int(ByteOrder::bigEndianInt("MTrk")));
+        out.writeIntBigEndian(int(data.getDataSize()));
+        out << data;
+    }
+
+private:
+
+    void flushPendingMessages(OutputStream &out, double untilTimestamp)
+    {
+        while (! this->pending.empty() &&
+            this->pending.top().message.getTimeStamp() <= untilTimestamp)
+        {
+            this->writeMessage(out, this->pending.top().message);
+            this->pending.pop();
+        }
+    }
+
+    void writeMessage(OutputStream &out, const MidiMessage &message)
+    {
+        // ticks-per-quarter-note equals millisecondsPerBeat, so timestamps are already in ticks
+        const int tick = roundToInt(message.getTimeStamp());
+        const int delta = jmax(0, tick - this->lastTick);
+        this->lastTick += delta;
+        writeVariableLengthInt(out, uint32(delta));
+
+        const uint8 *rawData = message.getRawData();
+        int rawDataSize = message.getRawDataSize();
+        const uint8 statusByte = rawData[0];
+
+        if (statusByte == 0xf0)
+        {
+            out.writeByte(char(statusByte));
+            ++rawData;
+            --rawDataSize;
+            writeVariableLengthInt(out, uint32(rawDataSize));
+        }
+        else if (statusByte == this->lastStatusByte &&
+            (statusByte & 0xf0) != 0xf0 && rawDataSize > 1)
+        {
+            // running status
+            ++rawData;
+            --rawDataSize;
+        }
+
+        out.write(rawData, size_t(rawDataSize));
+        this->lastStatusByte = ((statusByte & 0xf0) != 0xf0) ? statusByte : 0;
+    }
+
+    static void writeVariableLengthInt(OutputStream &out, uint32 value)
+    {
+        uint32 buffer = value & 0x7f;
+
+        while ((value >>= 7) != 0)
+        {
+            buffer <<= 8;
+            buffer |= ((value & 0x7f) | 0x80);
+        }
+
+        while (true)
+        {
+            out.writeByte(char(buffer));
+
+            if (buffer & 0x80) { buffer >>= 8; }
+            else { break; }
+        }
+    }
+
+    struct Source
+    {
+        const MidiSequence *sequence;
+        float beatOffset;
+        int nextIndex;
+    };
+
+    struct PendingMessage
+    {
+        MidiMessage message;
+        int64 order; // keeps the messages with equal timestamps in the order they were added
+
+        bool operator<(const PendingMessage &other) const noexcept
+        {
+            // std::priority_queue is a max-heap, so the comparison is inverted
+            if (this->message.getTimeStamp() != other.message.getTimeStamp())
+            {
+                return this->message.getTimeStamp() > other.message.getTimeStamp();
+            }
+
+            return this->order > other.order;
+        }
+    };
+
+    Array<Source> sources;
+    std::priority_queue<PendingMessage> pending;
+    int64 numPushed = 0;
+    int lastTick = 0;
+    uint8 lastStatusByte = 0;
+
+};
+
+bool ProjectTreeItem::exportMidi(File &file) const
 {
-    MidiFile tempFile;
-    tempFile.setTicksPerQuarterNote(Transport::millisecondsPerBeat);
-    
     const auto &tracks = this->getTracks();
-    
+
+    // the first track is the tempo map: time signatures, markers and tempo automation
+    MidiTrackChunkWriter tempoMap;
+    OwnedArray<MidiTrackChunkWriter> tracksWriters;
+    bool hasTempoTrack = false;
+
+    tempoMap.addTrack(this->timeline->getTimeSignatures());
+    tempoMap.addTrack(this->timeline->getAnnotations());
+
     for (auto track : tracks)
     {
-        // TODO patterns!
-        tempFile.addTrack(track->getSequence()->exportMidi());
+        if (track == this->timeline->getTimeSignatures() ||
+            track == this->timeline->getAnnotations())
+        {
+            continue;
+        }
+
+        if (track->isTempoTrack())
+        {
+            tempoMap.addTrack(track);
+            hasTempoTrack = true;
+            continue;
+        }
+
+        auto writer = new MidiTrackChunkWriter();
+        writer->addTrack(track);
+        tracksWriters.add(writer);
     }
-    
-    ScopedPointer<OutputStream> out(new FileOutputStream(file));
-    tempFile.writeTo(*out);
+
+    if (! hasTempoTrack)
+    {
+        MidiMessage defaultTempo(MidiMessage::tempoMetaEvent(Transport::millisecondsPerBeat * 1000));
+        defaultTempo.setTimeStamp(0.0);
+        tempoMap.addMessage(defaultTempo);
+    }
+
+    FileOutputStream out(file);
+
+    if (out.failedToOpen())
+    {
+        DBG("Failed to open file for midi export");
+        return false;
+    }
+
+    out.setPosition(0);
+    out.truncate();
+
+    out.writeIntBigEndian(int(ByteOrder::bigEndianInt("MThd")));
+    out.writeIntBigEndian(6);
+    out.writeShortBigEndian(1); // multiple synchronous tracks
+    out.writeShortBigEndian(short(tracksWriters.size() + 1));
+    out.writeShortBigEndian(short(Transport::millisecondsPerBeat)); // ticks-per-quarter-note
+
+    tempoMap.writeTo(out);
+
+    for (auto writer : tracksWriters)
+    {
+        writer->writeTo(out);
+    }
+
+    out.flush();
+    return out.getStatus().wasOk();
 }
 
 
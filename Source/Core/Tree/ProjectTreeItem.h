@@ -38,6 +38,7 @@ class ToolsSidebar;
 class UndoStack;
 class RecentFilesList;
 class Pattern;
+class OrchestraPit;
 
 #include "TreeItem.h"
 #include "DocumentOwner.h"
@@ -58,6 +59,12 @@ public:
 
     explicit ProjectTreeItem(const String &name);
     explicit ProjectTreeItem(const File &existingFile);
+
+    // A headless project, e.g. for the command line tools:
+    // it has no pages, plays through the given orchestra, is not autosaved
+    // and is not remembered in the recent files list
+    ProjectTreeItem(const File &existingFile, OrchestraPit &orchestra);
+
     ~ProjectTreeItem() override;
     
     void deletePermanently();
@@ -72,7 +79,7 @@ public:
     HybridRoll *getLastFocusedRoll() const;
     
     void importMidi(File &file);
-    void exportMidi(File &file) const;
+    bool exportMidi(File &file) const;
 
     Colour getColour() const override;
     Image getIcon() const override;
@@ -173,6 +180,11 @@ public:
     void broadcastRemoveEvent(const MidiEvent &event);
     void broadcastPostRemoveEvent(MidiSequence *const layer);
 
+    void broadcastAddEvents(const Array<const MidiEvent *> &events);
+    void broadcastChangeEvents(const Array<const MidiEvent *> &oldEvents,
+                               const Array<const MidiEvent *> &newEvents);
+    void broadcastRemoveEvents(const Array<const MidiEvent *> &events);
+
     void broadcastAddTrack(MidiTrack *const track);
     void broadcastRemoveTrack(MidiTrack *const track);
     void broadcastChangeTrackProperties(MidiTrack *const track);
@@ -241,7 +253,7 @@ private:
 
 private:
 
-    void initialize();
+    void initialize(OrchestraPit &orchestra, bool headless);
     XmlElement *save() const;
     void load(const XmlElement &xml);
 
@@ -253,6 +265,7 @@ private:
     ScopedPointer<UndoStack> undoStack;
 
     bool isLayersHashOutdated;
+    bool isHeadless;
     HashMap<String, WeakReference<MidiSequence> > sequencesHash;
 
     void rebuildSequencesHashIfNeeded();
@@ -30,6 +30,7 @@
 #include "DataEncoder.h"
 #include "Icons.h"
 #include "MidiSequence.h"
+#include "PianoSequence.h"
 #include "AutomationEvent.h"
 #include "RecentFilesList.h"
 #include "ProjectInfo.h"
@@ -108,12 +109,15 @@ void RootTreeItem::importMidi(File &file)
     this->addChildTreeItem(project);
     this->addVCS(project);
 
-    for (int trackNum = 0; trackNum < tempFile.getNumTracks(); trackNum++)
+    // the tracks are converted in parallel, then added one by one
+    OwnedArray<Array<Note>> tracksNotes;
+    PianoSequence::parseMidiTracks(tempFile, tracksNotes);
+
+    for (int trackNum = 0; trackNum < tracksNotes.size(); trackNum++)
     {
-        const MidiMessageSequence *currentTrack = tempFile.getTrack(trackNum);
         String trackName = "Track " + String(trackNum);
         MidiTrackTreeItem *layer = this->addPianoTrack(project, trackName);
-        layer->importMidi(*currentTrack);
+        static_cast<PianoSequence *>(layer->getSequence())->importNotes(*tracksNotes[trackNum]);
     }
 
     //this->addAutoLayer(project, "Tempo", 81);
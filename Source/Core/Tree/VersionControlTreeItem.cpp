@@ -368,6 +368,7 @@ void VersionControlTreeItem::initVCS()
         this->vcs = new VersionControl(parentProject, this->existingId, this->existingKey);
         this->vcs->addChangeListener(parentProject);
         parentProject->addChangeListener(this->vcs);
+        parentProject->addListener(this->vcs);
     }
 }
 
@@ -378,6 +379,7 @@ void VersionControlTreeItem::shutdownVCS()
     if (parentProject &&
         (this->vcs != nullptr))
     {
+        parentProject->removeListener(this->vcs);
         parentProject->removeChangeListener(this->vcs);
         this->vcs->removeChangeListener(parentProject);
     }
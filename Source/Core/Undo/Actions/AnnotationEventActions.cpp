@@ -59,7 +59,8 @@ bool AnnotationEventInsertAction::undo()
 
 int AnnotationEventInsertAction::getSizeInUnits()
 {
-    return sizeof(AnnotationEvent);
+    return getStringSizeInBytes(this->trackId) +
+        getEventSizeInBytes(this->event);
 }
 
 XmlElement *AnnotationEventInsertAction::serialize() const
@@ -120,7 +121,8 @@ bool AnnotationEventRemoveAction::undo()
 
 int AnnotationEventRemoveAction::getSizeInUnits()
 {
-    return sizeof(AnnotationEvent);
+    return getStringSizeInBytes(this->trackId) +
+        getEventSizeInBytes(this->event);
 }
 
 XmlElement *AnnotationEventRemoveAction::serialize() const
@@ -183,7 +185,14 @@ bool AnnotationEventChangeAction::undo()
 
 int AnnotationEventChangeAction::getSizeInUnits()
 {
-    return sizeof(AnnotationEvent) * 2;
+    return getStringSizeInBytes(this->trackId) +
+        getEventSizeInBytes(this->eventBefore) +
+        getEventSizeInBytes(this->eventAfter);
+}
+
+String AnnotationEventChangeAction::getCoalescingKey() const
+{
+    return this->trackId + Serialization::Undo::annotationEventChangeAction + this->eventAfter.getId();
 }
 
 UndoAction *AnnotationEventChangeAction::createCoalescedAction(UndoAction *nextAction)
@@ -282,7 +291,8 @@ bool AnnotationEventsGroupInsertAction::undo()
 
 int AnnotationEventsGroupInsertAction::getSizeInUnits()
 {
-    return (sizeof(AnnotationEvent) * this->annotations.size());
+    return getStringSizeInBytes(this->trackId) +
+        getEventsSizeInBytes(this->annotations);
 }
 
 XmlElement *AnnotationEventsGroupInsertAction::serialize() const
@@ -355,7 +365,8 @@ bool AnnotationEventsGroupRemoveAction::undo()
 
 int AnnotationEventsGroupRemoveAction::getSizeInUnits()
 {
-    return (sizeof(AnnotationEvent) * this->annotations.size());
+    return getStringSizeInBytes(this->trackId) +
+        getEventsSizeInBytes(this->annotations);
 }
 
 XmlElement *AnnotationEventsGroupRemoveAction::serialize() const
@@ -430,8 +441,16 @@ bool AnnotationEventsGroupChangeAction::undo()
 
 int AnnotationEventsGroupChangeAction::getSizeInUnits()
 {
-    return (sizeof(AnnotationEvent) * this->eventsBefore.size()) +
-        (sizeof(AnnotationEvent) * this->eventsAfter.size());
+    return getStringSizeInBytes(this->trackId) +
+        getEventsSizeInBytes(this->eventsBefore) +
+        getEventsSizeInBytes(this->eventsAfter);
+}
+
+String AnnotationEventsGroupChangeAction::getCoalescingKey() const
+{
+    // the first event id keeps different selections of one track in different slots
+    const String firstEventId(this->eventsAfter.size() > 0 ? this->eventsAfter.getReference(0).getId() : String::empty);
+    return this->trackId + Serialization::Undo::annotationEventsGroupChangeAction + firstEventId;
 }
 
 UndoAction *AnnotationEventsGroupChangeAction::createCoalescedAction(UndoAction *nextAction)
@@ -60,7 +60,8 @@ bool AutomationEventInsertAction::undo()
 
 int AutomationEventInsertAction::getSizeInUnits()
 {
-    return sizeof(AutomationEvent);
+    return getStringSizeInBytes(this->trackId) +
+        getEventSizeInBytes(this->event);
 }
 
 XmlElement *AutomationEventInsertAction::serialize() const
@@ -122,7 +123,8 @@ bool AutomationEventRemoveAction::undo()
 
 int AutomationEventRemoveAction::getSizeInUnits()
 {
-    return sizeof(AutomationEvent);
+    return getStringSizeInBytes(this->trackId) +
+        getEventSizeInBytes(this->event);
 }
 
 XmlElement *AutomationEventRemoveAction::serialize() const
@@ -186,7 +188,14 @@ bool AutomationEventChangeAction::undo()
 
 int AutomationEventChangeAction::getSizeInUnits()
 {
-    return sizeof(AutomationEvent) * 2;
+    return getStringSizeInBytes(this->trackId) +
+        getEventSizeInBytes(this->eventBefore) +
+        getEventSizeInBytes(this->eventAfter);
+}
+
+String AutomationEventChangeAction::getCoalescingKey() const
+{
+    return this->trackId + Serialization::Undo::automationEventChangeAction + this->eventAfter.getId();
 }
 
 UndoAction *AutomationEventChangeAction::createCoalescedAction(UndoAction *nextAction)
@@ -285,7 +294,8 @@ bool AutomationEventsGroupInsertAction::undo()
 
 int AutomationEventsGroupInsertAction::getSizeInUnits()
 {
-    return (sizeof(AutomationEvent) * this->events.size());
+    return getStringSizeInBytes(this->trackId) +
+        getEventsSizeInBytes(this->events);
 }
 
 XmlElement *AutomationEventsGroupInsertAction::serialize() const
@@ -358,7 +368,8 @@ bool AutomationEventsGroupRemoveAction::undo()
 
 int AutomationEventsGroupRemoveAction::getSizeInUnits()
 {
-    return (sizeof(AutomationEvent) * this->events.size());
+    return getStringSizeInBytes(this->trackId) +
+        getEventsSizeInBytes(this->events);
 }
 
 XmlElement *AutomationEventsGroupRemoveAction::serialize() const
@@ -433,8 +444,16 @@ bool AutomationEventsGroupChangeAction::undo()
 
 int AutomationEventsGroupChangeAction::getSizeInUnits()
 {
-    return (sizeof(AutomationEvent) * this->eventsBefore.size()) +
-           (sizeof(AutomationEvent) * this->eventsAfter.size());
+    return getStringSizeInBytes(this->trackId) +
+        getEventsSizeInBytes(this->eventsBefore) +
+        getEventsSizeInBytes(this->eventsAfter);
+}
+
+String AutomationEventsGroupChangeAction::getCoalescingKey() const
+{
+    // the first event id keeps different selections of one track in different slots
+    const String firstEventId(this->eventsAfter.size() > 0 ? this->eventsAfter.getReference(0).getId() : String::empty);
+    return this->trackId + Serialization::Undo::automationEventsGroupChangeAction + firstEventId;
 }
 
 UndoAction *AutomationEventsGroupChangeAction::createCoalescedAction(UndoAction *nextAction)
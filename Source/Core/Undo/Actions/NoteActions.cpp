@@ -61,7 +61,8 @@ bool NoteInsertAction::undo()
 
 int NoteInsertAction::getSizeInUnits()
 {
-    return sizeof(Note);
+    return getStringSizeInBytes(this->trackId) +
+        getEventSizeInBytes(this->note);
 }
 
 XmlElement *NoteInsertAction::serialize() const
@@ -123,7 +124,8 @@ bool NoteRemoveAction::undo()
 
 int NoteRemoveAction::getSizeInUnits()
 {
-    return sizeof(Note);
+    return getStringSizeInBytes(this->trackId) +
+        getEventSizeInBytes(this->note);
 }
 
 XmlElement *NoteRemoveAction::serialize() const
@@ -187,7 +189,14 @@ bool NoteChangeAction::undo()
 
 int NoteChangeAction::getSizeInUnits()
 {
-    return sizeof(Note) * 2;
+    return getStringSizeInBytes(this->trackId) +
+        getEventSizeInBytes(this->noteBefore) +
+        getEventSizeInBytes(this->noteAfter);
+}
+
+String NoteChangeAction::getCoalescingKey() const
+{
+    return this->trackId + Serialization::Undo::noteChangeAction + this->noteAfter.getId();
 }
 
 UndoAction *NoteChangeAction::createCoalescedAction(UndoAction *nextAction)
@@ -261,6 +270,7 @@ NotesGroupInsertAction::NotesGroupInsertAction(ProjectTreeItem &parentProject,
     trackId(std::move(targetTrackId))
 {
     this->notes.swapWith(target);
+    this->notes.minimiseStorageOverheads();
 }
 
 bool NotesGroupInsertAction::perform()
@@ -287,7 +297,8 @@ bool NotesGroupInsertAction::undo()
 
 int NotesGroupInsertAction::getSizeInUnits()
 {
-    return (sizeof(Note) * this->notes.size());
+    return getStringSizeInBytes(this->trackId) +
+        getEventsSizeInBytes(this->notes);
 }
 
 XmlElement *NotesGroupInsertAction::serialize() const
@@ -334,6 +345,7 @@ NotesGroupRemoveAction::NotesGroupRemoveAction(ProjectTreeItem &parentProject,
     trackId(std::move(targetTrackId))
 {
     this->notes.swapWith(target);
+    this->notes.minimiseStorageOverheads();
 }
 
 bool NotesGroupRemoveAction::perform()
@@ -360,7 +372,8 @@ bool NotesGroupRemoveAction::undo()
 
 int NotesGroupRemoveAction::getSizeInUnits()
 {
-    return (sizeof(Note) * this->notes.size());
+    return getStringSizeInBytes(this->trackId) +
+        getEventsSizeInBytes(this->notes);
 }
 
 XmlElement *NotesGroupRemoveAction::serialize() const
@@ -409,6 +422,10 @@ NotesGroupChangeAction::NotesGroupChangeAction(ProjectTreeItem &parentProject,
 {
     this->notesBefore.swapWith(state1);
     this->notesAfter.swapWith(state2);
+    
+    // drag sequences coalesce thousands of these, so don't keep the slack
+    this->notesBefore.minimiseStorageOverheads();
+    this->notesAfter.minimiseStorageOverheads();
 }
 
 bool NotesGroupChangeAction::perform()
@@ -435,8 +452,18 @@ bool NotesGroupChangeAction::undo()
 
 int NotesGroupChangeAction::getSizeInUnits()
 {
-    return (sizeof(Note) * this->notesBefore.size()) +
-        (sizeof(Note) * this->notesAfter.size());
+    // ids of the states are the copies of the same shared strings,
+    // so only count them once
+    return getStringSizeInBytes(this->trackId) +
+        getEventsSizeInBytes(this->notesBefore) +
+        int(sizeof(Array<Note>) + sizeof(Note) * this->notesAfter.size());
+}
+
+String NotesGroupChangeAction::getCoalescingKey() const
+{
+    // the first event id keeps different selections of one track in different slots
+    const String firstEventId(this->notesAfter.size() > 0 ? this->notesAfter.getReference(0).getId() : String::empty);
+    return this->trackId + Serialization::Undo::notesGroupChangeAction + firstEventId;
 }
 
 UndoAction *NotesGroupChangeAction::createCoalescedAction(UndoAction *nextAction)
@@ -59,7 +59,8 @@ bool PatternClipInsertAction::undo()
 
 int PatternClipInsertAction::getSizeInUnits()
 {
-    return sizeof(Clip);
+    return getStringSizeInBytes(this->trackId) +
+        getEventSizeInBytes(this->clip);
 }
 
 XmlElement *PatternClipInsertAction::serialize() const
@@ -119,7 +120,8 @@ bool PatternClipRemoveAction::undo()
 
 int PatternClipRemoveAction::getSizeInUnits()
 {
-    return sizeof(Clip);
+    return getStringSizeInBytes(this->trackId) +
+        getEventSizeInBytes(this->clip);
 }
 
 XmlElement *PatternClipRemoveAction::serialize() const
@@ -183,7 +185,14 @@ bool PatternClipChangeAction::undo()
 
 int PatternClipChangeAction::getSizeInUnits()
 {
-    return sizeof(Clip) * 2;
+    return getStringSizeInBytes(this->trackId) +
+        getEventSizeInBytes(this->clipBefore) +
+        getEventSizeInBytes(this->clipAfter);
+}
+
+String PatternClipChangeAction::getCoalescingKey() const
+{
+    return this->trackId + Serialization::Undo::patternClipChangeAction + this->clipAfter.getId();
 }
 
 UndoAction *PatternClipChangeAction::createCoalescedAction(UndoAction *nextAction)
@@ -59,7 +59,8 @@ bool TimeSignatureEventInsertAction::undo()
 
 int TimeSignatureEventInsertAction::getSizeInUnits()
 {
-    return sizeof(TimeSignatureEvent);
+    return getStringSizeInBytes(this->trackId) +
+        getEventSizeInBytes(this->event);
 }
 
 XmlElement *TimeSignatureEventInsertAction::serialize() const
@@ -120,7 +121,8 @@ bool TimeSignatureEventRemoveAction::undo()
 
 int TimeSignatureEventRemoveAction::getSizeInUnits()
 {
-    return sizeof(TimeSignatureEvent);
+    return getStringSizeInBytes(this->trackId) +
+        getEventSizeInBytes(this->event);
 }
 
 XmlElement *TimeSignatureEventRemoveAction::serialize() const
@@ -184,7 +186,14 @@ bool TimeSignatureEventChangeAction::undo()
 
 int TimeSignatureEventChangeAction::getSizeInUnits()
 {
-    return sizeof(TimeSignatureEvent) * 2;
+    return getStringSizeInBytes(this->trackId) +
+        getEventSizeInBytes(this->eventBefore) +
+        getEventSizeInBytes(this->eventAfter);
+}
+
+String TimeSignatureEventChangeAction::getCoalescingKey() const
+{
+    return this->trackId + Serialization::Undo::timeSignatureEventChangeAction + this->eventAfter.getId();
 }
 
 UndoAction *TimeSignatureEventChangeAction::createCoalescedAction(UndoAction *nextAction)
@@ -283,7 +292,8 @@ bool TimeSignatureEventsGroupInsertAction::undo()
 
 int TimeSignatureEventsGroupInsertAction::getSizeInUnits()
 {
-    return (sizeof(TimeSignatureEvent) * this->signatures.size());
+    return getStringSizeInBytes(this->trackId) +
+        getEventsSizeInBytes(this->signatures);
 }
 
 XmlElement *TimeSignatureEventsGroupInsertAction::serialize() const
@@ -356,7 +366,8 @@ bool TimeSignatureEventsGroupRemoveAction::undo()
 
 int TimeSignatureEventsGroupRemoveAction::getSizeInUnits()
 {
-    return (sizeof(TimeSignatureEvent) * this->signatures.size());
+    return getStringSizeInBytes(this->trackId) +
+        getEventsSizeInBytes(this->signatures);
 }
 
 XmlElement *TimeSignatureEventsGroupRemoveAction::serialize() const
@@ -431,8 +442,16 @@ bool TimeSignatureEventsGroupChangeAction::undo()
 
 int TimeSignatureEventsGroupChangeAction::getSizeInUnits()
 {
-    return (sizeof(TimeSignatureEvent) * this->eventsBefore.size()) +
-           (sizeof(TimeSignatureEvent) * this->eventsAfter.size());
+    return getStringSizeInBytes(this->trackId) +
+        getEventsSizeInBytes(this->eventsBefore) +
+        getEventsSizeInBytes(this->eventsAfter);
+}
+
+String TimeSignatureEventsGroupChangeAction::getCoalescingKey() const
+{
+    // the first event id keeps different selections of one track in different slots
+    const String firstEventId(this->eventsAfter.size() > 0 ? this->eventsAfter.getReference(0).getId() : String::empty);
+    return this->trackId + Serialization::Undo::timeSignatureEventsGroupChangeAction + firstEventId;
 }
 
 UndoAction *TimeSignatureEventsGroupChangeAction::createCoalescedAction(UndoAction *nextAction)
@@ -107,6 +107,7 @@ public:
     bool perform() override;
     bool undo() override;
     int getSizeInUnits() override;
+    String getCoalescingKey() const override;
     UndoAction *createCoalescedAction(UndoAction *nextAction) override;
     
     XmlElement *serialize() const override;
@@ -210,6 +211,7 @@ public:
     bool perform() override;
     bool undo() override;
     int getSizeInUnits() override;
+    String getCoalescingKey() const override;
     UndoAction *createCoalescedAction(UndoAction *nextAction) override;
     
     XmlElement *serialize() const override;
@@ -33,11 +33,22 @@ public:
 
     virtual bool undo() = 0;
 
+    // approximate number of bytes the action holds,
+    // used by UndoStack to keep the history within its memory budget
     virtual int getSizeInUnits()
     {
         return 10;
     }
 
+    // actions that can be coalesced with each other should return the same key,
+    // built from the track id and the action type (and an event id for single-event changes);
+    // UndoStack keeps one coalescing slot per key in a transaction
+    // and calls createCoalescedAction only for the action found in that slot
+    virtual String getCoalescingKey() const
+    {
+        return String::empty;
+    }
+
     virtual UndoAction *createCoalescedAction(UndoAction* nextAction)
     {
         (void) nextAction;
@@ -46,6 +57,30 @@ public:
     
 protected:
     
+    static int getStringSizeInBytes(const String &string)
+    {
+        return int(sizeof(String) + string.getNumBytesAsUTF8());
+    }
+    
+    template<typename T>
+    static int getEventSizeInBytes(const T &event)
+    {
+        return int(sizeof(T) + event.getId().getNumBytesAsUTF8());
+    }
+    
+    template<typename T>
+    static int getEventsSizeInBytes(const Array<T> &events)
+    {
+        int total = int(sizeof(Array<T>));
+        
+        for (int i = 0; i < events.size(); ++i)
+        {
+            total += getEventSizeInBytes(events.getReference(i));
+        }
+        
+        return total;
+    }
+    
     ProjectTreeItem &project;
 
 };
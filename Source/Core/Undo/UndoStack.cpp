@@ -33,6 +33,10 @@
 
 #define MAX_TRANSACTIONS_TO_STORE 10
 
+// the log is compacted, when it grows over this size
+// and over twice the size it had after the last compaction
+#define UNDO_LOG_COMPACTION_THRESHOLD (4 * 1024 * 1024)
+
 
 struct UndoStack::ActionSet
 {
@@ -109,9 +113,34 @@ struct UndoStack::ActionSet
     
     void reset()
     {
+        this->coalescingSlots.clear();
         this->actions.clear();
     }
     
+    void addAction(UndoAction *action, const String &coalescingKey)
+    {
+        this->actions.add(action);
+        
+        if (coalescingKey.isNotEmpty())
+        {
+            this->coalescingSlots.set(coalescingKey, action);
+        }
+    }
+    
+    void removeAction(UndoAction *action)
+    {
+        // the slot action is almost always the last one,
+        // so searching from the end is usually a single comparison
+        for (int i = this->actions.size(); --i >= 0;)
+        {
+            if (this->actions.getUnchecked(i) == action)
+            {
+                this->actions.remove(i);
+                return;
+            }
+        }
+    }
+    
     UndoAction *createUndoActionsByTagName(const String &tagName)
     {
         if      (tagName == Serialization::Undo::pianoTrackInsertAction)                { return new PianoTrackInsertAction(this->project); }
@@ -157,6 +186,10 @@ struct UndoStack::ActionSet
     OwnedArray<UndoAction> actions;
     String name;
     
+    // the last action for each coalescing key, owned by the actions array;
+    // deserialized transactions have no slots, so they never coalesce
+    HashMap<String, UndoAction *> coalescingSlots;
+    
     ProjectTreeItem &project;
 };
 
@@ -168,7 +201,13 @@ project(parentProject),
 totalUnitsStored(0),
 nextIndex(0),
 newTransaction(true),
-reentrancyCheck(false)
+reentrancyCheck(false),
+baseIndex(0),
+firstUnloggedIndex(0),
+lastLoggedCount(-1),
+lastLoggedNextIndex(-1),
+shouldRewriteLog(true),
+compactedLogSize(0)
 {
     setMaxNumberOfStoredUnits (maxNumberOfUnitsToKeep,
                                minimumTransactions);
@@ -184,6 +223,10 @@ void UndoStack::clearUndoHistory()
     transactions.clear();
     totalUnitsStored = 0;
     nextIndex = 0;
+    
+    // the next flush rewrites the log from the very beginning
+    discardLoggedHistory();
+    
     sendChangeMessage();
 }
 
@@ -233,36 +276,25 @@ bool UndoStack::perform (UndoAction* const newAction)
             
             //Logger::writeToLog("size before " + String(actionSet->actions.size()));
             
+            // ключ слота считаем до того, как action будет заменен объединенным
+            const String coalescingKey(action->getCoalescingKey());
+            
             if (actionSet != nullptr && ! newTransaction)
             {
-                // здесь имеет смысл пробежаться по всему стеку, вызывая createCoalescedAction,
-                // так как если в транзакции повторяются несколько разнородных событий,
-                // то стек будет распухать
-                for (signed int i = (actionSet->actions.size() - 1); i >= 0; --i)
+                // не бегаем по всему стеку транзакции (на длинных драгах это O(n^2)),
+                // а объединяем только с последним действием из слота (трек, тип действия)
+                if (coalescingKey.isNotEmpty())
                 {
-                    if (UndoAction *const lastAction = actionSet->actions[i])
+                    if (UndoAction *const lastAction = actionSet->coalescingSlots[coalescingKey])
                     {
                         if (UndoAction *const coalescedAction = lastAction->createCoalescedAction(action))
                         {
-                            //Logger::writeToLog("createCoalescedAction");
                             action = coalescedAction;
                             totalUnitsStored -= lastAction->getSizeInUnits();
-                            actionSet->actions.remove(i);
-                            break;
+                            actionSet->removeAction(lastAction);
                         }
                     }
                 }
-                
-                //if (UndoAction* const lastAction = actionSet->actions.getLast())
-                //{
-                //    if (UndoAction* const coalescedAction = lastAction->createCoalescedAction (action))
-                //    {
-                //        Logger::writeToLog("remove last");
-                //        action = coalescedAction;
-                //        totalUnitsStored -= lastAction->getSizeInUnits();
-                //        actionSet->actions.removeLast();
-                //    }
-                //}
             }
             else
             {
@@ -272,7 +304,8 @@ bool UndoStack::perform (UndoAction* const newAction)
             }
             
             totalUnitsStored += action->getSizeInUnits();
-            actionSet->actions.add (action.release());
+            actionSet->addAction(action.release(), coalescingKey);
+            firstUnloggedIndex = jmin(firstUnloggedIndex, baseIndex + nextIndex - 1);
             newTransaction = false;
             //Logger::writeToLog("size " + String(actionSet->actions.size()));
             
@@ -297,10 +330,20 @@ void UndoStack::clearFutureTransactions()
            && totalUnitsStored > maxNumUnitsToKeep
            && transactions.size() > minimumTransactionsToKeep)
     {
+        // transactions dropped from memory stay reachable through the log, if they are in it;
+        // the log is only written on save, so an unsaved one breaks the chain of older history
+        const bool isLogged = (firstUnloggedIndex > baseIndex);
+        
         totalUnitsStored -= transactions.getFirst()->getTotalSize();
         transactions.remove (0);
         --nextIndex;
         
+        if (isLogged) {
+            ++baseIndex;
+        } else {
+            discardLoggedHistory();
+        }
+        
         // if this fails, then some actions may not be returning
         // consistent results from their getSizeInUnits() method
         jassert (totalUnitsStored >= 0);
@@ -331,11 +374,15 @@ void UndoStack::setCurrentTransactionName (const String& newName) noexcept
 UndoStack::ActionSet* UndoStack::getCurrentSet() const noexcept     { return transactions [nextIndex - 1]; }
 UndoStack::ActionSet* UndoStack::getNextSet() const noexcept        { return transactions [nextIndex]; }
 
-bool UndoStack::canUndo() const noexcept   { return getCurrentSet() != nullptr; }
+bool UndoStack::canUndo() const noexcept   { return getCurrentSet() != nullptr || hasOlderHistory(); }
 bool UndoStack::canRedo() const noexcept   { return getNextSet()    != nullptr; }
 
 bool UndoStack::undo()
 {
+    if (getCurrentSet() == nullptr && hasOlderHistory()) {
+        loadOlderHistory();
+    }
+    
     if (const ActionSet* const s = getCurrentSet())
     {
         const ScopedValueSetter<bool> setter (reentrancyCheck, true);
@@ -460,6 +507,7 @@ void UndoStack::deserialize(const XmlElement &xml)
     {
         auto actionSet = new ActionSet(this->project, String::empty);
         actionSet->deserialize(*childTransactionXml);
+        this->totalUnitsStored += actionSet->getTotalSize();
         this->transactions.insert(this->nextIndex, actionSet);
         ++this->nextIndex;
     }
@@ -469,3 +517,462 @@ void UndoStack::reset()
 {
     this->clearUndoHistory();
 }
+
+
+//===----------------------------------------------------------------------===//
+// History log
+//===----------------------------------------------------------------------===//
+
+// Лог только дописывается в конец. Каждая запись заканчивается смещением своего начала,
+// чтобы его можно было читать с конца, не разбирая xml более старых записей:
+//
+// transaction: [magic][absolute index][payload size][payload][int64 record start]
+// cursor:      [magic][number of transactions][payload size][int32 next index][stamp][int64 record start]
+//
+// Запись транзакции с индексом i отменяет все более ранние записи с индексами >= i,
+// а последний курсор задает общее число транзакций, текущую позицию undo
+// и метку, которая должна совпадать с меткой в файле проекта.
+
+static const int undoLogTransactionMagic = 0x55547278; // "UTrx"
+static const int undoLogCursorMagic = 0x55437572; // "UCur"
+static const int64 undoLogHeaderSize = 3 * sizeof(int32);
+static const int64 undoLogFooterSize = sizeof(int64);
+
+struct UndoLogRecord
+{
+    int magic;
+    int index;
+    int payloadSize;
+    int64 start;
+};
+
+class UndoLogReader
+{
+public:
+    
+    explicit UndoLogReader(const File &file) :
+        input(file),
+        position(0)
+    {
+        if (this->input.openedOk())
+        {
+            this->position = this->input.getTotalLength();
+        }
+    }
+    
+    // reads the record that ends at the current position and steps back over it
+    bool readPrevious(UndoLogRecord &record)
+    {
+        if (this->position < (undoLogHeaderSize + undoLogFooterSize))
+        {
+            return false;
+        }
+        
+        this->input.setPosition(this->position - undoLogFooterSize);
+        record.start = this->input.readInt64();
+        
+        if (record.start < 0 ||
+            record.start > (this->position - undoLogHeaderSize - undoLogFooterSize))
+        {
+            return false;
+        }
+        
+        this->input.setPosition(record.start);
+        record.magic = this->input.readInt();
+        record.index = this->input.readInt();
+        record.payloadSize = this->input.readInt();
+        
+        const bool isValid =
+            (record.magic == undoLogTransactionMagic || record.magic == undoLogCursorMagic) &&
+            (record.index >= 0 && record.payloadSize >= 0) &&
+            (record.start + undoLogHeaderSize + record.payloadSize + undoLogFooterSize == this->position);
+        
+        if (! isValid)
+        {
+            return false;
+        }
+        
+        this->position = record.start;
+        return true;
+    }
+    
+    void readPayload(const UndoLogRecord &record, MemoryBlock &result)
+    {
+        this->input.setPosition(record.start + undoLogHeaderSize);
+        this->input.readIntoMemoryBlock(result, record.payloadSize);
+    }
+    
+    XmlElement *readTransaction(const UndoLogRecord &record)
+    {
+        MemoryBlock payload;
+        this->readPayload(record, payload);
+        return XmlDocument::parse(payload.toString());
+    }
+    
+    bool readCursor(const UndoLogRecord &record, int &cursorIndex, String &stamp)
+    {
+        if (record.payloadSize < int(sizeof(int32)))
+        {
+            return false;
+        }
+        
+        MemoryBlock payload;
+        this->readPayload(record, payload);
+        
+        MemoryInputStream in(payload, false);
+        cursorIndex = in.readInt();
+        stamp = in.readEntireStreamAsString();
+        return true;
+    }
+    
+private:
+    
+    FileInputStream input;
+    int64 position;
+    
+};
+
+static void writeUndoLogRecord(FileOutputStream &out, int magic, int index, const void *payload, int payloadSize)
+{
+    const int64 recordStart = out.getPosition();
+    
+    out.writeInt(magic);
+    out.writeInt(index);
+    out.writeInt(payloadSize);
+    out.write(payload, payloadSize);
+    out.writeInt64(recordStart);
+}
+
+static void writeUndoLogTransaction(FileOutputStream &out, int index, const String &payload)
+{
+    writeUndoLogRecord(out, undoLogTransactionMagic, index,
+        payload.toRawUTF8(), int(payload.getNumBytesAsUTF8()));
+}
+
+static void writeUndoLogCursor(FileOutputStream &out, int numTransactions, int cursorIndex, const String &stamp)
+{
+    MemoryOutputStream payload;
+    payload.writeInt(cursorIndex);
+    payload.write(stamp.toRawUTF8(), stamp.getNumBytesAsUTF8());
+    
+    writeUndoLogRecord(out, undoLogCursorMagic, numTransactions,
+        payload.getData(), int(payload.getDataSize()));
+}
+
+void UndoStack::setHistoryLogFile(const File &file)
+{
+    if (this->historyLogFile == file)
+    { return; }
+    
+    // the project has been renamed, so the log follows it
+    if (this->historyLogFile.existsAsFile())
+    {
+        file.deleteFile();
+        this->historyLogFile.moveFileTo(file);
+    }
+    
+    this->historyLogFile = file;
+}
+
+const String &UndoStack::getHistoryStamp() const noexcept
+{
+    return this->historyStamp;
+}
+
+void UndoStack::setHistoryStamp(const String &stamp)
+{
+    this->historyStamp = stamp;
+}
+
+void UndoStack::renewHistoryStamp()
+{
+    this->historyStamp = this->project.getId() + ":" + Uuid().toString();
+}
+
+void UndoStack::loadHistoryLog()
+{
+    // the legacy history, deserialized from the project file, is kept
+    // and will replace the log contents on the next flush
+    if (this->transactions.size() > 0)
+    {
+        this->shouldRewriteLog = true;
+        return;
+    }
+    
+    int numTransactions = 0;
+    int cursorIndex = 0;
+    String stamp;
+    OwnedArray<ActionSet> loadedSets;
+    
+    // the first pass only reads the cursor
+    if (! this->readHistoryLog(0, 0, loadedSets, numTransactions, cursorIndex, stamp))
+    {
+        this->shouldRewriteLog = true;
+        return;
+    }
+    
+    // the project file has been reverted, replaced or saved without the log
+    if (this->historyStamp.isEmpty() || stamp != this->historyStamp)
+    {
+        Logger::writeToLog("Undo history log doesn't match the project, ignoring it");
+        this->shouldRewriteLog = true;
+        return;
+    }
+    
+    // all the redo transactions, and a window of undo ones before them
+    const int fromIndex = jmax(0, cursorIndex - MAX_TRANSACTIONS_TO_STORE);
+    
+    if (! this->readHistoryLog(fromIndex, numTransactions, loadedSets, numTransactions, cursorIndex, stamp))
+    {
+        this->shouldRewriteLog = true;
+        return;
+    }
+    
+    for (int i = 0; i < loadedSets.size(); ++i)
+    {
+        this->totalUnitsStored += loadedSets.getUnchecked(i)->getTotalSize();
+    }
+    
+    this->transactions.swapWith(loadedSets);
+    this->baseIndex = fromIndex;
+    this->nextIndex = cursorIndex - fromIndex;
+    this->firstUnloggedIndex = numTransactions;
+    this->lastLoggedCount = numTransactions;
+    this->lastLoggedNextIndex = cursorIndex;
+    this->lastLoggedStamp = stamp;
+    this->shouldRewriteLog = false;
+    this->compactedLogSize = this->historyLogFile.getSize();
+}
+
+bool UndoStack::flushHistoryLog()
+{
+    if (this->historyLogFile.getFullPathName().isEmpty())
+    { return false; }
+    
+    if (! this->shouldRewriteLog &&
+        this->historyLogFile.getSize() > jmax(int64(UNDO_LOG_COMPACTION_THRESHOLD), this->compactedLogSize * 2))
+    {
+        if (! this->compactHistoryLog(jmin(this->firstUnloggedIndex, this->lastLoggedCount)))
+        {
+            // the log can't be read back, so only the history in memory is kept
+            this->discardLoggedHistory();
+        }
+    }
+    
+    const int numTransactions = this->baseIndex + this->transactions.size();
+    const int cursorIndex = this->baseIndex + this->nextIndex;
+    
+    if (! this->shouldRewriteLog &&
+        this->firstUnloggedIndex >= numTransactions &&
+        this->lastLoggedCount == numTransactions &&
+        this->lastLoggedNextIndex == cursorIndex &&
+        this->lastLoggedStamp == this->historyStamp)
+    {
+        return true;
+    }
+    
+    if (this->shouldRewriteLog)
+    {
+        jassert(this->baseIndex == 0 && this->firstUnloggedIndex == 0);
+        this->historyLogFile.deleteFile();
+    }
+    
+    FileOutputStream out(this->historyLogFile);
+    
+    if (! out.openedOk())
+    { return false; }
+    
+    jassert(this->firstUnloggedIndex >= this->baseIndex);
+    
+    for (int i = jmax(this->firstUnloggedIndex, this->baseIndex); i < numTransactions; ++i)
+    {
+        ScopedPointer<XmlElement> xml(this->transactions.getUnchecked(i - this->baseIndex)->serialize());
+        writeUndoLogTransaction(out, i, xml->createDocument("", true, false));
+    }
+    
+    writeUndoLogCursor(out, numTransactions, cursorIndex, this->historyStamp);
+    out.flush();
+    
+    if (out.getStatus().failed())
+    { return false; }
+    
+    if (this->shouldRewriteLog)
+    {
+        this->compactedLogSize = out.getPosition();
+        this->shouldRewriteLog = false;
+    }
+    
+    this->firstUnloggedIndex = numTransactions;
+    this->lastLoggedCount = numTransactions;
+    this->lastLoggedNextIndex = cursorIndex;
+    this->lastLoggedStamp = this->historyStamp;
+    return true;
+}
+
+void UndoStack::discardLoggedHistory()
+{
+    // the transactions in memory become the whole history,
+    // numbered from the beginning of a new log
+    this->baseIndex = 0;
+    this->firstUnloggedIndex = 0;
+    this->shouldRewriteLog = true;
+}
+
+// Copies only the live transaction records into a new file,
+// dropping the ones overwritten by later records and all the old cursors
+bool UndoStack::compactHistoryLog(int numLiveTransactions)
+{
+    UndoLogReader reader(this->historyLogFile);
+    UndoLogRecord record;
+    
+    if (! reader.readPrevious(record) || record.magic != undoLogCursorMagic)
+    { return false; }
+    
+    Array<UndoLogRecord> liveRecords;
+    int upperBound = numLiveTransactions;
+    
+    while (upperBound > 0 && reader.readPrevious(record))
+    {
+        if (record.magic == undoLogTransactionMagic && record.index < upperBound)
+        {
+            upperBound = record.index;
+            liveRecords.insert(0, record);
+        }
+    }
+    
+    if (liveRecords.size() != numLiveTransactions)
+    { return false; }
+    
+    const File tempFile(this->historyLogFile.getSiblingFile(this->historyLogFile.getFileName() + ".tmp"));
+    tempFile.deleteFile();
+    
+    {
+        FileOutputStream out(tempFile);
+        
+        if (! out.openedOk())
+        { return false; }
+        
+        for (const auto &liveRecord : liveRecords)
+        {
+            MemoryBlock payload;
+            reader.readPayload(liveRecord, payload);
+            writeUndoLogRecord(out, undoLogTransactionMagic, liveRecord.index,
+                payload.getData(), int(payload.getSize()));
+        }
+        
+        writeUndoLogCursor(out, numLiveTransactions,
+            jmin(this->lastLoggedNextIndex, numLiveTransactions), this->lastLoggedStamp);
+        
+        out.flush();
+        
+        if (out.getStatus().failed())
+        {
+            tempFile.deleteFile();
+            return false;
+        }
+        
+        this->compactedLogSize = out.getPosition();
+    }
+    
+    if (! tempFile.replaceFileIn(this->historyLogFile))
+    {
+        tempFile.deleteFile();
+        return false;
+    }
+    
+    this->lastLoggedCount = numLiveTransactions;
+    return true;
+}
+
+bool UndoStack::hasOlderHistory() const noexcept
+{
+    return (this->nextIndex == 0 && this->baseIndex > 0);
+}
+
+bool UndoStack::loadOlderHistory()
+{
+    const int toIndex = this->baseIndex;
+    const int fromIndex = jmax(0, toIndex - MAX_TRANSACTIONS_TO_STORE);
+    
+    int numTransactions = 0;
+    int cursorIndex = 0;
+    String stamp;
+    OwnedArray<ActionSet> loadedSets;
+    
+    if (! this->readHistoryLog(fromIndex, toIndex, loadedSets, numTransactions, cursorIndex, stamp))
+    {
+        // the log is gone or broken, nothing older can be restored
+        this->discardLoggedHistory();
+        return false;
+    }
+    
+    for (int i = loadedSets.size(); --i >= 0;)
+    {
+        this->totalUnitsStored += loadedSets.getUnchecked(i)->getTotalSize();
+        this->transactions.insert(0, loadedSets.removeAndReturn(i));
+    }
+    
+    this->baseIndex = fromIndex;
+    this->nextIndex += (toIndex - fromIndex);
+    return true;
+}
+
+bool UndoStack::readHistoryLog(int fromIndex, int toIndex,
+                               OwnedArray<ActionSet> &result,
+                               int &numTransactions, int &cursorIndex,
+                               String &stamp) const
+{
+    result.clear();
+    
+    UndoLogReader reader(this->historyLogFile);
+    UndoLogRecord record;
+    
+    // the last record is always a cursor, unless the app died in the middle of a flush
+    if (! reader.readPrevious(record) || record.magic != undoLogCursorMagic)
+    { return false; }
+    
+    numTransactions = record.index;
+    
+    if (! reader.readCursor(record, cursorIndex, stamp))
+    { return false; }
+    
+    cursorIndex = jlimit(0, numTransactions, cursorIndex);
+    
+    if (fromIndex >= toIndex)
+    { return true; }
+    
+    // walking backwards, the first record met for each index is the live one,
+    // so the indices of the records taken are strictly decreasing
+    int upperBound = numTransactions;
+    
+    while (upperBound > fromIndex && reader.readPrevious(record))
+    {
+        if (record.magic != undoLogTransactionMagic ||
+            record.index >= upperBound)
+        {
+            continue;
+        }
+        
+        upperBound = record.index;
+        
+        if (record.index >= fromIndex && record.index < toIndex)
+        {
+            ScopedPointer<XmlElement> xml(reader.readTransaction(record));
+            
+            if (xml == nullptr)
+            { return false; }
+            
+            auto actionSet = new ActionSet(this->project, String::empty);
+            actionSet->deserialize(*xml);
+            result.insert(0, actionSet);
+        }
+    }
+    
+    if (result.size() != (toIndex - fromIndex))
+    {
+        result.clear();
+        return false;
+    }
+    
+    return true;
+}
@@ -26,8 +26,9 @@ class UndoStack : public ChangeBroadcaster, public Serializable
 {
 public:
 
+    // units are the bytes reported by UndoAction::getSizeInUnits
     explicit UndoStack(ProjectTreeItem &parentProject,
-              int maxNumberOfUnitsToKeep = 30000,
+              int maxNumberOfUnitsToKeep = 8 * 1024 * 1024,
               int minimumTransactionsToKeep = 30);
 
     ~UndoStack() override;
@@ -62,6 +63,22 @@ public:
     void deserialize(const XmlElement &xml) override;
     void reset() override;
     
+    //===------------------------------------------------------------------===//
+    // History log
+    //===------------------------------------------------------------------===//
+    
+    // the history is kept out of the project file, in an append-only sidecar log;
+    // only the latest transactions are loaded on open, the older ones are read on demand.
+    // The log is only written when the project is saved, and both files share a stamp,
+    // renewed on each save, so that a log left from another version of the project is never replayed
+    void setHistoryLogFile(const File &file);
+    void loadHistoryLog();
+    bool flushHistoryLog();
+    
+    const String &getHistoryStamp() const noexcept;
+    void setHistoryStamp(const String &stamp);
+    void renewHistoryStamp();
+    
 private:
 
     ProjectTreeItem &project;
@@ -80,5 +97,35 @@ private:
     
     void clearFutureTransactions();
     
+    File historyLogFile;
+    
+    // absolute index of transactions[0] in the log
+    int baseIndex;
+    
+    // absolute index of the first transaction not yet written to the log
+    int firstUnloggedIndex;
+    
+    int lastLoggedCount, lastLoggedNextIndex;
+    String lastLoggedStamp;
+    
+    String historyStamp;
+    
+    // set when the log doesn't match the history anymore,
+    // so the next flush truncates it and writes everything anew
+    bool shouldRewriteLog;
+    
+    // the log size right after the last compaction
+    int64 compactedLogSize;
+    
+    void discardLoggedHistory();
+    bool compactHistoryLog(int numLiveTransactions);
+    
+    bool hasOlderHistory() const noexcept;
+    bool loadOlderHistory();
+    bool readHistoryLog(int fromIndex, int toIndex,
+                        OwnedArray<ActionSet> &result,
+                        int &numTransactions, int &cursorIndex,
+                        String &stamp) const;
+    
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (UndoStack)
 };
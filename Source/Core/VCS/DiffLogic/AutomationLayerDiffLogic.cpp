@@ -365,23 +365,18 @@ XmlElement *mergeEventsAdded(const XmlElement *state, const XmlElement *changes)
     result.addArray(stateNotes);
 
     // на всякий пожарный, ищем, нет ли в состоянии нот с теми же id, где нет - добавляем
-    for (int i = 0; i < changesNotes.size(); ++i)
-    {
-        bool foundNoteInState = false;
-        const AutomationEvent *changesNote = static_cast<AutomationEvent *>(changesNotes.getUnchecked(i));
+    HashMap<MidiEvent::Id, int> stateIDs;
 
-        for (int j = 0; j < stateNotes.size(); ++j)
-        {
-            const AutomationEvent *stateNote = static_cast<AutomationEvent *>(stateNotes.getUnchecked(j));
+    for (int j = 0; j < stateNotes.size(); ++j)
+    {
+        stateIDs.set(stateNotes.getUnchecked(j)->getId(), j);
+    }
 
-            if (stateNote->getId() == changesNote->getId())
-            {
-                foundNoteInState = true;
-                break;
-            }
-        }
+    for (int i = 0; i < changesNotes.size(); ++i)
+    {
+        const MidiEvent *changesNote = changesNotes.getUnchecked(i);
 
-        if (! foundNoteInState)
+        if (! stateIDs.contains(changesNote->getId()))
         {
             result.add(changesNote);
         }
@@ -399,23 +394,18 @@ XmlElement *mergeEventsRemoved(const XmlElement *state, const XmlElement *change
     Array<const MidiEvent *> result;
 
     // добавляем все ноты из состояния, которых нет в изменениях
-    for (int i = 0; i < stateNotes.size(); ++i)
-    {
-        bool foundNoteInChanges = false;
-        const AutomationEvent *stateNote = static_cast<AutomationEvent *>(stateNotes.getUnchecked(i));
+    HashMap<MidiEvent::Id, int> changesIDs;
 
-        for (int j = 0; j < changesNotes.size(); ++j)
-        {
-            const AutomationEvent *changesNote = static_cast<AutomationEvent *>(changesNotes.getUnchecked(j));
+    for (int j = 0; j < changesNotes.size(); ++j)
+    {
+        changesIDs.set(changesNotes.getUnchecked(j)->getId(), j);
+    }
 
-            if (stateNote->getId() == changesNote->getId())
-            {
-                foundNoteInChanges = true;
-                break;
-            }
-        }
+    for (int i = 0; i < stateNotes.size(); ++i)
+    {
+        const MidiEvent *stateNote = stateNotes.getUnchecked(i);
 
-        if (! foundNoteInChanges)
+        if (! changesIDs.contains(stateNote->getId()))
         {
             result.add(stateNote);
         }
@@ -431,29 +421,29 @@ XmlElement *mergeEventsChanged(const XmlElement *state, const XmlElement *change
     deserializeChanges(state, changes, stateNotes, changesNotes);
 
     Array<const MidiEvent *> result;
-    result.addArray(stateNotes);
+    result.ensureStorageAllocated(stateNotes.size());
 
     // снова ищем по id и заменяем
+    HashMap<MidiEvent::Id, const MidiEvent *> changesIDs;
+
+    for (int j = 0; j < changesNotes.size(); ++j)
+    {
+        const MidiEvent *changesNote = changesNotes.getUnchecked(j);
+        changesIDs.set(changesNote->getId(), changesNote);
+    }
+
     for (int i = 0; i < stateNotes.size(); ++i)
     {
-        bool foundNoteInChanges = false;
-        const AutomationEvent *stateNote = static_cast<AutomationEvent *>(stateNotes.getUnchecked(i));
+        const MidiEvent *stateNote = stateNotes.getUnchecked(i);
 
-        for (int j = 0; j < changesNotes.size(); ++j)
+        if (changesIDs.contains(stateNote->getId()))
         {
-            const AutomationEvent *changesNote = static_cast<AutomationEvent *>(changesNotes.getUnchecked(j));
-
-            if (stateNote->getId() == changesNote->getId())
-            {
-                foundNoteInChanges = true;
-                result.removeAllInstancesOf(stateNote);
-                result.addIfNotAlreadyThere(changesNote);
-
-                break;
-            }
+            result.add(changesIDs[stateNote->getId()]);
+        }
+        else
+        {
+            result.add(stateNote);
         }
-
-        //jassert(foundNoteInChanges);
     }
 
     return serializeLayer(result, AutoLayerDeltas::eventsAdded);
@@ -521,62 +511,57 @@ Array<NewSerializedDelta> createEventsDiffs(const XmlElement *state, const XmlEl
     Array<const MidiEvent *> removedEvents;
     Array<const MidiEvent *> changedEvents;
 
-    // собственно, само сравнение
+    // собственно, само сравнение:
+    // вместо вложенных циклов - хэш-таблицы по id событий
+    HashMap<MidiEvent::Id, const AutomationEvent *> stateIDs;
+    HashMap<MidiEvent::Id, const AutomationEvent *> changesIDs;
+
     for (int i = 0; i < stateEvents.size(); ++i)
     {
-        bool foundNoteInChanges = false;
         const AutomationEvent *stateEvent = static_cast<AutomationEvent *>(stateEvents.getUnchecked(i));
+        stateIDs.set(stateEvent->getId(), stateEvent);
+    }
 
-        for (int j = 0; j < changesEvents.size(); ++j)
-        {
-            const AutomationEvent *changesEvent = static_cast<AutomationEvent *>(changesEvents.getUnchecked(j));
+    for (int j = 0; j < changesEvents.size(); ++j)
+    {
+        const AutomationEvent *changesEvent = static_cast<AutomationEvent *>(changesEvents.getUnchecked(j));
+        changesIDs.set(changesEvent->getId(), changesEvent);
+    }
 
-            // нота из состояния - существует в изменениях. добавляем запись changed, если нужно.
-            if (stateEvent->getId() == changesEvent->getId())
-            {
-                foundNoteInChanges = true;
+    for (int i = 0; i < stateEvents.size(); ++i)
+    {
+        const AutomationEvent *stateEvent = static_cast<AutomationEvent *>(stateEvents.getUnchecked(i));
 
-                const bool eventHasChanged = (stateEvent->getBeat() != changesEvent->getBeat() ||
-                                              stateEvent->getCurvature() != changesEvent->getCurvature() ||
-                                              stateEvent->getControllerValue() != changesEvent->getControllerValue());
+        // нота из состояния - существует в изменениях. добавляем запись changed, если нужно.
+        if (changesIDs.contains(stateEvent->getId()))
+        {
+            const AutomationEvent *changesEvent = changesIDs[stateEvent->getId()];
 
-                if (eventHasChanged)
-                {
-                    changedEvents.add(changesEvent);
-                }
+            const bool eventHasChanged = (stateEvent->getBeat() != changesEvent->getBeat() ||
+                                          stateEvent->getCurvature() != changesEvent->getCurvature() ||
+                                          stateEvent->getControllerValue() != changesEvent->getControllerValue());
 
-                break;
+            if (eventHasChanged)
+            {
+                changedEvents.add(changesEvent);
             }
         }
-
         // нота из состояния - в изменениях не найдена. добавляем запись removed.
-        if (! foundNoteInChanges)
+        else
         {
             removedEvents.add(stateEvent);
         }
     }
 
-    // теперь ищем в изменениях ноты, которые отсутствуют в состоянии
+    // теперь ищем в изменениях ноты, которые отсутствуют в состоянии,
+    // и пишем их в список добавленных
     for (int i = 0; i < changesEvents.size(); ++i)
     {
-        bool foundNoteInState = false;
-        const AutomationEvent *changesNote = static_cast<AutomationEvent *>(changesEvents.getUnchecked(i));
+        const AutomationEvent *changesEvent = static_cast<AutomationEvent *>(changesEvents.getUnchecked(i));
 
-        for (int j = 0; j < stateEvents.size(); ++j)
+        if (! stateIDs.contains(changesEvent->getId()))
         {
-            const AutomationEvent *stateNote = static_cast<AutomationEvent *>(stateEvents.getUnchecked(j));
-
-            if (stateNote->getId() == changesNote->getId())
-            {
-                foundNoteInState = true;
-                break;
-            }
-        }
-
-        // и пишем ее в список добавленных
-        if (! foundNoteInState)
-        {
-            addedEvents.add(changesNote);
+            addedEvents.add(changesEvent);
         }
     }
 
@@ -614,14 +599,19 @@ void deserializeChanges(const XmlElement *state,
         OwnedArray<MidiEvent> &stateNotes,
         OwnedArray<MidiEvent> &changesNotes)
 {
+    // добавляем все как есть и сортируем один раз
+    AutomationEvent sorter;
+
     if (state != nullptr)
     {
         forEachXmlChildElementWithTagName(*state, e, Serialization::Core::event)
         {
             auto event = new AutomationEvent();
             event->deserialize(*e);
-            stateNotes.addSorted(*event, event);
+            stateNotes.add(event);
         }
+
+        stateNotes.sort(sorter);
     }
 
     if (changes != nullptr)
@@ -630,8 +620,10 @@ void deserializeChanges(const XmlElement *state,
         {
             auto event = new AutomationEvent();
             event->deserialize(*e);
-            changesNotes.addSorted(*event, event);
+            changesNotes.add(event);
         }
+
+        changesNotes.sort(sorter);
     }
 }
 
@@ -28,14 +28,18 @@ using namespace VCS;
 void deserializePatternChanges(const XmlElement *state, const XmlElement *changes,
     Array<Clip> &stateClips, Array<Clip> &changesClips)
 {
+    Clip sorter;
+
     if (state != nullptr)
     {
         forEachXmlChildElementWithTagName(*state, e, Serialization::Core::clip)
         {
             Clip clip;
             clip.deserialize(*e);
-            stateClips.addSorted(clip, clip);
+            stateClips.add(clip);
         }
+
+        stateClips.sort(sorter);
     }
 
     if (changes != nullptr)
@@ -44,8 +48,10 @@ void deserializePatternChanges(const XmlElement *state, const XmlElement *change
         {
             Clip clip;
             clip.deserialize(*e);
-            changesClips.addSorted(clip, clip);
+            changesClips.add(clip);
         }
+
+        changesClips.sort(sorter);
     }
 }
 
@@ -145,7 +151,7 @@ XmlElement *PatternDiffLogic::mergeClipsChanged(const XmlElement *state,
     deserializePatternChanges(state, changes, stateClips, changesClips);
 
     Array<Clip> result;
-    result.addArray(stateClips);
+    result.ensureStorageAllocated(stateClips.size());
 
     HashMap<Clip::Id, Clip> changesIDs;
 
@@ -161,9 +167,11 @@ XmlElement *PatternDiffLogic::mergeClipsChanged(const XmlElement *state,
 
         if (changesIDs.contains(stateClip.getId()))
         {
-            const Clip changesClip = changesIDs[stateClip.getId()];
-            result.removeAllInstancesOf(stateClip);
-            result.addIfNotAlreadyThere(changesClip);
+            result.add(changesIDs[stateClip.getId()]);
+        }
+        else
+        {
+            result.add(stateClip);
         }
     }
 
@@ -184,28 +192,34 @@ Array<VCS::NewSerializedDelta> PatternDiffLogic::createClipsDiffs(
     Array<Clip> removedClips;
     Array<Clip> changedClips;
 
+    HashMap<Clip::Id, Clip> stateIDs;
+    HashMap<Clip::Id, Clip> changesIDs;
+
     for (int i = 0; i < stateClips.size(); ++i)
     {
-        bool foundInChanges = false;
         const Clip stateClip(stateClips.getUnchecked(i));
+        stateIDs.set(stateClip.getId(), stateClip);
+    }
 
-        for (int j = 0; j < changesClips.size(); ++j)
-        {
-            const Clip changesClip(changesClips.getUnchecked(j));
+    for (int j = 0; j < changesClips.size(); ++j)
+    {
+        const Clip changesClip(changesClips.getUnchecked(j));
+        changesIDs.set(changesClip.getId(), changesClip);
+    }
 
-            if (stateClip.getId() == changesClip.getId())
-            {
-                foundInChanges = true;
-                if (stateClip.getStartBeat() != changesClip.getStartBeat())
-                {
-                    changedClips.add(changesClip);
-                }
+    for (int i = 0; i < stateClips.size(); ++i)
+    {
+        const Clip stateClip(stateClips.getUnchecked(i));
 
-                break;
+        if (changesIDs.contains(stateClip.getId()))
+        {
+            const Clip changesClip(changesIDs[stateClip.getId()]);
+            if (stateClip.getStartBeat() != changesClip.getStartBeat())
+            {
+                changedClips.add(changesClip);
             }
         }
-
-        if (!foundInChanges)
+        else
         {
             removedClips.add(stateClip);
         }
@@ -213,20 +227,9 @@ Array<VCS::NewSerializedDelta> PatternDiffLogic::createClipsDiffs(
 
     for (int i = 0; i < changesClips.size(); ++i)
     {
-        bool foundInState = false;
         const Clip changesClip(changesClips.getUnchecked(i));
 
-        for (int j = 0; j < stateClips.size(); ++j)
-        {
-            const Clip stateClip(stateClips.getUnchecked(j));
-            if (stateClip.getId() == changesClip.getId())
-            {
-                foundInState = true;
-                break;
-            }
-        }
-
-        if (!foundInState)
+        if (!stateIDs.contains(changesClip.getId()))
         {
             addedClips.add(changesClip);
         }
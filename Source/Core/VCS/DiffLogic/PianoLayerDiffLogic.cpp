@@ -415,8 +415,7 @@ XmlElement *mergeNotesChanged(const XmlElement *state, const XmlElement *changes
     deserializeLayerChanges(state, changes, stateNotes, changesNotes);
 
     Array<const MidiEvent *> result;
-
-    result.addArray(stateNotes);
+    result.ensureStorageAllocated(stateNotes.size());
 
     // снова ищем по id и заменяем
     HashMap<MidiEvent::Id, const Note *> changesIDs;
@@ -432,9 +431,11 @@ XmlElement *mergeNotesChanged(const XmlElement *state, const XmlElement *changes
         const Note *stateNote(stateNotes.getUnchecked(i));
         if (changesIDs.contains(stateNote->getId()))
         {
-            const Note *changesNote = changesIDs[stateNote->getId()];
-            result.removeAllInstancesOf(stateNote);
-            result.addIfNotAlreadyThere(changesNote);
+            result.add(changesIDs[stateNote->getId()]);
+        }
+        else
+        {
+            result.add(stateNote);
         }
     }
 
@@ -501,62 +502,57 @@ Array<NewSerializedDelta> createEventsDiffs(const XmlElement *state, const XmlEl
     Array<const MidiEvent *> removedNotes;
     Array<const MidiEvent *> changedNotes;
 
-    // собственно, само сравнение
+    // собственно, само сравнение:
+    // вместо вложенных циклов - хэш-таблицы по id событий
+    HashMap<MidiEvent::Id, const Note *> stateIDs;
+    HashMap<MidiEvent::Id, const Note *> changesIDs;
+
     for (int i = 0; i < stateNotes.size(); ++i)
     {
-        bool foundNoteInChanges = false;
         const Note *stateNote(stateNotes.getUnchecked(i));
+        stateIDs.set(stateNote->getId(), stateNote);
+    }
 
-        for (int j = 0; j < changesNotes.size(); ++j)
-        {
-            const Note *changesNote(changesNotes.getUnchecked(j));
+    for (int j = 0; j < changesNotes.size(); ++j)
+    {
+        const Note *changesNote(changesNotes.getUnchecked(j));
+        changesIDs.set(changesNote->getId(), changesNote);
+    }
 
-            // нота из состояния - существует в изменениях. добавляем запись changed, если нужно.
-            if (stateNote->getId() == changesNote->getId())
-            {
-                foundNoteInChanges = true;
+    for (int i = 0; i < stateNotes.size(); ++i)
+    {
+        const Note *stateNote(stateNotes.getUnchecked(i));
 
-                const bool noteHasChanged =
-                    (stateNote->getKey() != changesNote->getKey() ||
-                    stateNote->getBeat() != changesNote->getBeat() ||
-                    stateNote->getLength() != changesNote->getLength() ||
-                    stateNote->getVelocity() != changesNote->getVelocity());
+        // нота из состояния - существует в изменениях. добавляем запись changed, если нужно.
+        if (changesIDs.contains(stateNote->getId()))
+        {
+            const Note *changesNote = changesIDs[stateNote->getId()];
 
-                if (noteHasChanged)
-                {
-                    changedNotes.add(changesNote);
-                }
+            const bool noteHasChanged =
+                (stateNote->getKey() != changesNote->getKey() ||
+                stateNote->getBeat() != changesNote->getBeat() ||
+                stateNote->getLength() != changesNote->getLength() ||
+                stateNote->getVelocity() != changesNote->getVelocity());
 
-                break;
+            if (noteHasChanged)
+            {
+                changedNotes.add(changesNote);
             }
         }
-
         // нота из состояния - в изменениях не найдена. добавляем запись removed.
-        if (! foundNoteInChanges)
+        else
         {
             removedNotes.add(stateNote);
         }
     }
 
-    // теперь ищем в изменениях ноты, которые отсутствуют в состоянии
+    // теперь ищем в изменениях ноты, которые отсутствуют в состоянии,
+    // и пишем их в список добавленных
     for (int i = 0; i < changesNotes.size(); ++i)
     {
-        bool foundNoteInState = false;
         const Note *changesNote(changesNotes.getUnchecked(i));
 
-        for (int j = 0; j < stateNotes.size(); ++j)
-        {
-            const Note *stateNote(stateNotes.getUnchecked(j));
-
-            if (stateNote->getId() == changesNote->getId())
-            {
-                foundNoteInState = true;
-                break;
-            }
-        }
-
-        // и пишем ее в список добавленных
-        if (! foundNoteInState)
+        if (! stateIDs.contains(changesNote->getId()))
         {
             addedNotes.add(changesNote);
         }
@@ -597,14 +593,20 @@ void deserializeLayerChanges(const XmlElement *state,
         OwnedArray<Note> &stateNotes,
         OwnedArray<Note> &changesNotes)
 {
+    // добавляем все как есть и сортируем один раз,
+    // addSorted на каждую ноту дает квадратичное число перемещений
+    Note sorter;
+
     if (state != nullptr)
     {
         forEachXmlChildElementWithTagName(*state, e, Serialization::Core::note)
         {
             auto note = new Note();
             note->deserialize(*e);
-            stateNotes.addSorted(*note, note);
+            stateNotes.add(note);
         }
+
+        stateNotes.sort(sorter);
     }
 
     if (changes != nullptr)
@@ -613,8 +615,10 @@ void deserializeLayerChanges(const XmlElement *state,
         {
             auto note = new Note();
             note->deserialize(*e);
-            changesNotes.addSorted(*note, note);
+            changesNotes.add(note);
         }
+
+        changesNotes.sort(sorter);
     }
 }
 
@@ -26,6 +26,93 @@
 
 using namespace VCS;
 
+// Merge helpers only match events by id, so they don't care about the event types
+
+static Array<const MidiEvent *> mergeEventsAdded(const OwnedArray<MidiEvent> &stateEvents,
+    const OwnedArray<MidiEvent> &changesEvents)
+{
+    Array<const MidiEvent *> result;
+    result.addArray(stateEvents);
+
+    // на всякий пожарный, ищем, нет ли в состоянии событий с теми же id, где нет - добавляем
+    HashMap<MidiEvent::Id, int> stateIDs;
+
+    for (int j = 0; j < stateEvents.size(); ++j)
+    {
+        stateIDs.set(stateEvents.getUnchecked(j)->getId(), j);
+    }
+
+    for (int i = 0; i < changesEvents.size(); ++i)
+    {
+        const MidiEvent *changesEvent = changesEvents.getUnchecked(i);
+
+        if (! stateIDs.contains(changesEvent->getId()))
+        {
+            result.add(changesEvent);
+        }
+    }
+
+    return result;
+}
+
+static Array<const MidiEvent *> mergeEventsRemoved(const OwnedArray<MidiEvent> &stateEvents,
+    const OwnedArray<MidiEvent> &changesEvents)
+{
+    Array<const MidiEvent *> result;
+
+    // добавляем все события из состояния, которых нет в изменениях
+    HashMap<MidiEvent::Id, int> changesIDs;
+
+    for (int j = 0; j < changesEvents.size(); ++j)
+    {
+        changesIDs.set(changesEvents.getUnchecked(j)->getId(), j);
+    }
+
+    for (int i = 0; i < stateEvents.size(); ++i)
+    {
+        const MidiEvent *stateEvent = stateEvents.getUnchecked(i);
+
+        if (! changesIDs.contains(stateEvent->getId()))
+        {
+            result.add(stateEvent);
+        }
+    }
+
+    return result;
+}
+
+static Array<const MidiEvent *> mergeEventsChanged(const OwnedArray<MidiEvent> &stateEvents,
+    const OwnedArray<MidiEvent> &changesEvents)
+{
+    Array<const MidiEvent *> result;
+    result.ensureStorageAllocated(stateEvents.size());
+
+    // снова ищем по id и заменяем
+    HashMap<MidiEvent::Id, const MidiEvent *> changesIDs;
+
+    for (int j = 0; j < changesEvents.size(); ++j)
+    {
+        const MidiEvent *changesEvent = changesEvents.getUnchecked(j);
+        changesIDs.set(changesEvent->getId(), changesEvent);
+    }
+
+    for (int i = 0; i < stateEvents.size(); ++i)
+    {
+        const MidiEvent *stateEvent = stateEvents.getUnchecked(i);
+
+        if (changesIDs.contains(stateEvent->getId()))
+        {
+            result.add(changesIDs[stateEvent->getId()]);
+        }
+        else
+        {
+            result.add(stateEvent);
+        }
+    }
+
+    return result;
+}
+
 ProjectTimelineDiffLogic::ProjectTimelineDiffLogic(TrackedItem &targetItem) :
     DiffLogic(targetItem)
 {
@@ -227,34 +314,7 @@ XmlElement *ProjectTimelineDiffLogic::mergeAnnotationsAdded(const XmlElement *st
     OwnedArray<MidiEvent> changesNotes;
     this->deserializeChanges(state, changes, stateNotes, changesNotes);
 
-    Array<const MidiEvent *> result;
-
-    result.addArray(stateNotes);
-
-    // на всякий пожарный, ищем, нет ли в состоянии нот с теми же id, где нет - добавляем
-    for (int i = 0; i < changesNotes.size(); ++i)
-    {
-        bool foundNoteInState = false;
-        const AnnotationEvent *changesNote = static_cast<AnnotationEvent *>(changesNotes.getUnchecked(i));
-
-        for (int j = 0; j < stateNotes.size(); ++j)
-        {
-            const AnnotationEvent *stateNote = static_cast<AnnotationEvent *>(stateNotes.getUnchecked(j));
-
-            if (stateNote->getId() == changesNote->getId())
-            {
-                foundNoteInState = true;
-                break;
-            }
-        }
-
-        if (! foundNoteInState)
-        {
-            result.add(changesNote);
-        }
-    }
-
-    return this->serializeLayer(result, ProjectTimelineDeltas::annotationsAdded);
+    return this->serializeLayer(mergeEventsAdded(stateNotes, changesNotes), ProjectTimelineDeltas::annotationsAdded);
 }
 
 XmlElement *ProjectTimelineDiffLogic::mergeAnnotationsRemoved(const XmlElement *state, const XmlElement *changes) const
@@ -263,32 +323,7 @@ XmlElement *ProjectTimelineDiffLogic::mergeAnnotationsRemoved(const XmlElement *
     OwnedArray<MidiEvent> changesNotes;
     this->deserializeChanges(state, changes, stateNotes, changesNotes);
 
-    Array<const MidiEvent *> result;
-
-    // добавляем все ноты из состояния, которых нет в изменениях
-    for (int i = 0; i < stateNotes.size(); ++i)
-    {
-        bool foundNoteInChanges = false;
-        const AnnotationEvent *stateNote = static_cast<AnnotationEvent *>(stateNotes.getUnchecked(i));
-
-        for (int j = 0; j < changesNotes.size(); ++j)
-        {
-            const AnnotationEvent *changesNote = static_cast<AnnotationEvent *>(changesNotes.getUnchecked(j));
-
-            if (stateNote->getId() == changesNote->getId())
-            {
-                foundNoteInChanges = true;
-                break;
-            }
-        }
-
-        if (! foundNoteInChanges)
-        {
-            result.add(stateNote);
-        }
-    }
-
-    return this->serializeLayer(result, ProjectTimelineDeltas::annotationsAdded);
+    return this->serializeLayer(mergeEventsRemoved(stateNotes, changesNotes), ProjectTimelineDeltas::annotationsAdded);
 }
 
 XmlElement *ProjectTimelineDiffLogic::mergeAnnotationsChanged(const XmlElement *state, const XmlElement *changes) const
@@ -297,34 +332,7 @@ XmlElement *ProjectTimelineDiffLogic::mergeAnnotationsChanged(const XmlElement *
     OwnedArray<MidiEvent> changesNotes;
     this->deserializeChanges(state, changes, stateNotes, changesNotes);
 
-    Array<const MidiEvent *> result;
-
-    result.addArray(stateNotes);
-
-    // снова ищем по id и заменяем
-    for (int i = 0; i < stateNotes.size(); ++i)
-    {
-        bool foundNoteInChanges = false;
-        const AnnotationEvent *stateNote = static_cast<AnnotationEvent *>(stateNotes.getUnchecked(i));
-
-        for (int j = 0; j < changesNotes.size(); ++j)
-        {
-            const AnnotationEvent *changesNote = static_cast<AnnotationEvent *>(changesNotes.getUnchecked(j));
-
-            if (stateNote->getId() == changesNote->getId())
-            {
-                foundNoteInChanges = true;
-                result.removeAllInstancesOf(stateNote);
-                result.addIfNotAlreadyThere(changesNote);
-
-                break;
-            }
-        }
-
-        //jassert(foundNoteInChanges);
-    }
-
-    return this->serializeLayer(result, ProjectTimelineDeltas::annotationsAdded);
+    return this->serializeLayer(mergeEventsChanged(stateNotes, changesNotes), ProjectTimelineDeltas::annotationsAdded);
 }
 
 //===----------------------------------------------------------------------===//
@@ -336,35 +344,8 @@ XmlElement *ProjectTimelineDiffLogic::mergeTimeSignaturesAdded(const XmlElement
     OwnedArray<MidiEvent> stateNotes;
     OwnedArray<MidiEvent> changesNotes;
     this->deserializeChanges(state, changes, stateNotes, changesNotes);
-    
-    Array<const MidiEvent *> result;
-    
-    result.addArray(stateNotes);
-    
-    // на всякий пожарный, ищем, нет ли в состоянии нот с теми же id, где нет - добавляем
-    for (int i = 0; i < changesNotes.size(); ++i)
-    {
-        bool foundNoteInState = false;
-        const TimeSignatureEvent *changesNote = static_cast<TimeSignatureEvent *>(changesNotes.getUnchecked(i));
-        
-        for (int j = 0; j < stateNotes.size(); ++j)
-        {
-            const TimeSignatureEvent *stateNote = static_cast<TimeSignatureEvent *>(stateNotes.getUnchecked(j));
-            
-            if (stateNote->getId() == changesNote->getId())
-            {
-                foundNoteInState = true;
-                break;
-            }
-        }
-        
-        if (! foundNoteInState)
-        {
-            result.add(changesNote);
-        }
-    }
-    
-    return this->serializeLayer(result, ProjectTimelineDeltas::timeSignaturesAdded);
+
+    return this->serializeLayer(mergeEventsAdded(stateNotes, changesNotes), ProjectTimelineDeltas::timeSignaturesAdded);
 }
 
 XmlElement *ProjectTimelineDiffLogic::mergeTimeSignaturesRemoved(const XmlElement *state, const XmlElement *changes) const
@@ -372,33 +353,8 @@ XmlElement *ProjectTimelineDiffLogic::mergeTimeSignaturesRemoved(const XmlElemen
     OwnedArray<MidiEvent> stateNotes;
     OwnedArray<MidiEvent> changesNotes;
     this->deserializeChanges(state, changes, stateNotes, changesNotes);
-    
-    Array<const MidiEvent *> result;
-    
-    // добавляем все ноты из состояния, которых нет в изменениях
-    for (int i = 0; i < stateNotes.size(); ++i)
-    {
-        bool foundNoteInChanges = false;
-        const TimeSignatureEvent *stateNote = static_cast<TimeSignatureEvent *>(stateNotes.getUnchecked(i));
-        
-        for (int j = 0; j < changesNotes.size(); ++j)
-        {
-            const TimeSignatureEvent *changesNote = static_cast<TimeSignatureEvent *>(changesNotes.getUnchecked(j));
-            
-            if (stateNote->getId() == changesNote->getId())
-            {
-                foundNoteInChanges = true;
-                break;
-            }
-        }
-        
-        if (! foundNoteInChanges)
-        {
-            result.add(stateNote);
-        }
-    }
-    
-    return this->serializeLayer(result, ProjectTimelineDeltas::timeSignaturesAdded);
+
+    return this->serializeLayer(mergeEventsRemoved(stateNotes, changesNotes), ProjectTimelineDeltas::timeSignaturesAdded);
 }
 
 XmlElement *ProjectTimelineDiffLogic::mergeTimeSignaturesChanged(const XmlElement *state, const XmlElement *changes) const
@@ -406,35 +362,8 @@ XmlElement *ProjectTimelineDiffLogic::mergeTimeSignaturesChanged(const XmlElemen
     OwnedArray<MidiEvent> stateNotes;
     OwnedArray<MidiEvent> changesNotes;
     this->deserializeChanges(state, changes, stateNotes, changesNotes);
-    
-    Array<const MidiEvent *> result;
-    
-    result.addArray(stateNotes);
-    
-    // снова ищем по id и заменяем
-    for (int i = 0; i < stateNotes.size(); ++i)
-    {
-        bool foundNoteInChanges = false;
-        const TimeSignatureEvent *stateNote = static_cast<TimeSignatureEvent *>(stateNotes.getUnchecked(i));
-        
-        for (int j = 0; j < changesNotes.size(); ++j)
-        {
-            const TimeSignatureEvent *changesNote = static_cast<TimeSignatureEvent *>(changesNotes.getUnchecked(j));
-            
-            if (stateNote->getId() == changesNote->getId())
-            {
-                foundNoteInChanges = true;
-                result.removeAllInstancesOf(stateNote);
-                result.addIfNotAlreadyThere(changesNote);
-                
-                break;
-            }
-        }
-        
-        //jassert(foundNoteInChanges);
-    }
-    
-    return this->serializeLayer(result, ProjectTimelineDeltas::timeSignaturesAdded);
+
+    return this->serializeLayer(mergeEventsChanged(stateNotes, changesNotes), ProjectTimelineDeltas::timeSignaturesAdded);
 }
 
 
@@ -458,62 +387,56 @@ Array<NewSerializedDelta> ProjectTimelineDiffLogic::createAnnotationsDiffs(const
     Array<const MidiEvent *> removedEvents;
     Array<const MidiEvent *> changedEvents;
 
-    // собственно, само сравнение
+    // собственно, само сравнение, через хэш-таблицы по id событий
+    HashMap<MidiEvent::Id, const AnnotationEvent *> stateIDs;
+    HashMap<MidiEvent::Id, const AnnotationEvent *> changesIDs;
+
     for (int i = 0; i < stateEvents.size(); ++i)
     {
-        bool foundNoteInChanges = false;
         const AnnotationEvent *stateEvent = static_cast<AnnotationEvent *>(stateEvents.getUnchecked(i));
+        stateIDs.set(stateEvent->getId(), stateEvent);
+    }
 
-        for (int j = 0; j < changesEvents.size(); ++j)
-        {
-            const AnnotationEvent *changesEvent = static_cast<AnnotationEvent *>(changesEvents.getUnchecked(j));
+    for (int j = 0; j < changesEvents.size(); ++j)
+    {
+        const AnnotationEvent *changesEvent = static_cast<AnnotationEvent *>(changesEvents.getUnchecked(j));
+        changesIDs.set(changesEvent->getId(), changesEvent);
+    }
 
-            // нота из состояния - существует в изменениях. добавляем запись changed, если нужно.
-            if (stateEvent->getId() == changesEvent->getId())
-            {
-                foundNoteInChanges = true;
+    for (int i = 0; i < stateEvents.size(); ++i)
+    {
+        const AnnotationEvent *stateEvent = static_cast<AnnotationEvent *>(stateEvents.getUnchecked(i));
 
-                const bool eventHasChanged = (stateEvent->getBeat() != changesEvent->getBeat() ||
-                                              stateEvent->getColour() != changesEvent->getColour() ||
-                                              stateEvent->getDescription() != changesEvent->getDescription());
+        // событие из состояния - существует в изменениях. добавляем запись changed, если нужно.
+        if (changesIDs.contains(stateEvent->getId()))
+        {
+            const AnnotationEvent *changesEvent = changesIDs[stateEvent->getId()];
 
-                if (eventHasChanged)
-                {
-                    changedEvents.add(changesEvent);
-                }
+            const bool eventHasChanged = (stateEvent->getBeat() != changesEvent->getBeat() ||
+                                          stateEvent->getColour() != changesEvent->getColour() ||
+                                          stateEvent->getDescription() != changesEvent->getDescription());
 
-                break;
+            if (eventHasChanged)
+            {
+                changedEvents.add(changesEvent);
             }
         }
-
-        // нота из состояния - в изменениях не найдена. добавляем запись removed.
-        if (! foundNoteInChanges)
+        // событие из состояния - в изменениях не найдено. добавляем запись removed.
+        else
         {
             removedEvents.add(stateEvent);
         }
     }
 
-    // теперь ищем в изменениях ноты, которые отсутствуют в состоянии
+    // теперь ищем в изменениях события, которые отсутствуют в состоянии,
+    // и пишем их в список добавленных
     for (int i = 0; i < changesEvents.size(); ++i)
     {
-        bool foundNoteInState = false;
-        const AnnotationEvent *changesNote = static_cast<AnnotationEvent *>(changesEvents.getUnchecked(i));
-
-        for (int j = 0; j < stateEvents.size(); ++j)
-        {
-            const AnnotationEvent *stateNote = static_cast<AnnotationEvent *>(stateEvents.getUnchecked(j));
-
-            if (stateNote->getId() == changesNote->getId())
-            {
-                foundNoteInState = true;
-                break;
-            }
-        }
+        const AnnotationEvent *changesEvent = static_cast<AnnotationEvent *>(changesEvents.getUnchecked(i));
 
-        // и пишем ее в список добавленных
-        if (! foundNoteInState)
+        if (! stateIDs.contains(changesEvent->getId()))
         {
-            addedEvents.add(changesNote);
+            addedEvents.add(changesEvent);
         }
     }
 
@@ -559,65 +482,59 @@ Array<NewSerializedDelta> ProjectTimelineDiffLogic::createTimeSignaturesDiffs(co
     Array<const MidiEvent *> removedEvents;
     Array<const MidiEvent *> changedEvents;
     
-    // собственно, само сравнение
+    // собственно, само сравнение, через хэш-таблицы по id событий
+    HashMap<MidiEvent::Id, const TimeSignatureEvent *> stateIDs;
+    HashMap<MidiEvent::Id, const TimeSignatureEvent *> changesIDs;
+
     for (int i = 0; i < stateEvents.size(); ++i)
     {
-        bool foundNoteInChanges = false;
         const TimeSignatureEvent *stateEvent = static_cast<TimeSignatureEvent *>(stateEvents.getUnchecked(i));
-        
-        for (int j = 0; j < changesEvents.size(); ++j)
+        stateIDs.set(stateEvent->getId(), stateEvent);
+    }
+
+    for (int j = 0; j < changesEvents.size(); ++j)
+    {
+        const TimeSignatureEvent *changesEvent = static_cast<TimeSignatureEvent *>(changesEvents.getUnchecked(j));
+        changesIDs.set(changesEvent->getId(), changesEvent);
+    }
+
+    for (int i = 0; i < stateEvents.size(); ++i)
+    {
+        const TimeSignatureEvent *stateEvent = static_cast<TimeSignatureEvent *>(stateEvents.getUnchecked(i));
+
+        // событие из состояния - существует в изменениях. добавляем запись changed, если нужно.
+        if (changesIDs.contains(stateEvent->getId()))
         {
-            const TimeSignatureEvent *changesEvent = static_cast<TimeSignatureEvent *>(changesEvents.getUnchecked(j));
-            
-            // событие из состояния - существует в изменениях. добавляем запись changed, если нужно.
-            if (stateEvent->getId() == changesEvent->getId())
+            const TimeSignatureEvent *changesEvent = changesIDs[stateEvent->getId()];
+
+            const bool eventHasChanged = (stateEvent->getBeat() != changesEvent->getBeat() ||
+                                          stateEvent->getNumerator() != changesEvent->getNumerator() ||
+                                          stateEvent->getDenominator() != changesEvent->getDenominator());
+
+            if (eventHasChanged)
             {
-                foundNoteInChanges = true;
-                
-                const bool eventHasChanged = (stateEvent->getBeat() != changesEvent->getBeat() ||
-                                              stateEvent->getNumerator() != changesEvent->getNumerator() ||
-                                              stateEvent->getDenominator() != changesEvent->getDenominator());
-                
-                if (eventHasChanged)
-                {
-                    changedEvents.add(changesEvent);
-                }
-                
-                break;
+                changedEvents.add(changesEvent);
             }
         }
-        
-        // событие из состояния - в изменениях не найдена. добавляем запись removed.
-        if (! foundNoteInChanges)
+        // событие из состояния - в изменениях не найдено. добавляем запись removed.
+        else
         {
             removedEvents.add(stateEvent);
         }
     }
-    
-    // теперь ищем в изменениях события, которые отсутствуют в состоянии
+
+    // теперь ищем в изменениях события, которые отсутствуют в состоянии,
+    // и пишем их в список добавленных
     for (int i = 0; i < changesEvents.size(); ++i)
     {
-        bool foundNoteInState = false;
         const TimeSignatureEvent *changesEvent = static_cast<TimeSignatureEvent *>(changesEvents.getUnchecked(i));
-        
-        for (int j = 0; j < stateEvents.size(); ++j)
-        {
-            const TimeSignatureEvent *stateEvent = static_cast<TimeSignatureEvent *>(stateEvents.getUnchecked(j));
-            
-            if (stateEvent->getId() == changesEvent->getId())
-            {
-                foundNoteInState = true;
-                break;
-            }
-        }
-        
-        // и пишем ее в список добавленных
-        if (! foundNoteInState)
+
+        if (! stateIDs.contains(changesEvent->getId()))
         {
             addedEvents.add(changesEvent);
         }
     }
-    
+
     // сериализуем диффы, если таковые есть
     
     if (addedEvents.size() > 0)
@@ -657,21 +574,26 @@ void VCS::ProjectTimelineDiffLogic::deserializeChanges(const XmlElement *state,
         OwnedArray<MidiEvent> &stateNotes,
         OwnedArray<MidiEvent> &changesNotes) const
 {
+    // добавляем все как есть и сортируем один раз
+    AnnotationEvent sorter;
+
     if (state != nullptr)
     {
         forEachXmlChildElementWithTagName(*state, e, Serialization::Core::annotation)
         {
             AnnotationEvent *event = new AnnotationEvent();
             event->deserialize(*e);
-            stateNotes.addSorted(*event, event);
+            stateNotes.add(event);
         }
 
         forEachXmlChildElementWithTagName(*state, e, Serialization::Core::timeSignature)
         {
             TimeSignatureEvent *event = new TimeSignatureEvent();
             event->deserialize(*e);
-            stateNotes.addSorted(*event, event);
+            stateNotes.add(event);
         }
+
+        stateNotes.sort(sorter);
     }
 
     if (changes != nullptr)
@@ -680,15 +602,17 @@ void VCS::ProjectTimelineDiffLogic::deserializeChanges(const XmlElement *state,
         {
             AnnotationEvent *event = new AnnotationEvent();
             event->deserialize(*e);
-            changesNotes.addSorted(*event, event);
+            changesNotes.add(event);
         }
         
         forEachXmlChildElementWithTagName(*changes, e, Serialization::Core::timeSignature)
         {
             TimeSignatureEvent *event = new TimeSignatureEvent();
             event->deserialize(*e);
-            changesNotes.addSorted(*event, event);
+            changesNotes.add(event);
         }
+
+        changesNotes.sort(sorter);
     }
 }
 
@@ -36,7 +36,8 @@ Head::Head(const Head &other) :
     rebuildingDiffMode(false),
     diff(other.diff),
     headingAt(other.headingAt),
-    state(new HeadState(other.state))
+    state(new HeadState(other.state)),
+    allItemsChanged(true)
 {
     
 }
@@ -49,7 +50,8 @@ Head::Head(Pack::Ptr packPtr, WeakReference<TrackedItemsSource> targetProject) :
     rebuildingDiffMode(false),
     diff(packPtr, ""),
     headingAt(packPtr, ""),
-    state(nullptr)
+    state(nullptr),
+    allItemsChanged(true)
 {
     if (targetVcsItemsSource != nullptr)
     {
@@ -59,7 +61,8 @@ Head::Head(Pack::Ptr packPtr, WeakReference<TrackedItemsSource> targetProject) :
 
 Head::~Head()
 {
-
+    this->stopThread(500);
+    this->diffPool = nullptr;
 }
 
 
@@ -231,6 +234,7 @@ bool Head::moveTo(const Revision &revision)
     }
 
     this->headingAt = revision;
+    this->setAllItemsChanged();
     this->setDiffOutdated(true);
     return true;
 }
@@ -567,6 +571,7 @@ void Head::deserialize(const XmlElement &xml)
 void Head::reset()
 {
     this->state = new HeadState();
+    this->setAllItemsChanged();
     this->setDiffOutdated(true);
 }
 
@@ -581,6 +586,19 @@ void Head::changeListenerCallback(ChangeBroadcaster *source)
 }
 
 
+void Head::setItemChanged(const Uuid &itemId)
+{
+    const SpinLock::ScopedLockType lock(this->changedItemsLock);
+    this->changedItems.set(itemId.toString(), true);
+}
+
+void Head::setAllItemsChanged()
+{
+    const SpinLock::ScopedLockType lock(this->changedItemsLock);
+    this->allItemsChanged = true;
+}
+
+
 //===----------------------------------------------------------------------===//
 // Thread
 //===----------------------------------------------------------------------===//
@@ -596,6 +614,89 @@ void Head::run()
     this->setRebuildingDiffMode(true);
     this->sendChangeMessage();
 
+    if (this->rebuildDiff(true))
+    {
+        this->setDiffOutdated(false);
+    }
+
+    this->setRebuildingDiffMode(false);
+    this->sendChangeMessage();
+}
+
+void Head::rebuildDiffSynchronously()
+{
+    if (this->targetVcsItemsSource == nullptr)
+    { return; }
+    
+    if (this->state == nullptr)
+    { return; }
+    
+    if (this->isRebuildingDiff())
+    { return; }
+    
+    this->setRebuildingDiffMode(true);
+
+    this->rebuildDiff(false);
+
+    this->setDiffOutdated(false);
+    this->setRebuildingDiffMode(false);
+    this->sendChangeMessage();
+}
+
+class ItemDiffJob final : public ThreadPoolJob
+{
+public:
+
+    ItemDiffJob(const String &itemId, Pack::Ptr pack,
+        TrackedItem *targetItem, RevisionItem::Ptr stateItem) :
+        ThreadPoolJob("Item Diff Job"),
+        itemId(itemId),
+        pack(pack),
+        targetItem(targetItem),
+        stateItem(stateItem) {}
+
+    JobStatus runJob() override
+    {
+        // айтема нет в состоянии - добавляем запись added, с дельтами, которые тупо копируем у targetItem
+        if (this->stateItem == nullptr)
+        {
+            RevisionItem::Ptr revisionRecord(new RevisionItem(this->pack, RevisionItem::Added, this->targetItem));
+            this->diffRecord = var(revisionRecord);
+            return jobHasFinished;
+        }
+
+        // айтем из состояния - существует в проекте. добавляем запись changed, если нужно.
+        ScopedPointer<Diff> itemDiff(this->targetItem->getDiffLogic()->createDiff(*this->stateItem));
+
+        if (itemDiff->hasAnyChanges())
+        {
+            RevisionItem::Ptr revisionRecord(new RevisionItem(this->pack, RevisionItem::Changed, itemDiff));
+            this->diffRecord = var(revisionRecord);
+        }
+
+        return jobHasFinished;
+    }
+
+    const String itemId;
+    Pack::Ptr pack;
+    TrackedItem *targetItem;
+    RevisionItem::Ptr stateItem;
+    var diffRecord;
+
+};
+
+bool Head::rebuildDiff(bool canBeCancelled)
+{
+    HashMap<String, bool> itemsToRebuild;
+    bool shouldRebuildAll = false;
+
+    {
+        const SpinLock::ScopedLockType lock(this->changedItemsLock);
+        itemsToRebuild.swapWith(this->changedItems);
+        shouldRebuildAll = this->allItemsChanged;
+        this->allItemsChanged = false;
+    }
+
     {
         ScopedWriteLock lock(this->diffLock);
         this->diff.removeAllChildren(nullptr);
@@ -604,205 +705,130 @@ void Head::run()
 
     ScopedReadLock threadStateLock(this->stateLock);
 
-    for (int i = 0; i < this->state->getNumTrackedItems(); ++i)
+    // сопоставляем айтемы по uuid через хэш-таблицы вместо вложенных циклов
+    HashMap<String, TrackedItem *> targetItems;
+    HashMap<String, bool> stateItemIds;
+
+    for (int i = 0; i < this->targetVcsItemsSource->getNumTrackedItems(); ++i)
     {
-        if (this->threadShouldExit())
-        {
-            this->setRebuildingDiffMode(false);
-            this->sendChangeMessage();
-            return;
-        }
+        TrackedItem *targetItem = this->targetVcsItemsSource->getTrackedItem(i); // i.e. LayerTreeItem
+        targetItems.set(targetItem->getUuid().toString(), targetItem);
+    }
+
+    // the records keep the same order as before:
+    // state items first, then the items that are missing in the state
+    StringArray orderedIds;
+    HashMap<String, CachedItemDiff> newCache;
+    OwnedArray<ItemDiffJob> jobs;
+
+    auto canReuseCachedDiff = [&](const String &id, const RevisionItem::Ptr stateItem)
+    {
+        return !shouldRebuildAll &&
+            !itemsToRebuild.contains(id) &&
+            this->itemDiffsCache.contains(id) &&
+            this->itemDiffsCache[id].stateItem == stateItem;
+    };
 
-        bool foundItemInTarget = false;
+    for (int i = 0; i < this->state->getNumTrackedItems(); ++i)
+    {
         const RevisionItem::Ptr stateItem = static_cast<RevisionItem *>(this->state->getTrackedItem(i));
 
         // записи удаления рассматриваем позже
         if (stateItem->getType() == RevisionItem::Removed) { continue; }
 
-        for (int j = 0; j < this->targetVcsItemsSource->getNumTrackedItems(); ++j)
+        const String id = stateItem->getUuid().toString();
+        stateItemIds.set(id, true);
+        orderedIds.add(id);
+
+        if (targetItems.contains(id))
         {
-            if (this->threadShouldExit())
+            if (canReuseCachedDiff(id, stateItem))
             {
-                this->setRebuildingDiffMode(false);
-                this->sendChangeMessage();
-                return;
+                newCache.set(id, this->itemDiffsCache[id]);
             }
-
-            TrackedItem *targetItem = this->targetVcsItemsSource->getTrackedItem(j); // i.e. LayerTreeItem
-
-            // айтем из состояния - существует в проекте. добавляем запись changed, если нужно.
-            if (stateItem->getUuid() == targetItem->getUuid())
+            else
             {
-                foundItemInTarget = true;
-
-                ScopedPointer<Diff> itemDiff(targetItem->getDiffLogic()->createDiff(*stateItem));
-
-                if (itemDiff->hasAnyChanges())
-                {
-                    RevisionItem::Ptr revisionRecord(new RevisionItem(this->pack, RevisionItem::Changed, itemDiff));
-                    var revisionVar(revisionRecord);
-
-                    ScopedWriteLock itemDiffLock(this->diffLock);
-                    this->diff.setProperty(stateItem->getUuid().toString(), revisionVar, nullptr);
-                }
-
-                break;
+                jobs.add(new ItemDiffJob(id, this->pack, targetItems[id], stateItem));
             }
         }
-
-        // айтем из состояния - в проекте не найден. добавляем запись removed.
-        if (! foundItemInTarget)
+        else
         {
+            // айтем из состояния - в проекте не найден. добавляем запись removed.
             ScopedPointer<Diff> emptyDiff(new Diff(*stateItem));
-
             RevisionItem::Ptr revisionRecord(new RevisionItem(this->pack, RevisionItem::Removed, emptyDiff));
-            var revisionVar(revisionRecord);
-
-            ScopedWriteLock emptyDiffLock(this->diffLock);
-            this->diff.setProperty(stateItem->getUuid().toString(), revisionVar, nullptr);
+            newCache.set(id, { stateItem, var(revisionRecord) });
         }
     }
 
     // теперь ищем айтемы в проекте, которые отсутствуют - или удалены - в состоянии
     for (int i = 0; i < this->targetVcsItemsSource->getNumTrackedItems(); ++i)
     {
-        if (this->threadShouldExit())
-        {
-            this->setRebuildingDiffMode(false);
-            this->sendChangeMessage();
-            return;
-        }
-
-        bool foundItemInState = false;
         TrackedItem *targetItem = this->targetVcsItemsSource->getTrackedItem(i);
+        const String id = targetItem->getUuid().toString();
 
-        for (int j = 0; j < this->state->getNumTrackedItems(); ++j)
-        {
-            const RevisionItem::Ptr stateItem = static_cast<RevisionItem *>(this->state->getTrackedItem(j));
+        if (stateItemIds.contains(id)) { continue; }
 
-            if (stateItem->getType() == RevisionItem::Removed) { continue; }
+        orderedIds.add(id);
 
-            if (stateItem->getUuid() == targetItem->getUuid())
-            {
-                foundItemInState = true;
-                break;
-            }
+        if (canReuseCachedDiff(id, nullptr))
+        {
+            newCache.set(id, this->itemDiffsCache[id]);
         }
-
-        // и добавляем запись - added, с дельтами, которые тупо копируем у targetItem
-        if (! foundItemInState)
+        else
         {
-            RevisionItem::Ptr revisionRecord(new RevisionItem(this->pack, RevisionItem::Added, targetItem));
-            var revisionVar(revisionRecord);
-
-            ScopedWriteLock lock(this->diffLock);
-            this->diff.setProperty(targetItem->getUuid().toString(), revisionVar, nullptr);
+            jobs.add(new ItemDiffJob(id, this->pack, targetItem, nullptr));
         }
     }
 
-    this->setDiffOutdated(false);
-    this->setRebuildingDiffMode(false);
-    this->sendChangeMessage();
-}
-
-// warning код практически дублирует Head::run
-void Head::rebuildDiffSynchronously()
-{
-    if (this->targetVcsItemsSource == nullptr)
-    { return; }
-    
-    if (this->state == nullptr)
-    { return; }
-    
-    if (this->isRebuildingDiff())
-    { return; }
-    
-    this->setRebuildingDiffMode(true);
-    
-    {
-        ScopedWriteLock lock(this->diffLock);
-        this->diff.removeAllChildren(nullptr);
-        this->diff.removeAllProperties(nullptr);
-    }
-    
-    ScopedReadLock rebuildStateLock(this->stateLock);
-    
-    for (int i = 0; i < this->state->getNumTrackedItems(); ++i)
+    // the heavy part, i.e. serializing tracks and comparing them, goes in parallel
+    if (jobs.size() > 0)
     {
-        bool foundItemInTarget = false;
-        const RevisionItem::Ptr stateItem = static_cast<RevisionItem *>(this->state->getTrackedItem(i));
-        
-        // записи удаления рассматриваем позже
-        if (stateItem->getType() == RevisionItem::Removed) { continue; }
-        
-        for (int j = 0; j < this->targetVcsItemsSource->getNumTrackedItems(); ++j)
+        if (this->diffPool == nullptr)
         {
-            TrackedItem *targetItem = this->targetVcsItemsSource->getTrackedItem(j); // i.e. LayerTreeItem
-            
-            // айтем из состояния - существует в проекте. добавляем запись changed, если нужно.
-            if (stateItem->getUuid() == targetItem->getUuid())
+            this->diffPool = new ThreadPool(jmax(1, SystemStats::getNumCpus() - 1));
+        }
+
+        for (auto job : jobs)
+        {
+            this->diffPool->addJob(job, false);
+        }
+
+        for (auto job : jobs)
+        {
+            while (! this->diffPool->waitForJobToFinish(job, 50))
             {
-                foundItemInTarget = true;
-                
-                ScopedPointer<Diff> itemDiff(targetItem->getDiffLogic()->createDiff(*stateItem));
-                
-                if (itemDiff->hasAnyChanges())
+                if (canBeCancelled && this->threadShouldExit())
                 {
-                    RevisionItem::Ptr revisionRecord(new RevisionItem(this->pack, RevisionItem::Changed, itemDiff));
-                    var revisionVar(revisionRecord);
-                    
-                    ScopedWriteLock lock(this->diffLock);
-                    this->diff.setProperty(stateItem->getUuid().toString(), revisionVar, nullptr);
+                    // the jobs are owned here, so make sure none of them is still running
+                    this->diffPool->removeAllJobs(true, 0);
+                    for (auto runningJob : jobs)
+                    {
+                        this->diffPool->waitForJobToFinish(runningJob, -1);
+                    }
+
+                    this->setAllItemsChanged();
+                    return false;
                 }
-                
-                break;
             }
-        }
-        
-        // айтем из состояния - в проекте не найден. добавляем запись removed.
-        if (! foundItemInTarget)
-        {
-            ScopedPointer<Diff> emptyDiff(new Diff(*stateItem));
-            
-            RevisionItem::Ptr revisionRecord(new RevisionItem(this->pack, RevisionItem::Removed, emptyDiff));
-            var revisionVar(revisionRecord);
-            
-            ScopedWriteLock lock(this->diffLock);
-            this->diff.setProperty(stateItem->getUuid().toString(), revisionVar, nullptr);
+
+            newCache.set(job->itemId, { job->stateItem, job->diffRecord });
         }
     }
-    
-    // теперь ищем айтемы в проекте, которые отсутствуют - или удалены - в состоянии
-    for (int i = 0; i < this->targetVcsItemsSource->getNumTrackedItems(); ++i)
+
     {
-        bool foundItemInState = false;
-        TrackedItem *targetItem = this->targetVcsItemsSource->getTrackedItem(i);
-        
-        for (int j = 0; j < this->state->getNumTrackedItems(); ++j)
+        ScopedWriteLock lock(this->diffLock);
+
+        for (const auto &id : orderedIds)
         {
-            const RevisionItem::Ptr stateItem = static_cast<RevisionItem *>(this->state->getTrackedItem(j));
-            
-            if (stateItem->getType() == RevisionItem::Removed) { continue; }
-            
-            if (stateItem->getUuid() == targetItem->getUuid())
+            const var diffRecord(newCache[id].diffRecord);
+
+            if (! diffRecord.isVoid())
             {
-                foundItemInState = true;
-                break;
+                this->diff.setProperty(id, diffRecord, nullptr);
             }
         }
-        
-        // и добавляем запись - added, с дельтами, которые тупо копируем у targetItem
-        if (! foundItemInState)
-        {
-            RevisionItem::Ptr revisionRecord(new RevisionItem(this->pack, RevisionItem::Added, targetItem));
-            var revisionVar(revisionRecord);
-            
-            ScopedWriteLock lock(this->diffLock);
-            this->diff.setProperty(targetItem->getUuid().toString(), revisionVar, nullptr);
-        }
     }
-    
-    this->setDiffOutdated(false);
-    this->setRebuildingDiffMode(false);
-    this->sendChangeMessage();
+
+    this->itemDiffsCache.swapWith(newCache);
+    return true;
 }
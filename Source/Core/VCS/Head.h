@@ -76,6 +76,11 @@ namespace VCS
         void rebuildDiffNow(); // это вызывается в редакторе, когда он видим и слышит изменения vcs
 
         void rebuildDiffSynchronously(); // грязный хак для quick-stash
+
+        // VersionControl marks tracked items as changed on project events,
+        // so that the next rebuild only re-diffs the items that have actually changed
+        void setItemChanged(const Uuid &itemId);
+        void setAllItemsChanged();
         
         
         //===------------------------------------------------------------------===//
@@ -105,6 +110,8 @@ namespace VCS
 
         void checkoutItem(VCS::RevisionItem::Ptr stateItem);
 
+        bool rebuildDiff(bool canBeCancelled);
+
         ReadWriteLock outdatedMarkerLock;
         bool diffOutdated;
 
@@ -122,6 +129,24 @@ namespace VCS
 
         ScopedPointer<HeadState> state;
 
+    private:
+
+        struct CachedItemDiff
+        {
+            RevisionItem::Ptr stateItem; // null for the items not yet in the state
+            var diffRecord; // void, if the item has no changes
+        };
+
+        // the latest diff per tracked item uuid,
+        // only accessed by the thread that rebuilds the diff
+        HashMap<String, CachedItemDiff> itemDiffsCache;
+
+        SpinLock changedItemsLock;
+        HashMap<String, bool> changedItems;
+        bool allItemsChanged;
+
+        ScopedPointer<ThreadPool> diffPool;
+
     private:
 
         WeakReference<TrackedItemsSource> targetVcsItemsSource; // ProjectTreeItem
@@ -35,13 +35,19 @@ using namespace VCS;
 // при добавлении данных - добавляем в память (+ метод flush(), который скидывает все на диск)
 // при сохранении\сериализации - сохраняем еще несохраненное и записываем данные файла
 //
-// минусы: надо следить, чтоб файл не исчез (блокируем его открытыми потоками на чтение и запись)
+// минусы: надо следить, чтоб файл не исчез (его держит открытым memory mapping)
 // файл будет во временном каталоге
 //
 // в памяти держим только хэдер, где записано: пара id и смещения в файле.
+// данные адресуются по sha-256 содержимого, одинаковые дельты хранятся один раз.
+//
+// файл только дописывается, каждый flush() добавляет в конец только новые блоки данных,
+// индекс живет в памяти (файл временный и пересоздается при каждой загрузке проекта)
 //
 
-Pack::Pack()
+Pack::Pack() :
+    committedSize(0),
+    decodedCacheCounter(0)
 {
     // todo иногда пишет в корень диска c: ? wtf
 
@@ -51,8 +57,7 @@ Pack::Pack()
 
 Pack::~Pack()
 {
-    this->packStream = nullptr;
-    this->packWriteLocker = nullptr;
+    this->packMap = nullptr;
     this->packFile->deleteFile();
 }
 
@@ -64,56 +69,41 @@ Pack::~Pack()
 bool Pack::containsDeltaDataFor(const Uuid &itemId,
                                 const Uuid &deltaId) const
 {
-    if (this->packStream != nullptr)
-    {
-        // данные могут быть на диске
-        for (auto header : this->headers)
-        {
-            if (header->itemId == itemId && header->deltaId == deltaId)
-            {
-                return true;
-            }
-        }
-        
-        // а могут быть и в памяти
-        for (auto block : this->unsavedData)
-        {
-            if (block->itemId == itemId && block->deltaId == deltaId)
-            {
-                return true;
-            }
-        }
-    }
-    
-    return false;
+    const ScopedReadLock lock(this->packLock);
+    const PackDataKey key(itemId, deltaId);
+
+    // данные могут быть на диске, а могут быть и в памяти
+    return this->headersIndex.contains(key) ||
+        this->unsavedDataIndex.contains(key);
 }
 
 XmlElement *Pack::createDeltaDataFor(const Uuid &itemId,
                                      const Uuid &deltaId) const
 {
-    ScopedLock lock(this->packLocker);
-    
-    if (this->packStream != nullptr)
+    const ScopedReadLock lock(this->packLock);
+    const PackDataKey key(itemId, deltaId);
+
+    // данные могут быть на диске
+    if (const PackDataHeader *header = this->headersIndex[key])
     {
-        // данные могут быть на диске
-        for (auto header : this->headers)
+        if (XmlElement *cached = this->findCachedDeltaData(header->contentHash))
         {
-            if (header->itemId == itemId && header->deltaId == deltaId)
-            {
-                return this->createXmlData(header);
-            }
+            return cached;
         }
 
-        // а могут быть и в памяти
-        for (auto block : this->unsavedData)
+        if (XmlElement *xml = this->createXmlData(header))
         {
-            if (block->itemId == itemId && block->deltaId == deltaId)
-            {
-                return XmlDocument::parse(block->data.toString());
-            }
+            this->cacheDeltaData(header->contentHash, *xml);
+            return xml;
         }
     }
 
+    // а могут быть и в памяти
+    if (const PackDataBlock *block = this->unsavedDataIndex[key])
+    {
+        return this->createXmlData(block);
+    }
+
     jassertfalse;
     return nullptr;
 }
@@ -122,7 +112,7 @@ void Pack::setDeltaDataFor(const Uuid &itemId,
                            const Uuid &deltaId,
                            const XmlElement &data)
 {
-    ScopedLock lock(this->packLocker);
+    const ScopedWriteLock lock(this->packLock);
 
     auto block = new PackDataBlock();
     block->itemId = itemId;
@@ -133,7 +123,8 @@ void Pack::setDeltaDataFor(const Uuid &itemId,
     data.writeToStream(ms, "", true, false);
     ms.flush();
 
-    this->unsavedData.add(block);
+    block->contentHash = calculateContentHash(block->data);
+    this->addBlock(block);
 }
 
 
@@ -143,37 +134,47 @@ void Pack::setDeltaDataFor(const Uuid &itemId,
 
 XmlElement *Pack::serialize() const
 {
-    ScopedLock lock(this->packLocker);
+    const ScopedReadLock lock(this->packLock);
 
     auto xml = new XmlElement(Serialization::VCS::pack);
 
+    // every blob is written only once, other records with
+    // the same content just refer to it by hash
+    HashMap<String, bool> serializedContent;
+
     // скидываем временный файл
-    if (this->packStream != nullptr)
+    for (auto header : this->headers)
     {
-        for (auto header : this->headers)
-        {
-            XmlElement *deltaData = this->createXmlData(header);
-
-            auto packItem = new XmlElement(Serialization::VCS::packItem);
-            packItem->setAttribute(Serialization::VCS::packItemRevId, header->itemId.toString());
-            packItem->setAttribute(Serialization::VCS::packItemDeltaId, header->deltaId.toString());
-            packItem->addChildElement(deltaData);
+        auto packItem = new XmlElement(Serialization::VCS::packItem);
+        packItem->setAttribute(Serialization::VCS::packItemRevId, header->itemId.toString());
+        packItem->setAttribute(Serialization::VCS::packItemDeltaId, header->deltaId.toString());
+        packItem->setAttribute(Serialization::VCS::packItemContentHash, header->contentHash);
 
-            xml->prependChildElement(packItem);
+        if (!serializedContent.contains(header->contentHash))
+        {
+            serializedContent.set(header->contentHash, true);
+            packItem->addChildElement(this->createXmlData(header));
         }
+
+        // the order matters: the record with the data goes before the ones referring to it
+        xml->addChildElement(packItem);
     }
 
     // и все новые данные
     for (auto block : this->unsavedData)
     {
-        XmlElement *deltaData = XmlDocument::parse(block->data.toString());
-
         auto packItem = new XmlElement(Serialization::VCS::packItem);
         packItem->setAttribute(Serialization::VCS::packItemRevId, block->itemId.toString());
         packItem->setAttribute(Serialization::VCS::packItemDeltaId, block->deltaId.toString());
-        packItem->addChildElement(deltaData);
+        packItem->setAttribute(Serialization::VCS::packItemContentHash, block->contentHash);
 
-        xml->prependChildElement(packItem);
+        if (!serializedContent.contains(block->contentHash))
+        {
+            serializedContent.set(block->contentHash, true);
+            packItem->addChildElement(this->createXmlData(block));
+        }
+
+        xml->addChildElement(packItem);
     }
 
     return xml;
@@ -181,7 +182,7 @@ XmlElement *Pack::serialize() const
 
 void Pack::deserialize(const XmlElement &xml)
 {
-    ScopedLock lock(this->packLocker);
+    const ScopedWriteLock lock(this->packLock);
 
     this->reset();
 
@@ -190,23 +191,55 @@ void Pack::deserialize(const XmlElement &xml)
 
     if (root == nullptr) { return; }
 
+    // The records with data are indexed first, whatever order they come in
+    // (older versions wrote the references before the data), then the references
+    Array<const XmlElement *> references;
+    HashMap<String, String> storedHashes;
+
     forEachXmlChildElementWithTagName(*root, e, Serialization::VCS::packItem)
     {
+        const XmlElement *firstChild = e->getFirstChildElement();
+
+        if (firstChild == nullptr)
+        {
+            references.add(e);
+            continue;
+        }
+
         // грузим все в память
         auto block = new PackDataBlock();
         block->itemId = e->getStringAttribute(Serialization::VCS::packItemRevId);
         block->deltaId = e->getStringAttribute(Serialization::VCS::packItemDeltaId);
 
         MemoryOutputStream ms(block->data, false);
+        firstChild->writeToStream(ms, "", true, false);
+        ms.flush();
 
-        if (XmlElement *firstChild = e->getFirstChildElement())
+        // the stored hash is not trusted, older projects have none at all;
+        // the references still use the stored one, so keep track of what it really is
+        block->contentHash = calculateContentHash(block->data);
+        const String storedHash = e->getStringAttribute(Serialization::VCS::packItemContentHash);
+        if (storedHash.isNotEmpty() && ! storedHashes.contains(storedHash))
         {
-            firstChild->writeToStream(ms, "", true, false);
+            storedHashes.set(storedHash, block->contentHash);
         }
 
-        ms.flush();
+        this->addBlock(block);
+    }
 
-        this->unsavedData.add(block);
+    for (const auto e : references)
+    {
+        auto block = new PackDataBlock();
+        block->itemId = e->getStringAttribute(Serialization::VCS::packItemRevId);
+        block->deltaId = e->getStringAttribute(Serialization::VCS::packItemDeltaId);
+
+        const String storedHash = e->getStringAttribute(Serialization::VCS::packItemContentHash);
+
+        // a reference to nothing is just an empty item, as in the legacy packs
+        block->contentHash = storedHashes.contains(storedHash) ?
+            storedHashes[storedHash] : calculateContentHash(block->data);
+
+        this->addBlock(block);
     }
 
     // и сливаем на диск
@@ -215,13 +248,20 @@ void Pack::deserialize(const XmlElement &xml)
 
 void Pack::reset()
 {
-    ScopedLock lock(this->packStreamLock);
+    const ScopedWriteLock lock(this->packLock);
 
     this->headers.clear();
+    this->headersIndex.clear();
+    this->storedContentIndex.clear();
     this->unsavedData.clear();
-    this->packStream = nullptr;
-    this->packWriteLocker = nullptr;
+    this->unsavedDataIndex.clear();
+    this->unsavedContentIndex.clear();
+    this->packMap = nullptr;
     this->packFile->deleteFile();
+    this->committedSize = 0;
+
+    const SpinLock::ScopedLockType cacheLock(this->decodedCacheLock);
+    this->decodedCache.clear();
 }
 
 
@@ -231,80 +271,271 @@ void Pack::reset()
 
 void Pack::flush()
 {
-    ScopedLock lock(this->packStreamLock);
+    const ScopedWriteLock lock(this->packLock);
 
-    TemporaryFile tempFile(*this->packFile);
-    ScopedPointer<FileOutputStream> tempOutputStream(tempFile.getFile().createOutputStream());
+    if (this->unsavedData.size() == 0)
+    {
+        return;
+    }
 
-    jassert(tempOutputStream->openedOk());
+    // The file is append-only: each flush writes new blocks after
+    // the last successfully flushed ones, so that the commit cost only depends on the new data.
+    // There's no on-disk index: the file is a temporary one, rebuilt from the project
+    // on every load, so the headers in memory are the only index it ever needs.
+    // The mapping is closed for the time of writing, since on some platforms
+    // the mapped file cannot be opened for write access.
 
-    this->packWriteLocker = nullptr;
+    this->packMap = nullptr;
 
-    // если нужно - скопируем существующий файл,
-    // и сразу закроем входной поток
-    if (this->packStream != nullptr)
+    ScopedPointer<FileOutputStream> out(this->packFile->createOutputStream());
+
+    if (out == nullptr || out->failedToOpen())
+    {
+        jassertfalse;
+        this->remapPackFile();
+        return;
+    }
+
+    // anything after the last successful flush is garbage from a failed one
+    if (out->getPosition() != this->committedSize)
     {
-        this->packStream->setPosition(0);
-        tempOutputStream->writeFromInputStream(*this->packStream, -1);
-        this->packStream = nullptr;
+        out->setPosition(this->committedSize);
+        out->truncate();
     }
 
     // добавляем unsavedData
     // достаточно обфусцировать их, дописать в конец файла
-    // и добавить в свой список PackDataHeader'ы с получившимися смещениями
+    // и добавить в свой список PackDataHeader'ы с получившимися смещениями;
+    // блоки с уже известным содержимым ссылаются на существующие данные
+    OwnedArray<PackDataHeader> newHeaders;
+    HashMap<String, PackDataHeader *> newContentIndex;
+
     for (auto block : this->unsavedData)
     {
-        
+        if (block->isReference)
+        {
+            continue;
+        }
+
 #if VCS_PACK_DEBUGGING
         const String &obfuscated = block->data.toString();
 #else
         const String &obfuscated = DataEncoder::obfuscateString(block->data.toString());
 #endif
 
-        const int64 position = tempOutputStream->getPosition();
+        const int64 position = out->getPosition();
         const ssize_t numBytes = obfuscated.getNumBytesAsUTF8();
 
-        tempOutputStream->write(obfuscated.toRawUTF8(), numBytes);
+        out->write(obfuscated.toRawUTF8(), numBytes);
 
         auto newHeader = new PackDataHeader();
         newHeader->itemId = block->itemId;
         newHeader->deltaId = block->deltaId;
+        newHeader->contentHash = block->contentHash;
         newHeader->startPosition = position;
         newHeader->numBytes = numBytes;
 
-        this->headers.add(newHeader);
+        newHeaders.add(newHeader);
+        newContentIndex.set(block->contentHash, newHeader);
     }
 
-    this->unsavedData.clear();
+    for (auto block : this->unsavedData)
+    {
+        if (!block->isReference)
+        {
+            continue;
+        }
 
-    tempOutputStream = nullptr;
+        const PackDataHeader *content = newContentIndex.contains(block->contentHash) ?
+            newContentIndex[block->contentHash] : this->storedContentIndex[block->contentHash];
 
-    if (tempFile.overwriteTargetFileWithTemporary())
+        if (content == nullptr)
+        {
+            jassertfalse; // a reference to the content that never was added
+            continue;
+        }
+
+        auto newHeader = new PackDataHeader(*content);
+        newHeader->itemId = block->itemId;
+        newHeader->deltaId = block->deltaId;
+        newHeaders.add(newHeader);
+    }
+
+    // FileOutputStream::flush syncs the file, so it is safe
+    // to consider the new data committed only after that
+    out->flush();
+
+    const bool writtenOk = out->getStatus().wasOk();
+    const int64 newCommittedSize = out->getPosition();
+    out = nullptr;
+
+    if (writtenOk)
     {
-        this->packStream = this->packFile->createInputStream();
-        jassert(this->packStream->openedOk());
+        this->committedSize = newCommittedSize;
 
-        this->packWriteLocker = this->packFile->createOutputStream();
-        jassert(this->packWriteLocker->openedOk());
+        for (auto header : newHeaders)
+        {
+            this->headers.add(header);
+            this->headersIndex.set({ header->itemId, header->deltaId }, header);
+
+            if (!this->storedContentIndex.contains(header->contentHash))
+            {
+                this->storedContentIndex.set(header->contentHash, header);
+            }
+        }
+
+        newHeaders.clear(false);
+
+        this->unsavedData.clear();
+        this->unsavedDataIndex.clear();
+        this->unsavedContentIndex.clear();
     }
     else
     {
+        // keep the data in memory, the next flush will overwrite the tail
         jassertfalse;
     }
+
+    this->remapPackFile();
+}
+
+void Pack::addBlock(PackDataBlock *block)
+{
+    jassert(block->contentHash.isNotEmpty());
+
+    // Even an empty blob (legacy pack items may have no data at all)
+    // is stored on its own, only the duplicates become references
+    const bool alreadyStored =
+        this->storedContentIndex.contains(block->contentHash) ||
+        this->unsavedContentIndex.contains(block->contentHash);
+
+    if (alreadyStored)
+    {
+        block->data.reset();
+        block->isReference = true;
+    }
+    else
+    {
+        this->unsavedContentIndex.set(block->contentHash, block);
+    }
+
+    this->unsavedData.add(block);
+    this->unsavedDataIndex.set({ block->itemId, block->deltaId }, block);
+}
+
+void Pack::remapPackFile()
+{
+    this->packMap = nullptr;
+
+    if (this->committedSize > 0)
+    {
+        const Range<int64> committedRange(0, this->committedSize);
+        this->packMap = new MemoryMappedFile(*this->packFile, committedRange, MemoryMappedFile::readOnly);
+        jassert(this->packMap->getData() != nullptr);
+    }
 }
 
 XmlElement *Pack::createXmlData(const PackDataHeader *header) const
 {
-    ScopedLock lock(this->packStreamLock);
-    MemoryBlock mb;
-    this->packStream->setPosition(header->startPosition);
-    this->packStream->readIntoMemoryBlock(mb, header->numBytes);
+    if (header->numBytes == 0)
+    {
+        return nullptr;
+    }
+
+    if (this->packMap == nullptr ||
+        this->packMap->getData() == nullptr ||
+        header->startPosition + header->numBytes > int64(this->packMap->getSize()))
+    {
+        jassertfalse;
+        return nullptr;
+    }
+
+    const char *data = static_cast<const char *>(this->packMap->getData()) + header->startPosition;
 
 #if VCS_PACK_DEBUGGING
-    const String &xmlData = mb.toString();
+    const String &xmlData = String::fromUTF8(data, int(header->numBytes));
 #else
-    const String &xmlData = DataEncoder::deobfuscateString(mb.toString());
+    const String &xmlData = DataEncoder::deobfuscateString(String::fromUTF8(data, int(header->numBytes)));
 #endif
 
     return XmlDocument::parse(xmlData);
 }
+
+XmlElement *Pack::createXmlData(const PackDataBlock *block) const
+{
+    if (!block->isReference)
+    {
+        return XmlDocument::parse(block->data.toString());
+    }
+
+    if (const PackDataBlock *content = this->unsavedContentIndex[block->contentHash])
+    {
+        return XmlDocument::parse(content->data.toString());
+    }
+
+    if (const PackDataHeader *content = this->storedContentIndex[block->contentHash])
+    {
+        return this->createXmlData(content);
+    }
+
+    jassertfalse;
+    return nullptr;
+}
+
+String Pack::calculateContentHash(const MemoryBlock &data)
+{
+    return SHA256(data).toHexString();
+}
+
+
+//===----------------------------------------------------------------------===//
+// Decoded deltas cache
+//===----------------------------------------------------------------------===//
+
+static const int kDecodedCacheSize = 64;
+
+XmlElement *Pack::findCachedDeltaData(const String &contentHash) const
+{
+    const SpinLock::ScopedLockType lock(this->decodedCacheLock);
+
+    for (auto entry : this->decodedCache)
+    {
+        if (entry->contentHash == contentHash)
+        {
+            entry->lastAccess = ++this->decodedCacheCounter;
+            return new XmlElement(*entry->data);
+        }
+    }
+
+    return nullptr;
+}
+
+void Pack::cacheDeltaData(const String &contentHash, const XmlElement &data) const
+{
+    // copy outside the lock, the cached data is never mutated after that
+    ScopedPointer<XmlElement> copy(new XmlElement(data));
+
+    const SpinLock::ScopedLockType lock(this->decodedCacheLock);
+
+    CachedDeltaData *target = nullptr;
+
+    if (this->decodedCache.size() < kDecodedCacheSize)
+    {
+        target = this->decodedCache.add(new CachedDeltaData());
+    }
+    else
+    {
+        target = this->decodedCache.getFirst();
+        for (auto entry : this->decodedCache)
+        {
+            if (entry->lastAccess < target->lastAccess)
+            {
+                target = entry;
+            }
+        }
+    }
+
+    target->contentHash = contentHash;
+    target->data = copy.release();
+    target->lastAccess = ++this->decodedCacheCounter;
+}
@@ -21,10 +21,15 @@
 
 namespace VCS
 {
+    // Pack entries are content-addressed: several (itemId, deltaId) pairs
+    // with identical serialized data share a single blob on disk,
+    // identified by the SHA-256 of that data.
+
     struct PackDataHeader
     {
         Uuid itemId;
         Uuid deltaId;
+        String contentHash;
         int64 startPosition;
         ssize_t numBytes;
     };
@@ -33,7 +38,41 @@ namespace VCS
     {
         Uuid itemId;
         Uuid deltaId;
+        String contentHash;
         MemoryBlock data;
+
+        // true, if the content is already stored elsewhere and data is empty;
+        // the data itself may be legitimately empty for legacy items
+        bool isReference = false;
+    };
+
+    struct PackDataKey
+    {
+        PackDataKey() {}
+        PackDataKey(const Uuid &item, const Uuid &delta) :
+            itemId(item), deltaId(delta) {}
+
+        bool operator== (const PackDataKey &other) const noexcept
+        { return this->deltaId == other.deltaId && this->itemId == other.itemId; }
+
+        bool operator!= (const PackDataKey &other) const noexcept
+        { return !(*this == other); }
+
+        Uuid itemId;
+        Uuid deltaId;
+    };
+
+    class PackDataKeyHashFunction
+    {
+    public:
+
+        // uuids are random enough, so a couple of raw words make a good hash
+        static int generateHash(const PackDataKey &key, const int upperLimit) noexcept
+        {
+            const uint32 itemWord = ByteOrder::littleEndianInt(key.itemId.getRawData());
+            const uint32 deltaWord = ByteOrder::littleEndianInt(key.deltaId.getRawData() + 4);
+            return static_cast<int>((itemWord ^ (deltaWord * 31)) % static_cast<uint32>(upperLimit));
+        }
     };
 
     class Pack :
@@ -82,23 +121,49 @@ namespace VCS
 
         XmlElement *createXmlData(const PackDataHeader *header) const;
 
-    private:
+        XmlElement *createXmlData(const PackDataBlock *block) const;
+
+        XmlElement *findCachedDeltaData(const String &contentHash) const;
+        void cacheDeltaData(const String &contentHash, const XmlElement &data) const;
+
+        void addBlock(PackDataBlock *block);
+        void remapPackFile();
 
-        // todo locks?
+        static String calculateContentHash(const MemoryBlock &data);
+
+    private:
 
         OwnedArray<PackDataHeader> headers;
+        HashMap<PackDataKey, PackDataHeader *, PackDataKeyHashFunction> headersIndex;
+        HashMap<String, PackDataHeader *> storedContentIndex;
 
         OwnedArray<PackDataBlock> unsavedData;
+        HashMap<PackDataKey, PackDataBlock *, PackDataKeyHashFunction> unsavedDataIndex;
+        HashMap<String, PackDataBlock *> unsavedContentIndex;
 
         ScopedPointer<File> packFile;
 
-        CriticalSection packStreamLock;
+        // Readers only ever touch the mapped memory and the indices,
+        // so they can go concurrently; flush/reset/set take the write lock
+        ReadWriteLock packLock;
 
-        ScopedPointer<FileInputStream> packStream;
+        ScopedPointer<MemoryMappedFile> packMap;
 
-        ScopedPointer<FileOutputStream> packWriteLocker;
-        
-        CriticalSection packLocker;
+        // The size of the file up to the end of the last successful flush
+        int64 committedSize;
+
+        struct CachedDeltaData
+        {
+            String contentHash;
+            ScopedPointer<XmlElement> data;
+            uint32 lastAccess;
+        };
+
+        // A tiny LRU of decoded deltas, history browsing tends to
+        // hit the same few revisions over and over again
+        mutable OwnedArray<CachedDeltaData> decodedCache;
+        mutable uint32 decodedCacheCounter;
+        SpinLock decodedCacheLock;
 
         Uuid uuid;
 
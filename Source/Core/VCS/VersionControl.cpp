@@ -22,6 +22,11 @@
 #include "VersionControlEditorDefault.h"
 #include "TrackedItem.h"
 #include "MidiSequence.h"
+#include "MidiTrack.h"
+#include "MidiEvent.h"
+#include "Pattern.h"
+#include "Clip.h"
+#include "ProjectInfo.h"
 #include "SerializationKeys.h"
 #include "Client.h"
 #include "Supervisor.h"
@@ -558,6 +563,108 @@ void VersionControl::changeListenerCallback(ChangeBroadcaster* source)
 }
 
 
+//===----------------------------------------------------------------------===//
+// ProjectListener
+//===----------------------------------------------------------------------===//
+
+// Only used to tell the head which tracked items have changed,
+// the outdated flag itself is still set in changeListenerCallback
+
+void VersionControl::onAddMidiEvent(const MidiEvent &event)
+{
+    this->markTrackChanged(event.getSequence()->getTrack());
+}
+
+void VersionControl::onChangeMidiEvent(const MidiEvent &oldEvent, const MidiEvent &newEvent)
+{
+    this->markTrackChanged(newEvent.getSequence()->getTrack());
+}
+
+void VersionControl::onRemoveMidiEvent(const MidiEvent &event)
+{
+    this->markTrackChanged(event.getSequence()->getTrack());
+}
+
+void VersionControl::onAddMidiEvents(const Array<const MidiEvent *> &events)
+{
+    if (events.size() > 0)
+    {
+        this->markTrackChanged(events.getFirst()->getSequence()->getTrack());
+    }
+}
+
+void VersionControl::onChangeMidiEvents(const Array<const MidiEvent *> &oldEvents,
+                                        const Array<const MidiEvent *> &newEvents)
+{
+    if (newEvents.size() > 0)
+    {
+        this->markTrackChanged(newEvents.getFirst()->getSequence()->getTrack());
+    }
+}
+
+void VersionControl::onRemoveMidiEvents(const Array<const MidiEvent *> &events)
+{
+    if (events.size() > 0)
+    {
+        this->markTrackChanged(events.getFirst()->getSequence()->getTrack());
+    }
+}
+
+void VersionControl::onAddClip(const Clip &clip)
+{
+    this->markTrackChanged(clip.getPattern()->getTrack());
+}
+
+void VersionControl::onChangeClip(const Clip &oldClip, const Clip &newClip)
+{
+    this->markTrackChanged(newClip.getPattern()->getTrack());
+}
+
+void VersionControl::onRemoveClip(const Clip &clip)
+{
+    this->markTrackChanged(clip.getPattern()->getTrack());
+}
+
+void VersionControl::onAddTrack(MidiTrack *const track)
+{
+    this->markTrackChanged(track);
+}
+
+void VersionControl::onRemoveTrack(MidiTrack *const track)
+{
+    this->markTrackChanged(track);
+}
+
+void VersionControl::onChangeTrackProperties(MidiTrack *const track)
+{
+    this->markTrackChanged(track);
+}
+
+void VersionControl::onResetTrackContent(MidiTrack *const track)
+{
+    this->markTrackChanged(track);
+}
+
+void VersionControl::onChangeProjectInfo(const ProjectInfo *info)
+{
+    this->getHead().setItemChanged(info->getUuid());
+}
+
+void VersionControl::markTrackChanged(MidiTrack *const track)
+{
+    // some tracks, like the timeline's annotations, are not tracked items themselves,
+    // in that case just don't rely on the cached diffs at all
+    if (auto *trackedItem = dynamic_cast<VCS::TrackedItem *>(track))
+    {
+        this->getHead().setItemChanged(trackedItem->getUuid());
+    }
+    else
+    {
+        this->getHead().setAllItemsChanged();
+    }
+}
+
+
 //===----------------------------------------------------------------------===//
 // Private
 //===----------------------------------------------------------------------===//
@@ -38,6 +38,7 @@ class VersionControlEditor;
 
 class VersionControl :
     public Serializable,
+    public ProjectListener,
     public ChangeListener,
     public ChangeBroadcaster
 {
@@ -135,9 +136,38 @@ public:
     //===------------------------------------------------------------------===//
 
     void changeListenerCallback(ChangeBroadcaster* source) override;
-    
+
+
+    //===------------------------------------------------------------------===//
+    // ProjectListener
+    //===------------------------------------------------------------------===//
+
+    void onAddMidiEvent(const MidiEvent &event) override;
+    void onChangeMidiEvent(const MidiEvent &oldEvent, const MidiEvent &newEvent) override;
+    void onRemoveMidiEvent(const MidiEvent &event) override;
+
+    void onAddMidiEvents(const Array<const MidiEvent *> &events) override;
+    void onChangeMidiEvents(const Array<const MidiEvent *> &oldEvents,
+                            const Array<const MidiEvent *> &newEvents) override;
+    void onRemoveMidiEvents(const Array<const MidiEvent *> &events) override;
+
+    void onAddClip(const Clip &clip) override;
+    void onChangeClip(const Clip &oldClip, const Clip &newClip) override;
+    void onRemoveClip(const Clip &clip) override;
+
+    void onAddTrack(MidiTrack *const track) override;
+    void onRemoveTrack(MidiTrack *const track) override;
+    void onChangeTrackProperties(MidiTrack *const track) override;
+    void onResetTrackContent(MidiTrack *const track) override;
+
+    void onChangeProjectInfo(const ProjectInfo *info) override;
+    void onChangeProjectBeatRange(float firstBeat, float lastBeat) override {}
+    void onChangeViewBeatRange(float firstBeat, float lastBeat) override {}
+
 protected:
 
+    void markTrackChanged(MidiTrack *const track);
+
     StringArray recursiveGetHashes(const VCS::Revision revision) const;
 
     void recursiveTreeMerge(VCS::Revision localRevision, VCS::Revision remoteRevision);
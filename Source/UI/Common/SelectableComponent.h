@@ -27,4 +27,7 @@ public:
 
     virtual String getSelectionGroupId() const = 0;
 
+    // Identifies the model item this component shows, unique within its group
+    virtual String getSelectionId() const = 0;
+
 };
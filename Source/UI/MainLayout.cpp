@@ -21,6 +21,7 @@
 #include "Headline.h"
 #include "HelioTheme.h"
 #include "App.h"
+#include "HelioProfiler.h"
 #include "Workspace.h"
 #include "AudioCore.h"
 #include "Config.h"
@@ -108,6 +109,100 @@ namespace KeyboardFocusDebugger
     }
 }
 
+// Shows the frame times, the number of components and the most expensive
+// instrumented sites, refreshed twice a second (see HelioProfiler)
+class ProfilerOverlay final : public Component, private Timer
+{
+public:
+
+    explicit ProfilerOverlay(Component &root) : root(root)
+    {
+        this->setInterceptsMouseClicks(false, false);
+        this->setAlwaysOnTop(true);
+        this->setSize(360, 20 + (maxSitesToShow + maxCountersToShow + 2) * lineHeight);
+        this->startTimerHz(2);
+    }
+
+    void paint(Graphics &g) override
+    {
+        g.fillAll(Colours::black.withAlpha(0.75f));
+        g.setColour(Colours::white);
+        g.setFont(Font(Font::getDefaultMonospacedFontName(), 12.f, Font::plain));
+
+        Rectangle<int> r(this->getLocalBounds().reduced(10));
+        for (const auto &line : this->lines)
+        {
+            g.drawText(line, r.removeFromTop(lineHeight), Justification::centredLeft, false);
+        }
+    }
+
+private:
+
+    void timerCallback() override
+    {
+        const auto frames = HelioProfiler::takeFrameStats();
+        const auto sites = HelioProfiler::takeSiteStats();
+
+        int numComponents = 0;
+        int numVisibleComponents = 0;
+        countComponents(&this->root, numComponents, numVisibleComponents);
+
+        this->lines.clearQuick();
+        this->lines.add("Frame: " + String(frames.lastMs, 1) +
+            " ms, avg " + String(frames.averageMs, 1) +
+            " ms, max " + String(frames.maxMs, 1) +
+            " ms, " + String(frames.numFrames) + " frames");
+
+        this->lines.add("Components: " + String(numComponents) +
+            ", " + String(numVisibleComponents) + " visible");
+
+        int numSitesShown = 0;
+        for (const auto &site : sites)
+        {
+            if (!site.isCounter && numSitesShown < maxSitesToShow)
+            {
+                numSitesShown++;
+                this->lines.add(String(site.name).paddedRight(' ', 28) +
+                    String(site.numCalls).paddedLeft(' ', 5) + "x " +
+                    String(site.totalMs, 1).paddedLeft(' ', 7) + " ms, max " +
+                    String(site.maxMs, 1) + " ms");
+            }
+        }
+
+        int numCountersShown = 0;
+        for (const auto &site : sites)
+        {
+            if (site.isCounter && numCountersShown < maxCountersToShow)
+            {
+                numCountersShown++;
+                this->lines.add(String(site.name).paddedRight(' ', 28) +
+                    String(site.numCalls).paddedLeft(' ', 5));
+            }
+        }
+
+        this->repaint();
+    }
+
+    static void countComponents(Component *component, int &numComponents, int &numVisibleComponents)
+    {
+        for (int i = 0; i < component->getNumChildComponents(); ++i)
+        {
+            Component *child = component->getChildComponent(i);
+            numComponents++;
+            numVisibleComponents += child->isShowing() ? 1 : 0;
+            countComponents(child, numComponents, numVisibleComponents);
+        }
+    }
+
+    static const int maxSitesToShow = 10;
+    static const int maxCountersToShow = 4;
+    static const int lineHeight = 16;
+
+    Component &root;
+    StringArray lines;
+
+    JUCE_DECLARE_NON_COPYABLE(ProfilerOverlay)
+};
 
 MainLayout::MainLayout() :
     currentContent(nullptr)
@@ -138,6 +233,12 @@ MainLayout::MainLayout() :
     this->setWantsKeyboardFocus(true);
     this->setFocusContainer(true);
 
+    if (HelioProfiler::isEnabled())
+    {
+        this->profilerOverlay = new ProfilerOverlay(*this);
+        this->addAndMakeVisible(this->profilerOverlay);
+    }
+
     if (const bool quickStartMode = App::Workspace().isInitialized())
     {
         this->init();
@@ -398,11 +499,29 @@ Rectangle<int> MainLayout::getPageBounds() const
 // Component
 //===----------------------------------------------------------------------===//
 
+// Everything repainted within a frame is painted in between of these two,
+// so the profiler can measure the frame times; if the dirty area is covered
+// by opaque children, paint() is not called, and that frame is not measured
+void MainLayout::paint(Graphics &g)
+{
+    HelioProfiler::beginFrame();
+}
+
+void MainLayout::paintOverChildren(Graphics &g)
+{
+    HelioProfiler::endFrame();
+}
+
 void MainLayout::resized()
 {
     Rectangle<int> r(this->getLocalBounds());
     if (r.isEmpty()) { return; }
 
+    if (this->profilerOverlay != nullptr)
+    {
+        this->profilerOverlay->setTopRightPosition(r.getRight() - TOOLS_SIDEBAR_WIDTH, r.getBottom() - this->profilerOverlay->getHeight());
+    }
+
     this->headline->setBounds(r.removeFromTop(this->headline->getHeight()));
 
     if (this->currentContent)
@@ -71,6 +71,8 @@ public:
     // Component
     //===------------------------------------------------------------------===//
 
+    void paint(Graphics &g) override;
+    void paintOverChildren(Graphics &g) override;
     void resized() override;
     void lookAndFeelChanged() override;
     bool keyPressed(const KeyPress &key) override;
@@ -94,6 +96,8 @@ private:
     ScopedPointer<TooltipContainer> tooltipContainer;
     
     ScopedPointer<HotkeyScheme> hotkeyScheme;
+
+    ScopedPointer<Component> profilerOverlay;
     
 private:
 
@@ -30,6 +30,7 @@
 #include "Workspace.h"
 #include "DataEncoder.h"
 #include "CommandIDs.h"
+#include "HelioTrace.h"
 #include "App.h"
 //[/MiscUserDefs]
 
@@ -120,8 +121,17 @@ void InitScreen::handleCommandMessage (int commandId)
     //[UserCode_handleCommandMessage] -- Add your code here...
     if (commandId == CommandIDs::InitWorkspace)
     {
-        App::Workspace().init();
-        App::Layout().init();
+        {
+            HELIO_TRACE_SCOPE("Workspace::init");
+            App::Workspace().init();
+        }
+        
+        {
+            HELIO_TRACE_SCOPE("MainLayout::init");
+            App::Layout().init();
+        }
+        
+        HelioTrace::flush();
     }
     //[/UserCode_handleCommandMessage]
 }
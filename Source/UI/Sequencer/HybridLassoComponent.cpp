@@ -18,14 +18,17 @@
 #include "Common.h"
 #include "Lasso.h"
 #include "HybridLassoComponent.h"
+#include "HybridRoll.h"
 #include "HelioTheme.h"
 
 HybridLassoComponent::HybridLassoComponent() :
-    source(nullptr)
+    source(nullptr),
+    lastMode(replaceMode),
+    hasDragged(false)
 {
 }
 
-void HybridLassoComponent::beginLasso(const MouseEvent &e, LassoSource<SelectableComponent *> *const lassoSource)
+void HybridLassoComponent::beginLasso(const MouseEvent &e, HybridRoll *const lassoSource)
 {
     jassert(source == nullptr);
     jassert(lassoSource != nullptr);
@@ -35,6 +38,7 @@ void HybridLassoComponent::beginLasso(const MouseEvent &e, LassoSource<Selectabl
     {
         source = lassoSource;
         originalSelection = lassoSource->getLassoSelection().getItemArray();
+        std::sort(originalSelection.begin(), originalSelection.end());
         this->setSize(0, 0);
         this->toFront(false);
         dragStartPos = e.getMouseDownPosition();
@@ -50,22 +54,73 @@ void HybridLassoComponent::dragLasso(const MouseEvent &e)
 
         Array<SelectableComponent *> itemsInLasso;
         source->findLassoItemsInArea(itemsInLasso, getBounds());
+        std::sort(itemsInLasso.begin(), itemsInLasso.end());
 
-        if (e.mods.isShiftDown())
+        // Shift adds the lasso to the original selection, alt toggles it
+        const Mode mode = e.mods.isShiftDown() ? addMode :
+            (e.mods.isAltDown() ? toggleMode : replaceMode);
+
+        Lasso &selection = source->getLassoSelection();
+
+        if (! this->hasDragged || mode != this->lastMode)
         {
-            itemsInLasso.removeValuesIn(originalSelection);
-            itemsInLasso.addArray(originalSelection);
+            // the first drag, or the modifiers have changed: build the selection from scratch
+            Array<SelectableComponent *> result;
+            result.resize(itemsInLasso.size() + originalSelection.size());
+            SelectableComponent **resultEnd = result.begin();
+
+            if (mode == addMode)
+            {
+                resultEnd = std::set_union(itemsInLasso.begin(), itemsInLasso.end(),
+                    originalSelection.begin(), originalSelection.end(), result.begin());
+            }
+            else if (mode == toggleMode)
+            {
+                resultEnd = std::set_symmetric_difference(itemsInLasso.begin(), itemsInLasso.end(),
+                    originalSelection.begin(), originalSelection.end(), result.begin());
+            }
+            else
+            {
+                resultEnd = std::copy(itemsInLasso.begin(), itemsInLasso.end(), result.begin());
+            }
+
+            result.resize(int(resultEnd - result.begin()));
+            selection.setSelection(result);
         }
-        else if (e.mods.isAltDown())
+        else
         {
-            Array<SelectableComponent *> originalMinusNew(originalSelection);
-            originalMinusNew.removeValuesIn(itemsInLasso);
+            // only the items that have entered or left the lasso since the last drag change their state
+            Array<SelectableComponent *> delta;
+            delta.resize(itemsInLasso.size() + this->lastItemsInLasso.size());
+            SelectableComponent **deltaEnd =
+                std::set_symmetric_difference(itemsInLasso.begin(), itemsInLasso.end(),
+                    this->lastItemsInLasso.begin(), this->lastItemsInLasso.end(), delta.begin());
+
+            for (auto it = delta.begin(); it != deltaEnd; ++it)
+            {
+                SelectableComponent *item = *it;
+
+                const bool isInLasso = std::binary_search(itemsInLasso.begin(), itemsInLasso.end(), item);
+                const bool wasSelected = std::binary_search(originalSelection.begin(), originalSelection.end(), item);
+
+                const bool shouldBeSelected =
+                    (mode == addMode) ? (isInLasso || wasSelected) :
+                    ((mode == toggleMode) ? (isInLasso != wasSelected) : isInLasso);
 
-            itemsInLasso.removeValuesIn(originalSelection);
-            itemsInLasso.addArray(originalMinusNew);
+                if (shouldBeSelected)
+                {
+                    selection.addToSelection(item);
+                }
+                else
+                {
+                    selection.deselect(item);
+                }
+            }
         }
 
-        source->getLassoSelection() = Lasso(itemsInLasso);
+        this->hasDragged = true;
+        this->lastMode = mode;
+        this->lastItemsInLasso.swapWith(itemsInLasso);
     }
 }
 
@@ -75,6 +130,8 @@ void HybridLassoComponent::endLasso()
     {
         this->source = nullptr;
         this->originalSelection.clear();
+        this->lastItemsInLasso.clear();
+        this->hasDragged = false;
         this->setVisible(false);
     }
 }
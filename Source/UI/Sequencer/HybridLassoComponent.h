@@ -19,6 +19,8 @@
 
 #include "SelectableComponent.h"
 
+class HybridRoll;
+
 class HybridLassoComponent : public Component
 {
 public:
@@ -31,8 +33,7 @@ public:
         lassoOutlineColourId    = 0x1000441,
     };
 
-    virtual void beginLasso(const MouseEvent &e,
-        LassoSource<SelectableComponent *> *const lassoSource);
+    virtual void beginLasso(const MouseEvent &e, HybridRoll *const lassoSource);
 
     virtual void dragLasso(const MouseEvent &e);
 
@@ -46,9 +47,22 @@ public:
 
 private:
 
+    enum Mode
+    {
+        replaceMode,
+        addMode,
+        toggleMode
+    };
+
+    // Both sorted, so that the modifier logic can look items up quickly,
+    // and each drag only applies the difference to the last one
     Array<SelectableComponent *> originalSelection;
+    Array<SelectableComponent *> lastItemsInLasso;
+
+    HybridRoll *source;
 
-    LassoSource<SelectableComponent *> *source;
+    Mode lastMode;
+    bool hasDragged;
 
     Point<int> dragStartPos;
 
@@ -63,6 +63,7 @@
 #include "Workspace.h"
 #include "AudioCore.h"
 #include "AudioMonitor.h"
+#include "HelioProfiler.h"
 
 #include <limits.h>
 
@@ -83,6 +84,58 @@ template class AnnotationsTrackMap<AnnotationLargeComponent>;
 template class TimeSignaturesTrackMap<TimeSignatureLargeComponent>;
 
 
+//===----------------------------------------------------------------------===//
+// Repaint scheduler
+//===----------------------------------------------------------------------===//
+
+class HybridRoll::RepaintScheduler final : private Timer
+{
+public:
+
+    explicit RepaintScheduler(Component &owner) : owner(owner) {}
+
+    void add(const Rectangle<int> &area)
+    {
+        if (area.isEmpty())
+        { return; }
+
+        // Already going to be repainted within this frame
+        if (this->dirtyRegion.containsRectangle(area))
+        {
+            HELIO_PROFILE_COUNT("HybridRoll::repaintsSuppressed", 1);
+            return;
+        }
+
+        HELIO_PROFILE_COUNT("HybridRoll::repaintsMerged", 1);
+        this->dirtyRegion.add(area);
+
+        if (!this->isTimerRunning())
+        {
+            this->startTimerHz(60);
+        }
+    }
+
+private:
+
+    void timerCallback() override
+    {
+        if (this->dirtyRegion.isEmpty())
+        {
+            this->stopTimer();
+            return;
+        }
+
+        HELIO_PROFILE_COUNT("HybridRoll::repaints", 1);
+        this->owner.repaint(this->dirtyRegion.getBounds());
+        this->dirtyRegion.clear();
+    }
+
+    Component &owner;
+    RectangleList<int> dirtyRegion;
+
+    JUCE_DECLARE_NON_COPYABLE(RepaintScheduler)
+};
+
 HybridRoll::HybridRoll(ProjectTreeItem &parentProject,
                    Viewport &viewportRef,
                    WeakReference<AudioMonitor> AudioMonitor) :
@@ -105,11 +158,20 @@ HybridRoll::HybridRoll(ProjectTreeItem &parentProject,
     timeEnteredDragMode(0),
     transportLastCorrectPosition(0.0),
     transportIndicatorOffset(0.0),
-    shouldFollowIndicator(false)
+    shouldFollowIndicator(false),
+    beatLinesStripX(0),
+    beatLinesViewWidth(0),
+    beatLinesBarWidth(0.f),
+    beatLinesFirstBar(0),
+    beatLinesAreOutdated(true),
+    batchUpdateDepth(0),
+    batchHasTimeSignatureChanges(false)
 {
     this->setOpaque(true);
     this->setBufferedToImage(false);
 
+    this->repaintScheduler = new RepaintScheduler(*this);
+
     this->setSize(this->viewport.getWidth(), this->viewport.getHeight());
 
     this->setMouseClickGrabsKeyboardFocus(false);
@@ -637,6 +699,29 @@ void HybridRoll::setBarWidth(const float newBarWidth)
 #define MIN_BAR_WIDTH 12
 #define MIN_BEAT_WIDTH 8
 
+// Time signatures are sorted by beat, so the last one before a given beat
+// can be found with a binary search instead of walking the whole sequence
+static int findFirstSignatureIndexAtOrAfter(const MidiSequence *tsSequence, float beat)
+{
+    int start = 0;
+    int end = tsSequence->size();
+
+    while (start < end)
+    {
+        const int middle = (start + end) / 2;
+        if (tsSequence->getUnchecked(middle)->getBeat() < beat)
+        {
+            start = middle + 1;
+        }
+        else
+        {
+            end = middle;
+        }
+    }
+
+    return start;
+}
+
 void HybridRoll::computeVisibleBeatLines()
 {
     this->visibleBars.clearQuick();
@@ -664,27 +749,34 @@ void HybridRoll::computeVisibleBeatLines()
     int numerator = TIME_SIGNATURE_DEFAULT_NUMERATOR;
     int denominator = TIME_SIGNATURE_DEFAULT_DENOMINATOR;
     float i = float(paintStartBar);
-
-    int nextSignatureIdx = 0;
+    float barWidthSum = 0.f;
 
     // Find a time signature to start from (or use default values):
     // find a first time signature after a paint start and take a previous one, if any
-    for (; nextSignatureIdx < tsSequence->size(); ++nextSignatureIdx)
+    int nextSignatureIdx =
+        findFirstSignatureIndexAtOrAfter(tsSequence, float(paintStartBar * NUM_BEATS_IN_BAR));
+
+    if (nextSignatureIdx > 0)
     {
         const auto signature =
-            static_cast<TimeSignatureEvent *>(tsSequence->getUnchecked(nextSignatureIdx));
-        
-        if (signature->getBeat() >= (paintStartBar * NUM_BEATS_IN_BAR))
-        {
-            break;
-        }
+            static_cast<TimeSignatureEvent *>(tsSequence->getUnchecked(nextSignatureIdx - 1));
 
         numerator = signature->getNumerator();
         denominator = signature->getDenominator();
         i = signature->getBeat() / NUM_BEATS_IN_BAR;
+
+        // Skip all full bars between that signature and a paint start,
+        // there are no other signature changes in between
+        const float barStep = float(numerator) / float(denominator);
+        const float numBarsToSkip = floorf((paintStartBar - i) / barStep);
+        if (numBarsToSkip > 0.f)
+        {
+            i += numBarsToSkip * barStep;
+            // Make sure the first visible bar line is not filtered out
+            barWidthSum = float(MIN_BAR_WIDTH);
+        }
     }
     
-    float barWidthSum = 0.f;
     while (i <= paintEndBar)
     {
         // Expecting the bar to be full (if time signature does not change in between)
@@ -754,6 +846,75 @@ void HybridRoll::computeVisibleBeatLines()
     }
 }
 
+void HybridRoll::invalidateVisibleBeatLines() noexcept
+{
+    this->beatLinesAreOutdated = true;
+}
+
+void HybridRoll::updateVisibleBeatLinesIfNeeded()
+{
+    const int viewX = this->viewport.getViewPositionX();
+    const int viewWidth = this->viewport.getViewWidth();
+
+    if (!this->beatLinesAreOutdated &&
+        this->beatLinesStripX == viewX &&
+        this->beatLinesViewWidth == viewWidth &&
+        this->beatLinesBarWidth == this->barWidth &&
+        this->beatLinesFirstBar == this->firstBar)
+    {
+        return;
+    }
+
+    this->beatLinesStripX = viewX;
+    this->beatLinesViewWidth = viewWidth;
+    this->beatLinesBarWidth = this->barWidth;
+    this->beatLinesFirstBar = this->firstBar;
+    this->beatLinesAreOutdated = false;
+
+    this->computeVisibleBeatLines();
+    this->renderBeatLinesStrip();
+}
+
+void HybridRoll::renderBeatLinesStrip()
+{
+    const int stripWidth = jmax(1, this->beatLinesViewWidth);
+    if (this->beatLinesStrip.getWidth() != stripWidth)
+    {
+        this->beatLinesStrip = Image(Image::ARGB, stripWidth, 1, true);
+    }
+    else
+    {
+        this->beatLinesStrip.clear(this->beatLinesStrip.getBounds());
+    }
+
+    Graphics g(this->beatLinesStrip);
+    g.setOrigin(-this->beatLinesStripX, 0);
+
+    g.setColour(this->findColour(HybridRoll::barLineColourId));
+    for (const auto f : this->visibleBars)
+    {
+        g.fillRect(int(f), 0, 1, 1);
+    }
+
+    g.setColour(this->findColour(HybridRoll::barLineBevelColourId));
+    for (const auto f : this->visibleBars)
+    {
+        g.fillRect(int(f + 1), 0, 1, 1);
+    }
+
+    g.setColour(this->findColour(HybridRoll::beatLineColourId));
+    for (const auto f : this->visibleBeats)
+    {
+        g.fillRect(int(f), 0, 1, 1);
+    }
+
+    g.setColour(this->findColour(HybridRoll::snapLineColourId));
+    for (const auto f : this->visibleSnaps)
+    {
+        g.fillRect(int(f), 0, 1, 1);
+    }
+}
+
 
 //===----------------------------------------------------------------------===//
 // Alternative keydown modes (space for drag, etc.)
@@ -881,32 +1042,63 @@ HybridLassoComponent *HybridRoll::getLasso() const
 
 void HybridRoll::onChangeMidiEvent(const MidiEvent &oldEvent, const MidiEvent &newEvent)
 {
+    HELIO_PROFILE_SCOPE("HybridRoll::onChangeMidiEvent");
     // Time signatures have changed, need to repaint
     if (dynamic_cast<const TimeSignatureEvent *>(&oldEvent))
     {
-        this->updateChildrenBounds();
-        this->repaint();
+        this->onTimeSignaturesChanged();
     }
 }
 
 void HybridRoll::onAddMidiEvent(const MidiEvent &event)
 {
+    HELIO_PROFILE_SCOPE("HybridRoll::onAddMidiEvent");
     if (dynamic_cast<const TimeSignatureEvent *>(&event))
     {
-        this->updateChildrenBounds();
-        this->repaint();
+        this->onTimeSignaturesChanged();
     }
 }
 
 void HybridRoll::onRemoveMidiEvent(const MidiEvent &event)
 {
+    HELIO_PROFILE_SCOPE("HybridRoll::onRemoveMidiEvent");
     if (dynamic_cast<const TimeSignatureEvent *>(&event))
     {
-        this->updateChildrenBounds();
-        this->repaint();
+        this->onTimeSignaturesChanged();
     }
 }
 
+// The subclasses that don't handle groups on their own
+// still get the per-event callbacks, but only one roll update per group
+
+void HybridRoll::onAddMidiEvents(const Array<const MidiEvent *> &events)
+{
+    if (events.size() == 0) { return; }
+
+    HELIO_PROFILE_SCOPE("HybridRoll::onAddMidiEvents");
+    const ScopedBatchUpdate batch(*this);
+    ProjectListener::onAddMidiEvents(events);
+}
+
+void HybridRoll::onChangeMidiEvents(const Array<const MidiEvent *> &oldEvents,
+                                    const Array<const MidiEvent *> &newEvents)
+{
+    if (oldEvents.size() == 0) { return; }
+
+    HELIO_PROFILE_SCOPE("HybridRoll::onChangeMidiEvents");
+    const ScopedBatchUpdate batch(*this);
+    ProjectListener::onChangeMidiEvents(oldEvents, newEvents);
+}
+
+void HybridRoll::onRemoveMidiEvents(const Array<const MidiEvent *> &events)
+{
+    if (events.size() == 0) { return; }
+
+    HELIO_PROFILE_SCOPE("HybridRoll::onRemoveMidiEvents");
+    const ScopedBatchUpdate batch(*this);
+    ProjectListener::onRemoveMidiEvents(events);
+}
+
 void HybridRoll::onChangeProjectBeatRange(float firstBeat, float lastBeat)
 {
     //Logger::writeToLog("HybridRoll::onProjectBeatRangeChanged " + String(firstBeat) + " " + String(lastBeat));
@@ -1076,45 +1268,23 @@ void HybridRoll::moved()
 
 void HybridRoll::resized()
 {
+    HELIO_PROFILE_SCOPE("HybridRoll::resized");
     this->updateChildrenBounds();
     //this->sendChangeMessage();
 }
 
 void HybridRoll::paint(Graphics &g)
 {
-    const Colour barLine = findColour(HybridRoll::barLineColourId);
-    const Colour barLineBevel = findColour(HybridRoll::barLineBevelColourId);
-    const Colour beatLine = findColour(HybridRoll::beatLineColourId);
-    const Colour snapLine = findColour(HybridRoll::snapLineColourId);
-    
-    this->computeVisibleBeatLines();
-
-    const float paintStartY = float(this->viewport.getViewPositionY());
-    const float paintEndY = paintStartY + this->viewport.getViewHeight();
+    HELIO_PROFILE_SCOPE("HybridRoll::paint");
+    this->updateVisibleBeatLinesIfNeeded();
 
-    g.setColour(barLine);
-    for (const auto f : this->visibleBars)
-    {
-        g.drawVerticalLine(int(f), paintStartY, paintEndY);
-    }
-
-    g.setColour(barLineBevel);
-    for (const auto f : this->visibleBars)
-    {
-        g.drawVerticalLine(int(f + 1), paintStartY, paintEndY);
-    }
-
-    g.setColour(beatLine);
-    for (const auto f : this->visibleBeats)
-    {
-        g.drawVerticalLine(int(f), paintStartY, paintEndY);
-    }
-    
-    g.setColour(snapLine);
-    for (const auto f : this->visibleSnaps)
-    {
-        g.drawVerticalLine(int(f), paintStartY, paintEndY);
-    }
+    // Grid lines are all vertical and span the whole view height,
+    // so the pre-rendered strip is just tiled down the visible area
+    g.setTiledImageFill(this->beatLinesStrip, this->beatLinesStripX, 0, 1.f);
+    g.fillRect(this->beatLinesStripX,
+        this->viewport.getViewPositionY(),
+        this->beatLinesStrip.getWidth(),
+        this->viewport.getViewHeight());
 }
 
 //===----------------------------------------------------------------------===//
@@ -1317,14 +1487,58 @@ void HybridRoll::scrollToSeekPosition()
 }
 
 
+//===----------------------------------------------------------------------===//
+// Repaints
+//===----------------------------------------------------------------------===//
+
+void HybridRoll::scheduleRepaint(const Rectangle<int> &area)
+{
+    // Only the visible part is worth repainting
+    this->repaintScheduler->add(area.getIntersection(this->viewport.getViewArea()));
+}
+
+void HybridRoll::scheduleRepaint()
+{
+    this->repaintScheduler->add(this->viewport.getViewArea());
+}
+
+HybridRoll::ScopedBatchUpdate::ScopedBatchUpdate(HybridRoll &roll) : roll(roll)
+{
+    this->roll.batchUpdateDepth++;
+}
+
+HybridRoll::ScopedBatchUpdate::~ScopedBatchUpdate()
+{
+    if (--this->roll.batchUpdateDepth == 0 &&
+        this->roll.batchHasTimeSignatureChanges)
+    {
+        this->roll.batchHasTimeSignatureChanges = false;
+        this->roll.onTimeSignaturesChanged();
+    }
+}
+
+void HybridRoll::onTimeSignaturesChanged()
+{
+    if (this->batchUpdateDepth > 0)
+    {
+        this->batchHasTimeSignatureChanges = true;
+        return;
+    }
+
+    this->invalidateVisibleBeatLines();
+    this->updateChildrenBounds();
+    this->scheduleRepaint();
+}
+
 //===----------------------------------------------------------------------===//
 // AsyncUpdater
 //===----------------------------------------------------------------------===//
 
 void HybridRoll::handleAsyncUpdate()
 {
+    HELIO_PROFILE_SCOPE("HybridRoll::handleAsyncUpdate");
     // batch repaint & resize stuff
-    if (this->batchRepaintList.size() > 0)
+    if (this->batchRepaintList.size() > HYBRID_ROLL_MAX_BATCH_SIZE_TO_REPAINT_SEPARATELY)
     {
         HYBRID_ROLL_BULK_REPAINT_START
 
@@ -1332,9 +1546,7 @@ void HybridRoll::handleAsyncUpdate()
         {
             if (FloatBoundsComponent *mc = this->batchRepaintList.getUnchecked(i))
             {
-                const Rectangle<float> nb(this->getEventBounds(mc));
-                mc->setFloatBounds(nb);
-                mc->repaint();
+                mc->setFloatBounds(this->getEventBounds(mc));
             }
         }
 
@@ -1342,6 +1554,21 @@ void HybridRoll::handleAsyncUpdate()
 
         this->batchRepaintList.clear();
     }
+    else if (this->batchRepaintList.size() > 0)
+    {
+        // Moving a component repaints its old and new areas anyway,
+        // so only the content changes need to be scheduled here
+        for (int i = 0; i < this->batchRepaintList.size(); ++i)
+        {
+            if (FloatBoundsComponent *mc = this->batchRepaintList.getUnchecked(i))
+            {
+                mc->setFloatBounds(this->getEventBounds(mc));
+                this->scheduleRepaint(mc->getBounds());
+            }
+        }
+
+        this->batchRepaintList.clear();
+    }
 
 #if HYBRID_ROLL_FOLLOWS_INDICATOR
     if (this->shouldFollowIndicator &&
@@ -1803,6 +2030,7 @@ static const int shadowSize = 15;
 
 void HybridRoll::updateChildrenBounds()
 {
+    HELIO_PROFILE_SCOPE("HybridRoll::updateChildrenBounds");
     const int &viewHeight = this->viewport.getViewHeight();
     const int &viewWidth = this->viewport.getViewWidth();
     const int &viewX = this->viewport.getViewPositionX();
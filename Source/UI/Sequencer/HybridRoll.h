@@ -87,6 +87,9 @@ class TimelineWarningMarker;
 #define HYBRID_ROLL_BULK_REPAINT_END \
     this->setVisible(true);
 
+// Batches larger than this are laid out with the roll hidden and then repainted as a whole
+#define HYBRID_ROLL_MAX_BATCH_SIZE_TO_REPAINT_SEPARATELY 32
+
 class HybridRoll :
     public Component,
     public Serializable,
@@ -96,7 +99,6 @@ class HybridRoll :
     public MultiTouchListener,
     public ProjectListener,
     public ClipboardOwner,
-    public LassoSource<SelectableComponent *>,
     protected ChangeListener, // listens to HybridRollEditMode,
     protected TransportListener,
     protected AsyncUpdater, // for async scrolling on transport listener events
@@ -261,7 +263,10 @@ public:
     // LassoSource
     //===------------------------------------------------------------------===//
 
-    Lasso &getLassoSelection() override;
+    virtual void findLassoItemsInArea(Array<SelectableComponent *> &itemsFound,
+        const Rectangle<int> &rectangle) = 0;
+
+    Lasso &getLassoSelection();
     void selectEventsInRange(float startBeat, float endBeat, bool shouldClearAllOthers);
     void selectEvent(SelectableComponent *event, bool shouldClearAllOthers);
     void deselectEvent(SelectableComponent *event);
@@ -276,6 +281,10 @@ public:
     void onChangeMidiEvent(const MidiEvent &oldEvent, const MidiEvent &newEvent) override;
     void onAddMidiEvent(const MidiEvent &event) override;
     void onRemoveMidiEvent(const MidiEvent &event) override;
+    void onAddMidiEvents(const Array<const MidiEvent *> &events) override;
+    void onChangeMidiEvents(const Array<const MidiEvent *> &oldEvents,
+                            const Array<const MidiEvent *> &newEvents) override;
+    void onRemoveMidiEvents(const Array<const MidiEvent *> &events) override;
     void onChangeProjectBeatRange(float firstBeat, float lastBeat) override;
     void onChangeViewBeatRange(float firstBeat, float lastBeat) override;
 
@@ -447,6 +456,20 @@ protected:
     Array<float> visibleSnaps;
 
     void computeVisibleBeatLines();
+    void updateVisibleBeatLinesIfNeeded();
+    void invalidateVisibleBeatLines() noexcept;
+
+    // All vertical grid lines for the current view, rendered as a 1px high strip,
+    // which is then tiled over the visible area: vertical scrolling and any repaints
+    // which do not move the view horizontally will not need to recompute or redraw them
+    Image beatLinesStrip;
+    int beatLinesStripX;
+    int beatLinesViewWidth;
+    float beatLinesBarWidth;
+    int beatLinesFirstBar;
+    bool beatLinesAreOutdated;
+    
+    void renderBeatLinesStrip();
 
 protected:
 
@@ -457,6 +480,31 @@ protected:
 
     Array<SafePointer<FloatBoundsComponent>> batchRepaintList;
 
+    // All the roll's own repaints go through the scheduler, which collects
+    // the dirty areas and repaints their visible bounds at most once per frame
+    class RepaintScheduler;
+    ScopedPointer<RepaintScheduler> repaintScheduler;
+
+    void scheduleRepaint(const Rectangle<int> &area);
+    void scheduleRepaint();
+
+    // While a group of events is being handled, the roll-wide updates
+    // requested by each event are deferred and done once, when the outermost scope ends
+    class ScopedBatchUpdate final
+    {
+    public:
+        explicit ScopedBatchUpdate(HybridRoll &roll);
+        ~ScopedBatchUpdate();
+    private:
+        HybridRoll &roll;
+        JUCE_DECLARE_NON_COPYABLE(ScopedBatchUpdate)
+    };
+
+    int batchUpdateDepth;
+    bool batchHasTimeSignatureChanges;
+
+    void onTimeSignaturesChanged();
+
 protected:
     
     void changeListenerCallback(ChangeBroadcaster *source) override;
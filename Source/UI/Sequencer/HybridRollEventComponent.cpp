@@ -112,6 +112,11 @@ bool HybridRollEventComponent::isSelected() const
     return this->selectedState;
 }
 
+String HybridRollEventComponent::getSelectionId() const
+{
+    return this->getId();
+}
+
 
 //===----------------------------------------------------------------------===//
 // Helpers
@@ -52,6 +52,7 @@ public:
 
     void setSelected(bool selected) override;
     bool isSelected() const override;
+    String getSelectionId() const override;
 
 protected:
 
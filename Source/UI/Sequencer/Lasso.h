@@ -40,30 +40,168 @@ public:
     }
 };
 
-class Lasso :
-    public SelectedItemSet<SelectableComponent *>
+// The roll's selection model.
+// Membership is kept by the selected events' ids, grouped per track, so it
+// doesn't depend on the components, which are only views: they get their selected
+// flag updated, and may be hidden or recreated. Looking an item up takes the track's
+// id map and the event's id as they are, nothing is concatenated or allocated.
+// Deselecting leaves a hole in the items array, which is compacted on the next read,
+// so removing lots of items is linear overall, and the per-track groups
+// are built once per change, not per item.
+class Lasso final
 {
 public:
 
-    Lasso() : SelectedItemSet() {}
-    
-    explicit Lasso(const ItemArray &items) : SelectedItemSet (items)
+    typedef Array<SelectableComponent *> ItemArray;
+    typedef HashMap< String, SelectionProxyArray::Ptr > GroupedSelections;
+
+    Lasso() : numHoles(0) {}
+
+    //===------------------------------------------------------------------===//
+    // Selection
+    //===------------------------------------------------------------------===//
+
+    bool isSelected(SelectableComponent *item) const
     {
-        this->invalidateCache();
+        if (item == nullptr)
+        {
+            return false;
+        }
+
+        const SelectedIds *ids = this->findSelectedIds(item->getSelectionGroupId());
+        return (ids != nullptr && ids->contains(item->getSelectionId()));
     }
-    
-    void itemSelected(SelectableComponent *item) override
+
+    void addToSelection(SelectableComponent *item)
     {
-        this->invalidateCache();
-        item->setSelected(true);
+        if (item == nullptr)
+        {
+            return;
+        }
+
+        SelectedIds &ids = this->getOrCreateSelectedIds(item->getSelectionGroupId());
+        const String id(item->getSelectionId());
+
+        if (ids.contains(id))
+        {
+            return;
+        }
+
+        ids.set(id, this->selectedItems.size());
+        this->selectedItems.add(item);
+        this->itemSelected(item);
     }
 
-    void itemDeselected(SelectableComponent *item) override
+    void deselect(SelectableComponent *item)
     {
-        this->invalidateCache();
-        item->setSelected(false);
+        if (item == nullptr)
+        {
+            return;
+        }
+
+        SelectedIds *ids = this->findSelectedIds(item->getSelectionGroupId());
+        const String id(item->getSelectionId());
+
+        if (ids == nullptr || !ids->contains(id))
+        {
+            return;
+        }
+
+        this->selectedItems.set((*ids)[id], nullptr);
+        ids->remove(id);
+        this->numHoles++;
+
+        this->itemDeselected(item);
     }
 
+    void deselectAll()
+    {
+        if (this->getNumSelected() == 0)
+        {
+            return;
+        }
+
+        for (auto item : this->selectedItems)
+        {
+            if (item != nullptr)
+            {
+                item->setSelected(false);
+            }
+        }
+
+        this->clearIds();
+    }
+
+    // Replaces the selection in one pass, only touching the items whose state changes;
+    // for small changes, like the lasso being dragged, prefer addToSelection and deselect
+    void setSelection(const ItemArray &items)
+    {
+        ItemArray sortedItems(items);
+        std::sort(sortedItems.begin(), sortedItems.end());
+
+        for (auto item : this->selectedItems)
+        {
+            if (item != nullptr &&
+                !std::binary_search(sortedItems.begin(), sortedItems.end(), item))
+            {
+                item->setSelected(false);
+            }
+        }
+
+        this->clearIds();
+        this->selectedItems.ensureStorageAllocated(items.size());
+
+        for (auto item : items)
+        {
+            SelectedIds &ids = this->getOrCreateSelectedIds(item->getSelectionGroupId());
+            const String id(item->getSelectionId());
+
+            if (!ids.contains(id))
+            {
+                ids.set(id, this->selectedItems.size());
+                this->selectedItems.add(item);
+
+                if (!item->isSelected())
+                {
+                    item->setSelected(true);
+                }
+            }
+        }
+    }
+
+    int getNumSelected() const noexcept
+    {
+        return this->selectedItems.size() - this->numHoles;
+    }
+
+    SelectableComponent *getSelectedItem(const int index) const
+    {
+        this->compactIfNeeded();
+        return this->selectedItems[index];
+    }
+
+    const ItemArray &getItemArray() const
+    {
+        this->compactIfNeeded();
+        return this->selectedItems;
+    }
+
+    template<typename T>
+    T *getFirstAs() const
+    {
+        return static_cast<T *>(this->getSelectedItem(0));
+    }
+
+    template<typename T>
+    T *getItemAs(const int index) const
+    {
+        return static_cast<T *>(this->getSelectedItem(index));
+    }
+
+    //===------------------------------------------------------------------===//
+    // Bounds
+    //===------------------------------------------------------------------===//
+
     void needsToCalculateSelectionBounds()
     {
         this->bounds = Rectangle<int>();
@@ -78,13 +216,17 @@ public:
     {
         return this->bounds;
     }
-    
-    
-    typedef HashMap< String, SelectionProxyArray::Ptr > GroupedSelections;
+
+    //===------------------------------------------------------------------===//
+    // Grouped by track
+    //===------------------------------------------------------------------===//
 
     void invalidateCache()
     {
-        this->selectionsCache.clear();
+        if (this->selectionsCache.size() > 0)
+        {
+            this->selectionsCache.clear();
+        }
     }
 
     const GroupedSelections &getGroupedSelections() const
@@ -97,18 +239,6 @@ public:
         return this->selectionsCache;
     }
 
-    template<typename T>
-    T *getFirstAs() const
-    {
-        return static_cast<T *>(this->getSelectedItem(0));
-    }
-
-    template<typename T>
-    T *getItemAs(const int index) const
-    {
-        return static_cast<T *>(this->getSelectedItem(index));
-    }
-
     bool shouldDisplayGhostNotes() const
     {
         return (this->getNumSelected() <= 32); // just a sane limit
@@ -116,33 +246,118 @@ public:
 
 private:
 
+    // selected event id -> index in selectedItems, one map per track
+    typedef HashMap<String, int> SelectedIds;
+
+    // the items are kept in the order of selection, with holes left by deselection
+    mutable ItemArray selectedItems;
+    mutable int numHoles;
+
+    OwnedArray<SelectedIds> selectedIdsStorage;
+    HashMap<String, SelectedIds *> selectedIdsByTrack;
+
     Rectangle<int> bounds;
     
     mutable GroupedSelections selectionsCache;
 
+    void itemSelected(SelectableComponent *item)
+    {
+        this->invalidateCache();
+        item->setSelected(true);
+    }
+
+    void itemDeselected(SelectableComponent *item)
+    {
+        this->invalidateCache();
+        item->setSelected(false);
+    }
+
+    SelectedIds *findSelectedIds(const String &groupId) const
+    {
+        return this->selectedIdsByTrack[groupId];
+    }
+
+    SelectedIds &getOrCreateSelectedIds(const String &groupId)
+    {
+        if (SelectedIds *ids = this->selectedIdsByTrack[groupId])
+        {
+            return *ids;
+        }
+
+        SelectedIds *ids = this->selectedIdsStorage.add(new SelectedIds());
+        this->selectedIdsByTrack.set(groupId, ids);
+        return *ids;
+    }
+
+    void clearIds()
+    {
+        this->selectedItems.clearQuick();
+        this->selectedIdsByTrack.clear();
+        this->selectedIdsStorage.clear();
+        this->numHoles = 0;
+        this->invalidateCache();
+    }
+
+    void compactIfNeeded() const
+    {
+        if (this->numHoles == 0)
+        {
+            return;
+        }
+
+        int numKeptItems = 0;
+        for (int i = 0; i < this->selectedItems.size(); ++i)
+        {
+            SelectableComponent *item = this->selectedItems.getUnchecked(i);
+
+            if (item != nullptr)
+            {
+                if (numKeptItems != i)
+                {
+                    SelectedIds *ids = this->findSelectedIds(item->getSelectionGroupId());
+                    jassert(ids != nullptr);
+                    ids->set(item->getSelectionId(), numKeptItems);
+                    this->selectedItems.setUnchecked(numKeptItems, item);
+                }
+
+                numKeptItems++;
+            }
+        }
+
+        this->selectedItems.removeLast(this->selectedItems.size() - numKeptItems);
+        this->numHoles = 0;
+    }
+
     void rebuildCache() const
     {
-        //Logger::writeToLog("rebuildCache");
+        // Items of the same track usually come in a row,
+        // so the hash map is only looked up when the track changes
+        String lastGroupId;
+        SelectionProxyArray::Ptr targetArray;
 
         for (int i = 0; i < this->getNumSelected(); ++i)
         {
             SelectableComponent *item = this->getSelectedItem(i);
-            const String &groupId(item->getSelectionGroupId());
-            
-            SelectionProxyArray::Ptr targetArray;
-            
-            if (this->selectionsCache.contains(groupId))
-            {
-                targetArray = this->selectionsCache[groupId];
-            }
-            else
+            const String groupId(item->getSelectionGroupId());
+
+            if (targetArray == nullptr || groupId != lastGroupId)
             {
-                targetArray = new SelectionProxyArray();
+                if (this->selectionsCache.contains(groupId))
+                {
+                    targetArray = this->selectionsCache[groupId];
+                }
+                else
+                {
+                    targetArray = new SelectionProxyArray();
+                    this->selectionsCache.set(groupId, targetArray);
+                }
+
+                lastGroupId = groupId;
             }
-            
+
             targetArray->add(item);
-            this->selectionsCache.set(groupId, targetArray);
         }
     }
 
+    JUCE_DECLARE_NON_COPYABLE(Lasso)
 };
@@ -45,8 +45,8 @@
 #include "AutomationClipComponent.h"
 #include "DummyClipComponent.h"
 #include "ComponentIDs.h"
+#include "HelioProfiler.h"
 
-#define ROWS_OF_TWO_OCTAVES 24
 #define DEFAULT_CLIP_LENGTH 1.0f
 
 //void dumpDebugInfo(Array<MidiTrack *> tracks)
@@ -182,7 +182,7 @@ void PatternRoll::reloadRollContent()
 
     this->setSize(this->getWidth(),
         HYBRID_ROLL_HEADER_HEIGHT + this->getNumRows() * PATTERNROLL_ROW_HEIGHT);
-    this->repaint(this->viewport.getViewArea());
+    this->scheduleRepaint();
 }
 
 int PatternRoll::getNumRows() const noexcept
@@ -282,6 +282,7 @@ Pattern *PatternRoll::getPatternByMousePosition(int y) const
 
 void PatternRoll::onAddMidiEvent(const MidiEvent &event)
 {
+    HELIO_PROFILE_SCOPE("PatternRoll::onAddMidiEvent");
     // the question is:
     // is pattern roll supposed to monitor single event changes?
     // or it just reloads the whole sequence on show?0
@@ -290,11 +291,13 @@ void PatternRoll::onAddMidiEvent(const MidiEvent &event)
 
 void PatternRoll::onChangeMidiEvent(const MidiEvent &oldEvent, const MidiEvent &newEvent)
 {
+    HELIO_PROFILE_SCOPE("PatternRoll::onChangeMidiEvent");
     //
 }
 
 void PatternRoll::onRemoveMidiEvent(const MidiEvent &event)
 {
+    HELIO_PROFILE_SCOPE("PatternRoll::onRemoveMidiEvent");
     //
 }
 
@@ -318,12 +321,16 @@ void PatternRoll::onChangeTrackProperties(MidiTrack *const track)
     {
         this->tracks.removeAllInstancesOf(track);
         this->tracks.addSorted(*track, track);
-        this->repaint();
+        this->scheduleRepaint();
     }
 }
 
 void PatternRoll::onResetTrackContent(MidiTrack *const track)
 {
+    HELIO_PROFILE_SCOPE("PatternRoll::onResetTrackContent");
+    // Might be the time signatures track
+    this->invalidateVisibleBeatLines();
+
     if (Pattern *pattern = track->getPattern())
     {
         this->tracks.removeAllInstancesOf(track);
@@ -357,6 +364,7 @@ void PatternRoll::onRemoveTrack(MidiTrack *const track)
 
 void PatternRoll::onAddClip(const Clip &clip)
 {
+    HELIO_PROFILE_SCOPE("PatternRoll::onAddClip");
     ClipComponent *clipComponent = nullptr;
     auto track = clip.getPattern()->getTrack();
     auto sequence = track->getSequence();
@@ -390,6 +398,7 @@ void PatternRoll::onAddClip(const Clip &clip)
 
 void PatternRoll::onChangeClip(const Clip &clip, const Clip &newClip)
 {
+    HELIO_PROFILE_SCOPE("PatternRoll::onChangeClip");
     if (ClipComponent *component = this->componentsHashTable[clip])
     {
         this->batchRepaintList.add(component);
@@ -402,6 +411,7 @@ void PatternRoll::onChangeClip(const Clip &clip, const Clip &newClip)
 
 void PatternRoll::onRemoveClip(const Clip &clip)
 {
+    HELIO_PROFILE_SCOPE("PatternRoll::onRemoveClip");
     if (ClipComponent *component = this->componentsHashTable[clip])
     {
         this->fader.fadeOut(component, 150);
@@ -425,29 +435,15 @@ void PatternRoll::onPostRemoveClip(Pattern *const pattern)
 
 void PatternRoll::findLassoItemsInArea(Array<SelectableComponent *> &itemsFound, const Rectangle<int> &rectangle)
 {
-    bool shouldInvalidateSelectionCache = false;
-
-    for (int i = 0; i < this->eventComponents.size(); ++i)
-    {
-        ClipComponent *clip = static_cast<ClipComponent *>(this->eventComponents.getUnchecked(i));
-        clip->setSelected(this->selection.isSelected(clip));
-    }
-
     for (int i = 0; i < this->eventComponents.size(); ++i)
     {
         ClipComponent *clip = static_cast<ClipComponent *>(this->eventComponents.getUnchecked(i));
 
         if (rectangle.intersects(clip->getBounds()) && clip->isActive())
         {
-            shouldInvalidateSelectionCache = true;
-            itemsFound.addIfNotAlreadyThere(clip);
+            itemsFound.add(clip);
         }
     }
-
-    if (shouldInvalidateSelectionCache)
-    {
-        this->selection.invalidateCache();
-    }
 }
 
 
@@ -616,6 +612,7 @@ void PatternRoll::mouseUp(const MouseEvent &e)
 
 void PatternRoll::resized()
 {
+    HELIO_PROFILE_SCOPE("PatternRoll::resized");
     if (!this->isShowing())
     {
         return;
@@ -636,64 +633,70 @@ void PatternRoll::resized()
 
 void PatternRoll::paint(Graphics &g)
 {
-#if PATTERNROLL_HAS_PRERENDERED_BACKGROUND
+    HELIO_PROFILE_SCOPE("PatternRoll::paint");
 
-    g.setTiledImageFill(this->rowPattern, 0, PATTERN_ROLL_HEADER_OFFSET, 1.f);
-    g.fillRect(this->viewport.getViewArea());
+#if PATTERNROLL_HAS_PRERENDERED_BACKGROUND
+    const CachedImage::Ptr rowsPattern =
+        static_cast<HelioTheme &>(this->getLookAndFeel()).getRollBgCache(PATTERNROLL_ROW_HEIGHT);
 
-#else
+    if (rowsPattern != nullptr)
+    {
+        g.setTiledImageFill(*rowsPattern, 0, HYBRID_ROLL_HEADER_HEIGHT, 1.f);
+        g.fillRect(this->viewport.getViewArea());
+    }
+    else
+#endif
+    {
+        const Colour blackKey = this->findColour(HybridRoll::blackKeyColourId);
+        const Colour blackKeyBright = this->findColour(HybridRoll::blackKeyBrightColourId);
+        const Colour whiteKey = this->findColour(HybridRoll::whiteKeyColourId);
+        const Colour whiteKeyBright = this->findColour(HybridRoll::whiteKeyBrightColourId);
+        const Colour whiteKeyBrighter = whiteKeyBright.brighter(0.025f);
+        const Colour rowLine = this->findColour(HybridRoll::rowLineColourId);
 
-    const Colour blackKey = this->findColour(HybridRoll::blackKeyColourId);
-    const Colour blackKeyBright = this->findColour(HybridRoll::blackKeyBrightColourId);
-    const Colour whiteKey = this->findColour(HybridRoll::whiteKeyColourId);
-    const Colour whiteKeyBright = this->findColour(HybridRoll::whiteKeyBrightColourId);
-    const Colour whiteKeyBrighter = whiteKeyBright.brighter(0.025f);
-    const Colour rowLine = this->findColour(HybridRoll::rowLineColourId);
+        const float visibleWidth = float(this->viewport.getViewWidth());
+        const float visibleHeight = float(this->viewport.getViewHeight());
+        const Point<int> &viewPosition = this->viewport.getViewPosition();
 
-    const float visibleWidth = float(this->viewport.getViewWidth());
-    const float visibleHeight = float(this->viewport.getViewHeight());
-    const Point<int> &viewPosition = this->viewport.getViewPosition();
+        const int keyStart = int(viewPosition.getY() / PATTERNROLL_ROW_HEIGHT);
+        const int keyEnd = int((viewPosition.getY() + visibleHeight) / PATTERNROLL_ROW_HEIGHT);
 
-    const int keyStart = int(viewPosition.getY() / PATTERNROLL_ROW_HEIGHT);
-    const int keyEnd = int((viewPosition.getY() + visibleHeight) / PATTERNROLL_ROW_HEIGHT);
+        // Fill everything with white keys color
+        g.setColour(whiteKeyBright);
+        g.fillRect(float(viewPosition.getX()), float(viewPosition.getY()), visibleWidth, visibleHeight);
 
-    // Fill everything with white keys color
-    g.setColour(whiteKeyBright);
-    g.fillRect(float(viewPosition.getX()), float(viewPosition.getY()), visibleWidth, visibleHeight);
+        for (int i = keyStart; i <= keyEnd; i++)
+        {
+            const int lastOctaveReminder = 4;
+            const int yPos = HYBRID_ROLL_HEADER_HEIGHT + i * PATTERNROLL_ROW_HEIGHT;
+            const int noteNumber = (i + lastOctaveReminder) % 12;
+            const int octaveNumber = (i + lastOctaveReminder) / 12;
+            const bool octaveIsOdd = ((octaveNumber % 2) > 0);
 
-    for (int i = keyStart; i <= keyEnd; i++)
-    {
-        const int lastOctaveReminder = 4;
-        const int yPos = HYBRID_ROLL_HEADER_HEIGHT + i * PATTERNROLL_ROW_HEIGHT;
-        const int noteNumber = (i + lastOctaveReminder) % 12;
-        const int octaveNumber = (i + lastOctaveReminder) / 12;
-        const bool octaveIsOdd = ((octaveNumber % 2) > 0);
+            switch (noteNumber)
+            {
+                case 1:
+                case 3:
+                case 5:
+                case 8:
+                case 10: // black keys
+                    g.setColour(octaveIsOdd ? blackKeyBright : blackKey);
+                    g.fillRect(float(viewPosition.getX()), float(yPos), visibleWidth, float(PATTERNROLL_ROW_HEIGHT));
+                    break;
+
+                default: // white keys bevel
+                    g.setColour(whiteKeyBrighter);
+                    g.drawHorizontalLine(yPos + 1, float(viewPosition.getX()), float(viewPosition.getX() + visibleWidth));
+                    break;
+            }
 
-        switch (noteNumber)
-        {
-            case 1:
-            case 3:
-            case 5:
-            case 8:
-            case 10: // black keys
-                g.setColour(octaveIsOdd ? blackKeyBright : blackKey);
-                g.fillRect(float(viewPosition.getX()), float(yPos), visibleWidth, float(PATTERNROLL_ROW_HEIGHT));
-                break;
-
-            default: // white keys bevel
-                g.setColour(whiteKeyBrighter);
-                g.drawHorizontalLine(yPos + 1, float(viewPosition.getX()), float(viewPosition.getX() + visibleWidth));
-                break;
+            g.setColour(rowLine);
+            g.drawHorizontalLine(yPos, float(viewPosition.getX()), float(viewPosition.getX() + visibleWidth));
         }
 
-        g.setColour(rowLine);
-        g.drawHorizontalLine(yPos, float(viewPosition.getX()), float(viewPosition.getX() + visibleWidth));
+        HelioTheme::drawNoiseWithin(this->viewport.getViewArea().toFloat(), this, g, 2.0);
     }
 
-    HelioTheme::drawNoiseWithin(this->viewport.getViewArea().toFloat(), this, g, 2.0);
-
-#endif
-
     HybridRoll::paint(g);
 }
 
@@ -750,70 +753,3 @@ void PatternRoll::deserialize(const XmlElement &xml)
 void PatternRoll::reset()
 {
 }
-
-
-//===----------------------------------------------------------------------===//
-// Bg images cache
-//===----------------------------------------------------------------------===//
-
-CachedImage::Ptr PatternRoll::renderRowsPattern(HelioTheme &theme, int height)
-{
-    CachedImage::Ptr patternImage(new CachedImage(Image::RGB, 128, height * ROWS_OF_TWO_OCTAVES, false));
-
-    Graphics g(*patternImage);
-
-    const Colour blackKey = theme.findColour(HybridRoll::blackKeyColourId);
-    const Colour blackKeyBright = theme.findColour(HybridRoll::blackKeyBrightColourId);
-    const Colour whiteKey = theme.findColour(HybridRoll::whiteKeyColourId);
-    const Colour whiteKeyBright = theme.findColour(HybridRoll::whiteKeyBrightColourId);
-    const Colour whiteKeyBrighter = whiteKeyBright.brighter(0.025f);
-    const Colour rowLine = theme.findColour(HybridRoll::rowLineColourId);
-
-    float currentHeight = float(height);
-    float previousHeight = 0;
-    float pos_y = patternImage->getHeight() - currentHeight;
-    const int lastOctaveReminder = 8;
-
-    g.setColour(whiteKeyBright);
-    g.fillRect(patternImage->getBounds());
-
-    // draw rows
-    for (int i = lastOctaveReminder;
-         (i < ROWS_OF_TWO_OCTAVES + lastOctaveReminder) && ((pos_y + previousHeight) >= 0.0f);
-         i++)
-    {
-        const int noteNumber = i % 12;
-        const int octaveNumber = i / 12;
-        const bool octaveIsOdd = ((octaveNumber % 2) > 0);
-
-        previousHeight = currentHeight;
-
-        switch (noteNumber)
-        {
-        case 1:
-        case 3:
-        case 5:
-        case 8:
-        case 10: // black keys
-            g.setColour(octaveIsOdd ? blackKeyBright : blackKey);
-            g.fillRect(0, int(pos_y + 1), patternImage->getWidth(), int(previousHeight - 1));
-            break;
-
-        default: // white keys
-            g.setColour(whiteKeyBrighter);
-            g.drawHorizontalLine(int(pos_y + 1), 0.f, float(patternImage->getWidth()));
-            break;
-        }
-
-        // fill divider line
-        g.setColour(rowLine);
-        g.drawHorizontalLine(int(pos_y), 0.f, float(patternImage->getWidth()));
-
-        currentHeight = float(height);
-        pos_y -= currentHeight;
-    }
-
-    HelioTheme::drawNoise(theme, g, 2.f);
-
-    return patternImage;
-}
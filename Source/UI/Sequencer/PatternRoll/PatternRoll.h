@@ -118,13 +118,6 @@ public:
     void deserialize(const XmlElement &xml) override;
     void reset() override;
     
-public:
-
-        static CachedImage::Ptr rowPattern;
-        static CachedImage::Ptr renderRowsPattern(HelioTheme &theme, int height);
-        static void repaintBackgroundsCache(HelioTheme &theme)
-        { rowPattern = PatternRoll::renderRowsPattern(theme, PATTERNROLL_ROW_HEIGHT); }
-
 private:
 
     void insertNewClipAt(const MouseEvent &e);
@@ -52,11 +52,176 @@
 #include "Config.h"
 #include "SerializationKeys.h"
 #include "ComponentIDs.h"
+#include "HelioProfiler.h"
+#include <float.h>
 
 #define ROWS_OF_TWO_OCTAVES 24
 #define DEFAULT_NOTE_LENGTH 0.25f
 #define DEFAULT_NOTE_VELOCITY 0.25f
 
+//===----------------------------------------------------------------------===//
+// Notes density map
+//===----------------------------------------------------------------------===//
+
+// A multi-resolution summary of all notes, shown when zoomed out too far
+// for the note components to make sense: every level is an image with a column
+// per time cell and a row per key, and each next level has cells twice as long,
+// so that painting at any zoom level is just drawing one of the levels
+// scaled up by a factor between 1 and 2
+class PianoRoll::NotesDensityMap final
+{
+public:
+
+    NotesDensityMap() :
+        isOutdated(true),
+        startBeat(0.f),
+        baseCellLength(minCellLength) {}
+
+    void invalidate() noexcept
+    {
+        this->isOutdated = true;
+    }
+
+    void rebuildIfNeeded(const Array<MidiTrack *> &tracks,
+        const Array<MidiSequence *> &activeLayers, int numRows)
+    {
+        if (!this->isOutdated)
+        { return; }
+
+        this->isOutdated = false;
+        this->levels.clearQuick();
+
+        float firstBeat = FLT_MAX;
+        float lastBeat = -FLT_MAX;
+        for (const auto track : tracks)
+        {
+            if (auto sequence = dynamic_cast<PianoSequence *>(track->getSequence()))
+            {
+                for (int i = 0; i < sequence->size(); ++i)
+                {
+                    const auto note = static_cast<Note *>(sequence->getUnchecked(i));
+                    firstBeat = jmin(firstBeat, note->getBeat());
+                    lastBeat = jmax(lastBeat, note->getBeat() + note->getLength());
+                }
+            }
+        }
+
+        if (firstBeat >= lastBeat)
+        { return; }
+
+        this->startBeat = floorf(firstBeat);
+        this->baseCellLength = minCellLength;
+        while ((lastBeat - this->startBeat) / this->baseCellLength > float(maxBaseLevelCells))
+        {
+            this->baseCellLength *= 2.f;
+        }
+
+        const int numCells = jmax(1, int(ceilf((lastBeat - this->startBeat) / this->baseCellLength)));
+        Image baseLevel(Image::ARGB, numCells, numRows, true);
+
+        {
+            const Image::BitmapData data(baseLevel, Image::BitmapData::readWrite);
+
+            for (const auto track : tracks)
+            {
+                if (auto sequence = dynamic_cast<PianoSequence *>(track->getSequence()))
+                {
+                    const float alpha = activeLayers.contains(sequence) ? 1.f : 0.35f;
+
+                    for (int i = 0; i < sequence->size(); ++i)
+                    {
+                        const auto note = static_cast<Note *>(sequence->getUnchecked(i));
+                        const int row = numRows - 1 - note->getKey();
+                        if (row < 0 || row >= numRows)
+                        { continue; }
+
+                        const Colour colour(Colours::white.interpolatedWith(note->getColour(), 0.5f));
+                        const float noteStart = (note->getBeat() - this->startBeat) / this->baseCellLength;
+                        const float noteEnd = noteStart + note->getLength() / this->baseCellLength;
+
+                        // Short notes only partially cover their cell, and so they are more transparent
+                        for (int cell = int(noteStart); cell < numCells && float(cell) < noteEnd; ++cell)
+                        {
+                            const float coverage = jmin(noteEnd, float(cell + 1)) - jmax(noteStart, float(cell));
+                            auto *pixel = reinterpret_cast<PixelARGB *>(data.getPixelPointer(cell, row));
+                            pixel->blend(colour.withMultipliedAlpha(coverage * alpha).getPixelARGB());
+                        }
+                    }
+                }
+            }
+        }
+
+        this->levels.add(baseLevel);
+
+        while (this->levels.getLast().getWidth() > minLevelCells)
+        {
+            const Image &previousLevel = this->levels.getLast();
+            const int previousWidth = previousLevel.getWidth();
+            Image nextLevel(Image::ARGB, (previousWidth + 1) / 2, numRows, true);
+
+            {
+                const Image::BitmapData source(previousLevel, Image::BitmapData::readOnly);
+                const Image::BitmapData destination(nextLevel, Image::BitmapData::writeOnly);
+
+                for (int y = 0; y < numRows; ++y)
+                {
+                    for (int x = 0; x < nextLevel.getWidth(); ++x)
+                    {
+                        const auto a = *reinterpret_cast<const PixelARGB *>(source.getPixelPointer(x * 2, y));
+                        const PixelARGB b = (x * 2 + 1 < previousWidth) ?
+                            *reinterpret_cast<const PixelARGB *>(source.getPixelPointer(x * 2 + 1, y)) :
+                            PixelARGB(0, 0, 0, 0);
+
+                        reinterpret_cast<PixelARGB *>(destination.getPixelPointer(x, y))->setARGB(
+                            uint8((a.getAlpha() + b.getAlpha()) / 2),
+                            uint8((a.getRed() + b.getRed()) / 2),
+                            uint8((a.getGreen() + b.getGreen()) / 2),
+                            uint8((a.getBlue() + b.getBlue()) / 2));
+                    }
+                }
+            }
+
+            this->levels.add(nextLevel);
+        }
+    }
+
+    void paint(Graphics &g, float beatWidth, float zeroCanvasBeat, float topY, float rowHeight) const
+    {
+        if (this->levels.isEmpty())
+        { return; }
+
+        // Pick the most detailed level having cells at least a pixel wide
+        int level = 0;
+        float cellWidth = this->baseCellLength * beatWidth;
+        while (cellWidth < 1.f && level < (this->levels.size() - 1))
+        {
+            cellWidth *= 2.f;
+            level++;
+        }
+
+        const float x = (this->startBeat - zeroCanvasBeat) * beatWidth;
+
+        g.setImageResamplingQuality(Graphics::lowResamplingQuality);
+        g.drawImageTransformed(this->levels.getReference(level),
+            AffineTransform::scale(cellWidth, rowHeight).translated(x, topY));
+    }
+
+private:
+
+    static constexpr float minCellLength = 0.25f;
+    static const int maxBaseLevelCells = 4096;
+    static const int minLevelCells = 16;
+
+    bool isOutdated;
+    float startBeat;
+    float baseCellLength;
+
+    Array<Image> levels;
+
+    JUCE_DECLARE_NON_COPYABLE(NotesDensityMap)
+};
+
+
 PianoRoll::PianoRoll(ProjectTreeItem &parentProject,
                      Viewport &viewportRef,
                      WeakReference<AudioMonitor> clippingDetector) :
@@ -66,10 +231,13 @@ PianoRoll::PianoRoll(ProjectTreeItem &parentProject,
     rowHeight(MIN_ROW_HEIGHT),
     draggingNote(nullptr),
     addNewNoteMode(false),
-    mouseDownWasTriggered(false)
+    mouseDownWasTriggered(false),
+    showsDensityMap(false)
 {
     this->setComponentID(ComponentIDs::pianoRollId);
 
+    this->densityMap = new NotesDensityMap();
+
     this->setRowHeight(MIN_ROW_HEIGHT + 5);
 
     //this->helperVertical = new HelperRectangleVertical();
@@ -99,40 +267,38 @@ void PianoRoll::deleteSelection()
     // Avoids crash
     this->hideAllGhostNotes();
 
-    // раскидать this->selection по массивам
-    OwnedArray< Array<Note> > selections;
+    // The selection is already grouped by tracks, so that only the notes are copied here
+    OwnedArray<Array<Note>> selections;
+    Array<PianoSequence *> sequences;
+
+    const Lasso::GroupedSelections &groups = this->selection.getGroupedSelections();
+    Lasso::GroupedSelections::Iterator groupsIterator(groups);
 
-    for (int i = 0; i < this->selection.getNumSelected(); ++i)
+    while (groupsIterator.next())
     {
-        const Note &note = this->selection.getItemAs<NoteComponent>(i)->getNote();
-        const MidiSequence *ownerLayer = note.getSequence();
-        Array<Note> *arrayToAddTo = nullptr;
+        SelectionProxyArray::Ptr trackSelection(groupsIterator.getValue());
+        const int numSelected = trackSelection->size();
 
-        for (int j = 0; j < selections.size(); ++j)
-        {
-            if (selections.getUnchecked(j)->size() > 0)
-            {
-                if (selections.getUnchecked(j)->getUnchecked(0).getSequence() == ownerLayer)
-                {
-                    arrayToAddTo = selections.getUnchecked(j);
-                }
-            }
-        }
+        auto notes = new Array<Note>();
+        notes->ensureStorageAllocated(numSelected);
 
-        if (arrayToAddTo == nullptr)
+        for (int i = 0; i < numSelected; ++i)
         {
-            arrayToAddTo = new Array<Note>();
-            selections.add(arrayToAddTo);
+            notes->add(trackSelection->getItemAs<NoteComponent>(i)->getNote());
         }
 
-        arrayToAddTo->add(note);
+        selections.add(notes);
+        sequences.add(static_cast<PianoSequence *>(notes->getReference(0).getSequence()));
     }
 
+    // Deselect everything at once, instead of doing it for each removed component
+    this->selection.deselectAll();
+
     bool didCheckpoint = false;
 
     for (int i = 0; i < selections.size(); ++i)
     {
-        PianoSequence *pianoLayer = static_cast<PianoSequence *>(selections.getUnchecked(i)->getUnchecked(0).getSequence());
+        PianoSequence *pianoLayer = sequences.getUnchecked(i);
 
         if (! didCheckpoint)
         {
@@ -177,13 +343,15 @@ void PianoRoll::reloadRollContent()
                 const bool belongsToActiveTrack = noteComponent->belongsToAnySequence(this->activeLayers);
                 noteComponent->setActive(belongsToActiveTrack, true);
 
-                this->addAndMakeVisible(noteComponent);
+                this->addChildComponent(noteComponent);
+                noteComponent->setVisible(!this->showsDensityMap);
             }
         }
     }
 
+    this->densityMap->invalidate();
     this->resized();
-    this->repaint(this->viewport.getViewArea());
+    this->scheduleRepaint();
 }
 
 void PianoRoll::setActiveMidiLayers(Array<MidiSequence *> newLayers, MidiSequence *primaryLayer)
@@ -213,8 +381,9 @@ void PianoRoll::setActiveMidiLayers(Array<MidiSequence *> newLayers, MidiSequenc
 
     this->activeLayers = newLayers;
     this->primaryActiveLayer = primaryLayer;
+    this->densityMap->invalidate();
     
-    this->repaint(this->viewport.getViewArea());
+    this->scheduleRepaint();
 }
 
 MidiSequence *PianoRoll::getPrimaryActiveMidiLayer() const noexcept
@@ -454,6 +623,7 @@ void PianoRoll::moveHelpers(const float deltaBeat, const int deltaKey)
 
 void PianoRoll::onChangeMidiEvent(const MidiEvent &oldEvent, const MidiEvent &newEvent)
 {
+    HELIO_PROFILE_SCOPE("PianoRoll::onChangeMidiEvent");
     HybridRoll::onChangeMidiEvent(oldEvent, newEvent);
     
     if (! dynamic_cast<const Note *>(&oldEvent)) { return; }
@@ -461,6 +631,8 @@ void PianoRoll::onChangeMidiEvent(const MidiEvent &oldEvent, const MidiEvent &ne
     const Note &note = static_cast<const Note &>(oldEvent);
     const Note &newNote = static_cast<const Note &>(newEvent);
 
+    this->densityMap->invalidate();
+
     if (NoteComponent *component = this->componentsHashTable[note])
     {
         //component->repaint(); // если делать так - будут дикие тормоза, поэтому:
@@ -474,14 +646,17 @@ void PianoRoll::onChangeMidiEvent(const MidiEvent &oldEvent, const MidiEvent &ne
 
 void PianoRoll::onAddMidiEvent(const MidiEvent &event)
 {
+    HELIO_PROFILE_SCOPE("PianoRoll::onAddMidiEvent");
     HybridRoll::onAddMidiEvent(event);
     
     if (! dynamic_cast<const Note *>(&event)) { return; }
 
     const Note &note = static_cast<const Note &>(event);
 
+    this->densityMap->invalidate();
+
     auto component = new NoteComponent(*this, note);
-    this->addAndMakeVisible(component);
+    this->addChildComponent(component);
 
     this->batchRepaintList.add(component);
     this->triggerAsyncUpdate();
@@ -490,7 +665,10 @@ void PianoRoll::onAddMidiEvent(const MidiEvent &event)
 
     component->toFront(false);
 
-    this->fader.fadeIn(component, 150);
+    if (!this->showsDensityMap)
+    {
+        this->fader.fadeIn(component, 150);
+    }
 
     this->eventComponents.add(component);
     this->selectEvent(component, false); // selectEvent(component, true)
@@ -510,12 +688,15 @@ void PianoRoll::onAddMidiEvent(const MidiEvent &event)
 
 void PianoRoll::onRemoveMidiEvent(const MidiEvent &event)
 {
+    HELIO_PROFILE_SCOPE("PianoRoll::onRemoveMidiEvent");
     HybridRoll::onRemoveMidiEvent(event);
 
     if (! dynamic_cast<const Note *>(&event)) { return; }
     
     const Note &note = static_cast<const Note &>(event);
 
+    this->densityMap->invalidate();
+
     if (NoteComponent *component = this->componentsHashTable[note])
     {
         this->fader.fadeOut(component, 150);
@@ -528,16 +709,152 @@ void PianoRoll::onRemoveMidiEvent(const MidiEvent &event)
     }
 }
 
+// Groups of notes are handled in a single pass:
+// the density map is invalidated and the async update is triggered once per group
+
+void PianoRoll::onAddMidiEvents(const Array<const MidiEvent *> &events)
+{
+    if (events.size() == 0) { return; }
+
+    if (! dynamic_cast<const Note *>(events.getFirst()))
+    {
+        HybridRoll::onAddMidiEvents(events);
+        return;
+    }
+
+    HELIO_PROFILE_SCOPE("PianoRoll::onAddMidiEvents");
+    const ScopedBatchUpdate batch(*this);
+
+    this->densityMap->invalidate();
+    this->eventComponents.ensureStorageAllocated(this->eventComponents.size() + events.size());
+
+    for (const auto event : events)
+    {
+        const Note &note = static_cast<const Note &>(*event);
+
+        // added on top of the other children, no need to call toFront()
+        auto component = new NoteComponent(*this, note);
+        this->addChildComponent(component);
+        this->batchRepaintList.add(component);
+
+        if (!this->showsDensityMap)
+        {
+            this->fader.fadeIn(component, 150);
+        }
+
+        this->eventComponents.add(component);
+        this->selection.addToSelection(component);
+
+        component->setActive(component->belongsToAnySequence(this->activeLayers));
+        this->componentsHashTable.set(note, component);
+    }
+
+    this->triggerAsyncUpdate();
+}
+
+void PianoRoll::onChangeMidiEvents(const Array<const MidiEvent *> &oldEvents,
+                                   const Array<const MidiEvent *> &newEvents)
+{
+    jassert(oldEvents.size() == newEvents.size());
+    if (oldEvents.size() == 0) { return; }
+
+    if (! dynamic_cast<const Note *>(oldEvents.getFirst()))
+    {
+        HybridRoll::onChangeMidiEvents(oldEvents, newEvents);
+        return;
+    }
+
+    HELIO_PROFILE_SCOPE("PianoRoll::onChangeMidiEvents");
+    const ScopedBatchUpdate batch(*this);
+
+    this->densityMap->invalidate();
+
+    for (int i = 0; i < oldEvents.size(); ++i)
+    {
+        const Note &note = static_cast<const Note &>(*oldEvents.getUnchecked(i));
+        const Note &newNote = static_cast<const Note &>(*newEvents.getUnchecked(i));
+
+        if (NoteComponent *component = this->componentsHashTable[note])
+        {
+            this->batchRepaintList.add(component);
+            this->componentsHashTable.remove(note);
+            this->componentsHashTable.set(newNote, component);
+        }
+    }
+
+    this->triggerAsyncUpdate();
+}
+
+void PianoRoll::onRemoveMidiEvents(const Array<const MidiEvent *> &events)
+{
+    if (events.size() == 0) { return; }
+
+    if (! dynamic_cast<const Note *>(events.getFirst()))
+    {
+        HybridRoll::onRemoveMidiEvents(events);
+        return;
+    }
+
+    HELIO_PROFILE_SCOPE("PianoRoll::onRemoveMidiEvents");
+    const ScopedBatchUpdate batch(*this);
+
+    this->densityMap->invalidate();
+
+    Array<HybridRollEventComponent *> removedComponents;
+    removedComponents.ensureStorageAllocated(events.size());
+
+    for (const auto event : events)
+    {
+        const Note &note = static_cast<const Note &>(*event);
+
+        if (NoteComponent *component = this->componentsHashTable[note])
+        {
+            this->fader.fadeOut(component, 150);
+            this->selection.deselect(component);
+            this->removeChildComponent(component);
+            this->componentsHashTable.remove(note);
+            removedComponents.add(component);
+        }
+    }
+
+    if (removedComponents.size() == 0) { return; }
+
+    // compact the components array in a single pass instead of searching it for each note
+    std::sort(removedComponents.begin(), removedComponents.end());
+
+    int numKeptComponents = 0;
+    for (int i = 0; i < this->eventComponents.size(); ++i)
+    {
+        HybridRollEventComponent *component = this->eventComponents.getUnchecked(i);
+
+        if (std::binary_search(removedComponents.begin(), removedComponents.end(), component))
+        {
+            delete component;
+        }
+        else
+        {
+            this->eventComponents.set(numKeptComponents++, component, false);
+        }
+    }
+
+    this->eventComponents.removeLast(this->eventComponents.size() - numKeptComponents, false);
+}
+
 void PianoRoll::onChangeTrackProperties(MidiTrack *const track)
 {
     if (auto sequence = dynamic_cast<const PianoSequence *>(track->getSequence()))
     {
-        this->repaint();
+        this->densityMap->invalidate();
+        this->scheduleRepaint();
     }
 }
 
 void PianoRoll::onResetTrackContent(MidiTrack *const track)
 {
+    HELIO_PROFILE_SCOPE("PianoRoll::onResetTrackContent");
+    // Might be the time signatures track
+    this->invalidateVisibleBeatLines();
+
     if (auto sequence = dynamic_cast<const PianoSequence *>(track->getSequence()))
     {
         this->reloadRollContent();
@@ -581,29 +898,20 @@ void PianoRoll::onRemoveTrack(MidiTrack *const track)
 
 void PianoRoll::findLassoItemsInArea(Array<SelectableComponent *> &itemsFound, const Rectangle<int> &rectangle)
 {
-    bool shouldInvalidateSelectionCache = false;
-
     for (int i = 0; i < this->eventComponents.size(); ++i)
     {
         NoteComponent *note = static_cast<NoteComponent *>(this->eventComponents.getUnchecked(i));
-        note->setSelected(this->selection.isSelected(note));
-    }
 
-    for (int i = 0; i < this->eventComponents.size(); ++i)
-    {
-        NoteComponent *note = static_cast<NoteComponent *>(this->eventComponents.getUnchecked(i));
+        // Hidden components are not laid out when showing the density map
+        const Rectangle<int> noteBounds = this->showsDensityMap ?
+            this->getEventBounds(note).getSmallestIntegerContainer() : note->getBounds();
 
-        if (rectangle.intersects(note->getBounds()) && note->isActive())
+        // Each component is only visited once, so there's no need to check for duplicates
+        if (rectangle.intersects(noteBounds) && note->isActive())
         {
-            shouldInvalidateSelectionCache = true;
-            itemsFound.addIfNotAlreadyThere(note);
+            itemsFound.add(note);
         }
     }
-
-    if (shouldInvalidateSelectionCache)
-    {
-        this->selection.invalidateCache();
-    }
 }
 
 
@@ -1116,6 +1424,7 @@ void PianoRoll::handleCommandMessage(int commandId)
 
 void PianoRoll::resized()
 {
+    HELIO_PROFILE_SCOPE("PianoRoll::resized");
     if (!this->isShowing())
     {
         return;
@@ -1123,10 +1432,15 @@ void PianoRoll::resized()
 
     HYBRID_ROLL_BULK_REPAINT_START
 
-    for (int i = 0; i < this->eventComponents.size(); ++i)
+    this->updateLevelOfDetail();
+
+    if (!this->showsDensityMap)
     {
-        NoteComponent *note = static_cast<NoteComponent *>(this->eventComponents.getUnchecked(i));
-        note->setFloatBounds(this->getEventBounds(note));
+        for (int i = 0; i < this->eventComponents.size(); ++i)
+        {
+            NoteComponent *note = static_cast<NoteComponent *>(this->eventComponents.getUnchecked(i));
+            note->setFloatBounds(this->getEventBounds(note));
+        }
     }
 
     HybridRoll::resized();
@@ -1136,65 +1450,96 @@ void PianoRoll::resized()
 
 void PianoRoll::paint(Graphics &g)
 {
-#if PIANOROLL_HAS_PRERENDERED_BACKGROUND
+    HELIO_PROFILE_SCOPE("PianoRoll::paint");
 
-    g.setTiledImageFill(*(static_cast<HelioTheme &>(this->getLookAndFeel()).getRollBgCache()[this->rowHeight]), 0, 0, 1.f);
-    g.fillRect(this->viewport.getViewArea());
+#if PIANOROLL_HAS_PRERENDERED_BACKGROUND
+    const CachedImage::Ptr rowsPattern =
+        static_cast<HelioTheme &>(this->getLookAndFeel()).getRollBgCache(this->rowHeight);
 
-#else
+    if (rowsPattern != nullptr)
+    {
+        g.setTiledImageFill(*rowsPattern, 0, 0, 1.f);
+        g.fillRect(this->viewport.getViewArea());
+    }
+    else
+#endif
+    {
+        const Colour blackKey = this->findColour(HybridRoll::blackKeyColourId);
+        const Colour blackKeyBright = this->findColour(HybridRoll::blackKeyBrightColourId);
+        const Colour whiteKey = this->findColour(HybridRoll::whiteKeyColourId);
+        const Colour whiteKeyBright = this->findColour(HybridRoll::whiteKeyBrightColourId);
+        const Colour whiteKeyBrighter = whiteKeyBright.brighter(0.025f);
+        const Colour rowLine = this->findColour(HybridRoll::rowLineColourId);
 
-    const Colour blackKey = this->findColour(HybridRoll::blackKeyColourId);
-    const Colour blackKeyBright = this->findColour(HybridRoll::blackKeyBrightColourId);
-    const Colour whiteKey = this->findColour(HybridRoll::whiteKeyColourId);
-    const Colour whiteKeyBright = this->findColour(HybridRoll::whiteKeyBrightColourId);
-    const Colour whiteKeyBrighter = whiteKeyBright.brighter(0.025f);
-    const Colour rowLine = this->findColour(HybridRoll::rowLineColourId);
+        const float visibleWidth = float(this->viewport.getViewWidth());
+        const float visibleHeight = float(this->viewport.getViewHeight());
+        const Point<int> &viewPosition = this->viewport.getViewPosition();
 
-    const float visibleWidth = float(this->viewport.getViewWidth());
-    const float visibleHeight = float(this->viewport.getViewHeight());
-    const Point<int> &viewPosition = this->viewport.getViewPosition();
+        const int keyStart = int(viewPosition.getY() / this->rowHeight);
+        const int keyEnd = int((viewPosition.getY() + visibleHeight) / this->rowHeight);
 
-    const int keyStart = int(viewPosition.getY() / this->rowHeight);
-    const int keyEnd = int((viewPosition.getY() + visibleHeight) / this->rowHeight);
+        // Fill everything with white keys color
+        g.setColour(whiteKeyBright);
+        g.fillRect(float(viewPosition.getX()), float(viewPosition.getY()), visibleWidth, visibleHeight);
 
-    // Fill everything with white keys color
-    g.setColour(whiteKeyBright);
-    g.fillRect(float(viewPosition.getX()), float(viewPosition.getY()), visibleWidth, visibleHeight);
+        for (int i = keyStart; i <= keyEnd; i++)
+        {
+            const int lastOctaveReminder = 4;
+            const int yPos = HYBRID_ROLL_HEADER_HEIGHT + i * this->rowHeight;
+            const int noteNumber = (i + lastOctaveReminder) % 12;
+            const int octaveNumber = (i + lastOctaveReminder) / 12;
+            const bool octaveIsOdd = ((octaveNumber % 2) > 0);
 
-    for (int i = keyStart; i <= keyEnd; i++)
-    {
-        const int lastOctaveReminder = 4;
-        const int yPos = HYBRID_ROLL_HEADER_HEIGHT + i * this->rowHeight;
-        const int noteNumber = (i + lastOctaveReminder) % 12;
-        const int octaveNumber = (i + lastOctaveReminder) / 12;
-        const bool octaveIsOdd = ((octaveNumber % 2) > 0);
+            switch (noteNumber)
+            {
+                case 1:
+                case 3:
+                case 5:
+                case 8:
+                case 10: // black keys
+                    g.setColour(octaveIsOdd ? blackKeyBright : blackKey);
+                    g.fillRect(float(viewPosition.getX()), float(yPos), visibleWidth, float(this->rowHeight));
+                    break;
+
+                default: // white keys bevel
+                    g.setColour(whiteKeyBrighter);
+                    g.drawHorizontalLine(yPos + 1, float(viewPosition.getX()), float(viewPosition.getX() + visibleWidth));
+                    break;
+            }
 
-        switch (noteNumber)
-        {
-            case 1:
-            case 3:
-            case 5:
-            case 8:
-            case 10: // black keys
-                g.setColour(octaveIsOdd ? blackKeyBright : blackKey);
-                g.fillRect(float(viewPosition.getX()), float(yPos), visibleWidth, float(this->rowHeight));
-                break;
-
-            default: // white keys bevel
-                g.setColour(whiteKeyBrighter);
-                g.drawHorizontalLine(yPos + 1, float(viewPosition.getX()), float(viewPosition.getX() + visibleWidth));
-                break;
+            g.setColour(rowLine);
+            g.drawHorizontalLine(yPos, float(viewPosition.getX()), float(viewPosition.getX() + visibleWidth));
         }
 
-        g.setColour(rowLine);
-        g.drawHorizontalLine(yPos, float(viewPosition.getX()), float(viewPosition.getX() + visibleWidth));
+        HelioTheme::drawNoiseWithin(this->viewport.getViewArea().toFloat(), this, g, 2.0);
     }
 
-    HelioTheme::drawNoiseWithin(this->viewport.getViewArea().toFloat(), this, g, 2.0);
+    HybridRoll::paint(g);
 
-#endif
+    if (this->showsDensityMap)
+    {
+        this->densityMap->rebuildIfNeeded(this->project.getTracks(), this->activeLayers, this->numRows);
+        this->densityMap->paint(g, this->barWidth / float(NUM_BEATS_IN_BAR),
+            float(this->firstBar * NUM_BEATS_IN_BAR),
+            float(this->getYPositionByKey(this->numRows - 1)),
+            float(this->rowHeight));
+    }
+}
 
-    HybridRoll::paint(g);
+void PianoRoll::updateLevelOfDetail()
+{
+    const bool shouldShowDensityMap = (this->barWidth < PIANOROLL_MIN_DETAILED_BAR_WIDTH);
+    if (this->showsDensityMap == shouldShowDensityMap)
+    { return; }
+
+    this->showsDensityMap = shouldShowDensityMap;
+
+    for (int i = 0; i < this->eventComponents.size(); ++i)
+    {
+        this->eventComponents.getUnchecked(i)->setVisible(!shouldShowDensityMap);
+    }
+
+    this->scheduleRepaint();
 }
 
 void PianoRoll::insertNewNoteAt(const MouseEvent &e)
@@ -1217,6 +1562,7 @@ void PianoRoll::insertNewNoteAt(const MouseEvent &e)
 
 void PianoRoll::handleAsyncUpdate()
 {
+    HELIO_PROFILE_SCOPE("PianoRoll::handleAsyncUpdate");
 #if PIANOROLL_HAS_NOTE_RESIZERS
     // resizers for the mobile version
     if (this->selection.getNumSelected() > 0 &&
@@ -1263,6 +1609,7 @@ void PianoRoll::handleAsyncUpdate()
 
 void PianoRoll::updateChildrenBounds()
 {
+    HELIO_PROFILE_SCOPE("PianoRoll::updateChildrenBounds");
 #if PIANOROLL_HAS_NOTE_RESIZERS
     if (this->noteResizerLeft != nullptr)
     {
@@ -1349,17 +1696,6 @@ void PianoRoll::reset()
 // Bg images cache
 //===----------------------------------------------------------------------===//
 
-void PianoRoll::repaintBackgroundsCache(HelioTheme &theme)
-{
-    theme.getRollBgCache().clear();
-
-    for (int i = MIN_ROW_HEIGHT; i <= MAX_ROW_HEIGHT; ++i)
-    {
-        CachedImage::Ptr pattern(PianoRoll::renderRowsPattern(theme, i));
-        theme.getRollBgCache().set(i, pattern);
-    }
-}
-
 CachedImage::Ptr PianoRoll::renderRowsPattern(HelioTheme &theme, int height)
 {
     CachedImage::Ptr patternImage(new CachedImage(Image::RGB, 128, height * ROWS_OF_TWO_OCTAVES, false));
@@ -43,6 +43,10 @@
 #   endif
 #endif
 
+// Below this bar width individual notes are not distinguishable anyway,
+// so the roll hides note components and shows a notes density map instead
+#define PIANOROLL_MIN_DETAILED_BAR_WIDTH (32)
+
 class MidiSequence;
 class NoteComponent;
 class PianoRollReboundThread;
@@ -59,7 +63,6 @@ class PianoRoll : public HybridRoll
 {
 public:
 
-    static void repaintBackgroundsCache(HelioTheme &theme);
     static CachedImage::Ptr renderRowsPattern(HelioTheme &theme, int height);
     
 public:
@@ -138,6 +141,10 @@ public:
     void onChangeMidiEvent(const MidiEvent &oldEvent, const MidiEvent &newEvent) override;
     void onAddMidiEvent(const MidiEvent &event) override;
     void onRemoveMidiEvent(const MidiEvent &event) override;
+    void onAddMidiEvents(const Array<const MidiEvent *> &events) override;
+    void onChangeMidiEvents(const Array<const MidiEvent *> &oldEvents,
+                            const Array<const MidiEvent *> &newEvents) override;
+    void onRemoveMidiEvents(const Array<const MidiEvent *> &events) override;
 
     void onAddTrack(MidiTrack *const track) override;
     void onRemoveTrack(MidiTrack *const track) override;
@@ -228,4 +235,12 @@ private:
     
     HashMap<Note, NoteComponent *, NoteHashFunction> componentsHashTable;
 
+private:
+
+    class NotesDensityMap;
+    ScopedPointer<NotesDensityMap> densityMap;
+    bool showsDensityMap;
+
+    void updateLevelOfDetail();
+
 };
@@ -32,6 +32,7 @@
 #include "Transport.h"
 #include <float.h>
 #include <math.h>
+#include <set>
 
 #if !defined M_PI
 #define M_PI 3.14159265358979323846f
@@ -63,24 +64,32 @@ typedef HashMap< String, AutoChangeGroupProxy::Ptr > AutoChangeGroupsPerLayer;
 template< typename TEvent, typename TGroup, typename TGroups >
 void splitChangeGroupByLayers(const TGroup &group, TGroups &outGroups)
 {
+    // events of the same track usually come in a row,
+    // so the map is only looked up when the track changes
+    const MidiSequence *lastSequence = nullptr;
+    typename ChangeGroupProxy<TGroup>::Ptr targetArray;
+
     for (int i = 0; i < group.size(); ++i)
     {
-        const TEvent &note = group.getUnchecked(i);
-        const String &trackId(note.getSequence()->getTrackId());
-        
-        typename ChangeGroupProxy<TGroup>::Ptr targetArray;
+        const TEvent &note = group.getReference(i);
         
-        if (outGroups.contains(trackId))
-        {
-            targetArray = outGroups[trackId];
-        }
-        else
+        if (note.getSequence() != lastSequence)
         {
-            targetArray = new ChangeGroupProxy<TGroup>();
+            lastSequence = note.getSequence();
+            const String &trackId(lastSequence->getTrackId());
+
+            if (outGroups.contains(trackId))
+            {
+                targetArray = outGroups[trackId];
+            }
+            else
+            {
+                targetArray = new ChangeGroupProxy<TGroup>();
+                outGroups.set(trackId, targetArray);
+            }
         }
         
         targetArray->add(note);
-        outGroups.set(trackId, targetArray);
     }
 }
 
@@ -660,6 +669,479 @@ void PianoRollToolbox::shiftEventsToTheRight(Array<MidiTrack *> tracks, float ta
 }
 
 
+//===----------------------------------------------------------------------===//
+// Sweep-line helpers
+//===----------------------------------------------------------------------===//
+
+// All the overlap-related tools below only compare notes of the same key,
+// so the selection is sorted once by key and beat, and each key run is swept
+// from left to right instead of comparing every note with every other note.
+// The results are collected per selection index and emitted in the selection
+// order, exactly like the old quadratic loops did.
+
+struct SweepNote
+{
+    int index; // in selection
+    int key;
+    float beat;
+    float end;
+};
+
+class SweepNoteComparator
+{
+public:
+    static int compareElements(const SweepNote &first, const SweepNote &second)
+    {
+        if (first.key != second.key) { return (first.key < second.key) ? -1 : 1; }
+        if (first.beat != second.beat) { return (first.beat < second.beat) ? -1 : 1; }
+        return (first.index < second.index) ? -1 : ((first.index > second.index) ? 1 : 0);
+    }
+};
+
+static Array<SweepNote> sortedByKeyAndBeat(const Array<SweepNote> &selectionNotes)
+{
+    Array<SweepNote> result(selectionNotes);
+    SweepNoteComparator comparator;
+    result.sort(comparator);
+    return result;
+}
+
+// calls callback(runStart, runEnd) for each range of notes with the same key
+template <typename Callback>
+static void forEachKeyRun(const Array<SweepNote> &notes, Callback callback)
+{
+    int runStart = 0;
+
+    while (runStart < notes.size())
+    {
+        int runEnd = runStart + 1;
+
+        while (runEnd < notes.size() &&
+            notes.getReference(runEnd).key == notes.getReference(runStart).key)
+        {
+            ++runEnd;
+        }
+
+        callback(runStart, runEnd);
+        runStart = runEnd;
+    }
+}
+
+// calls callback(groupStart, groupEnd) for each range of notes with the same beat
+template <typename Callback>
+static void forEachBeatGroup(const Array<SweepNote> &notes, int runStart, int runEnd, Callback callback)
+{
+    int groupStart = runStart;
+
+    while (groupStart < runEnd)
+    {
+        int groupEnd = groupStart + 1;
+
+        while (groupEnd < runEnd &&
+            notes.getReference(groupEnd).beat == notes.getReference(groupStart).beat)
+        {
+            ++groupEnd;
+        }
+
+        callback(groupStart, groupEnd);
+        groupStart = groupEnd;
+    }
+}
+
+// Step 1 of removeOverlaps: for each note, how much should it be extended
+// to end together with the longest note of the same key that starts strictly before
+// and ends after it (-FLT_MAX if there is no such note)
+static Array<float> findEnclosingNoteDeltas(const Array<SweepNote> &selectionNotes)
+{
+    const Array<SweepNote> notes(sortedByKeyAndBeat(selectionNotes));
+    Array<float> deltas;
+    deltas.insertMultiple(0, -FLT_MAX, selectionNotes.size());
+
+    forEachKeyRun(notes, [&](int runStart, int runEnd)
+    {
+        float maxEndBefore = -FLT_MAX;
+        bool hasNotesBefore = false;
+
+        forEachBeatGroup(notes, runStart, runEnd, [&](int groupStart, int groupEnd)
+        {
+            for (int g = groupStart; g < groupEnd && hasNotesBefore; ++g)
+            {
+                const SweepNote &nc = notes.getReference(g);
+
+                if (nc.end < maxEndBefore)
+                {
+                    deltas.set(nc.index, maxEndBefore - nc.end);
+                }
+            }
+
+            for (int g = groupStart; g < groupEnd; ++g)
+            {
+                maxEndBefore = jmax(maxEndBefore, notes.getReference(g).end);
+                hasNotesBefore = true;
+            }
+        });
+    });
+
+    return deltas;
+}
+
+// Step 2 of removeOverlaps: for each note, the note of the same key that starts before it
+// and ends inside it, with the minimal end (the first one in selection, if several),
+// and how much should that one be extended (-1 as the index if there is no such note)
+static Array<int> findNotesEndingInside(const Array<SweepNote> &selectionNotes, Array<float> &deltas)
+{
+    const Array<SweepNote> notes(sortedByKeyAndBeat(selectionNotes));
+    Array<int> overlappingNotes;
+    overlappingNotes.insertMultiple(0, -1, selectionNotes.size());
+    deltas.clearQuick();
+    deltas.insertMultiple(0, 0.f, selectionNotes.size());
+
+    forEachKeyRun(notes, [&](int runStart, int runEnd)
+    {
+        std::set<std::pair<float, int>> activeEnds; // end : selection index
+
+        forEachBeatGroup(notes, runStart, runEnd, [&](int groupStart, int groupEnd)
+        {
+            const float groupBeat = notes.getReference(groupStart).beat;
+
+            while (! activeEnds.empty() && activeEnds.begin()->first <= groupBeat)
+            {
+                activeEnds.erase(activeEnds.begin());
+            }
+
+            if (! activeEnds.empty())
+            {
+                const auto &shortest = *activeEnds.begin();
+
+                for (int g = groupStart; g < groupEnd; ++g)
+                {
+                    const SweepNote &nc = notes.getReference(g);
+
+                    if (nc.end > shortest.first)
+                    {
+                        overlappingNotes.set(nc.index, shortest.second);
+                        deltas.set(nc.index, nc.end - shortest.first);
+                    }
+                }
+            }
+
+            for (int g = groupStart; g < groupEnd; ++g)
+            {
+                activeEnds.insert({ notes.getReference(g).end, notes.getReference(g).index });
+            }
+        });
+    });
+
+    return overlappingNotes;
+}
+
+// Step 3 of removeOverlaps: for each note, how much does it overlap with the note
+// of the same key that starts later and ends not later than it, with the minimal beat
+// (-FLT_MAX if there is no such note).
+// Queries and notes go in the order of their ends, so the set always contains
+// only the notes that end not later than the current one
+static Array<float> findLaterNoteOverlaps(const Array<SweepNote> &selectionNotes)
+{
+    const Array<SweepNote> notes(sortedByKeyAndBeat(selectionNotes));
+    Array<float> overlaps;
+    overlaps.insertMultiple(0, -FLT_MAX, selectionNotes.size());
+
+    forEachKeyRun(notes, [&](int runStart, int runEnd)
+    {
+        Array<SweepNote> byEnd;
+
+        for (int n = runStart; n < runEnd; ++n)
+        {
+            byEnd.add(notes.getReference(n));
+        }
+
+        std::sort(byEnd.begin(), byEnd.end(),
+            [](const SweepNote &a, const SweepNote &b) { return a.end < b.end; });
+
+        std::multiset<float> startedBeats;
+        int inserted = 0;
+
+        for (const auto &nc : byEnd)
+        {
+            while (inserted < byEnd.size() &&
+                byEnd.getReference(inserted).end <= nc.end)
+            {
+                startedBeats.insert(byEnd.getReference(inserted).beat);
+                ++inserted;
+            }
+
+            const auto firstLater = startedBeats.upper_bound(nc.beat);
+
+            if (firstLater != startedBeats.end())
+            {
+                // >0 : has overlap
+                overlaps.set(nc.index, nc.end - *firstLater);
+            }
+        }
+    });
+
+    return overlaps;
+}
+
+// The duplicates removal logic depends on the order of (i, j) pairs it visits,
+// but only the pairs of notes that start within each other can ever match,
+// so collect just those pairs with a sweep, sorted in the original order
+static Array<std::pair<int, int>> findDuplicatePairs(const Array<SweepNote> &selectionNotes,
+    bool partialOverlapsAlso)
+{
+    const Array<SweepNote> notes(sortedByKeyAndBeat(selectionNotes));
+    Array<std::pair<int, int>> matchingPairs;
+
+    forEachKeyRun(notes, [&](int runStart, int runEnd)
+    {
+        Array<int> activeNotes;
+
+        forEachBeatGroup(notes, runStart, runEnd, [&](int groupStart, int groupEnd)
+        {
+            const float groupBeat = notes.getReference(groupStart).beat;
+
+            // the notes that have ended before this beat can't match anything later
+            for (int a = activeNotes.size(); --a >= 0;)
+            {
+                if (notes.getReference(activeNotes.getUnchecked(a)).end < groupBeat)
+                {
+                    activeNotes.remove(a);
+                }
+            }
+
+            for (int g = groupStart; g < groupEnd; ++g)
+            {
+                activeNotes.add(g);
+            }
+
+            for (int g = groupStart; g < groupEnd; ++g)
+            {
+                const SweepNote &nc = notes.getReference(g);
+
+                for (const int a : activeNotes)
+                {
+                    const SweepNote &nc2 = notes.getReference(a);
+
+                    if (nc.index == nc2.index)
+                    {
+                        continue;
+                    }
+
+                    const bool isOverlappingNote = partialOverlapsAlso ?
+                        (nc.beat >= nc2.beat && nc.beat < nc2.end) :
+                        (nc.beat >= nc2.beat && nc.end <= nc2.end);
+
+                    const bool startsFromTheSameBeat = (nc.beat == nc2.beat);
+
+                    if (isOverlappingNote || startsFromTheSameBeat)
+                    {
+                        matchingPairs.add({ nc.index, nc2.index });
+                    }
+                }
+            }
+        });
+    });
+
+    std::sort(matchingPairs.begin(), matchingPairs.end());
+    return matchingPairs;
+}
+
+#if JUCE_DEBUG
+
+// The old quadratic loops, kept to check the sweeps against them
+
+static Array<float> findEnclosingNoteDeltasQuadratic(const Array<SweepNote> &notes)
+{
+    Array<float> deltas;
+
+    for (const auto &nc : notes)
+    {
+        float deltaBeats = -FLT_MAX;
+
+        for (const auto &nc2 : notes)
+        {
+            if (nc.key == nc2.key && nc.beat > nc2.beat && nc.end < nc2.end)
+            {
+                deltaBeats = jmax(deltaBeats, nc2.end - nc.end);
+            }
+        }
+
+        deltas.add(deltaBeats);
+    }
+
+    return deltas;
+}
+
+static Array<int> findNotesEndingInsideQuadratic(const Array<SweepNote> &notes, Array<float> &deltas)
+{
+    Array<int> overlappingNotes;
+    deltas.clearQuick();
+
+    for (const auto &nc : notes)
+    {
+        float deltaBeats = -FLT_MAX;
+        int overlappingNote = -1;
+
+        for (const auto &nc2 : notes)
+        {
+            if (nc.key == nc2.key && nc.beat > nc2.beat &&
+                nc.beat < nc2.end && nc.end > nc2.end &&
+                deltaBeats < (nc.end - nc2.end))
+            {
+                deltaBeats = nc.end - nc2.end;
+                overlappingNote = nc2.index;
+            }
+        }
+
+        overlappingNotes.add(overlappingNote);
+        deltas.add(overlappingNote >= 0 ? deltaBeats : 0.f);
+    }
+
+    return overlappingNotes;
+}
+
+static Array<float> findLaterNoteOverlapsQuadratic(const Array<SweepNote> &notes)
+{
+    Array<float> overlaps;
+
+    for (const auto &nc : notes)
+    {
+        float overlappingBeats = -FLT_MAX;
+
+        for (const auto &nc2 : notes)
+        {
+            if (nc.key == nc2.key && nc.beat < nc2.beat && nc.end >= nc2.end)
+            {
+                overlappingBeats = jmax(overlappingBeats, nc.end - nc2.beat);
+            }
+        }
+
+        overlaps.add(overlappingBeats);
+    }
+
+    return overlaps;
+}
+
+static Array<std::pair<int, int>> findDuplicatePairsQuadratic(const Array<SweepNote> &notes,
+    bool partialOverlapsAlso)
+{
+    Array<std::pair<int, int>> matchingPairs;
+
+    for (const auto &nc : notes)
+    {
+        for (const auto &nc2 : notes)
+        {
+            if (nc.index == nc2.index || nc.key != nc2.key)
+            {
+                continue;
+            }
+
+            const bool isOverlappingNote = partialOverlapsAlso ?
+                (nc.beat >= nc2.beat && nc.beat < nc2.end) :
+                (nc.beat >= nc2.beat && nc.end <= nc2.end);
+
+            if (isOverlappingNote || nc.beat == nc2.beat)
+            {
+                matchingPairs.add({ nc.index, nc2.index });
+            }
+        }
+    }
+
+    return matchingPairs;
+}
+
+// Runs both versions on randomized selections, dense enough
+// to have all kinds of overlaps and equal beats and ends
+static bool sweepsMatchQuadraticLoops()
+{
+    Random random(0x5EED);
+
+    for (int test = 0; test < 500; ++test)
+    {
+        Array<SweepNote> notes;
+        const int numNotes = random.nextInt(48);
+
+        for (int i = 0; i < numNotes; ++i)
+        {
+            const float beat = float(random.nextInt(32)) / 4.f;
+            const float length = float(1 + random.nextInt(16)) / 4.f;
+            notes.add({ i, random.nextInt(4), beat, beat + length });
+        }
+
+        if (findEnclosingNoteDeltas(notes) != findEnclosingNoteDeltasQuadratic(notes) ||
+            findLaterNoteOverlaps(notes) != findLaterNoteOverlapsQuadratic(notes) ||
+            findDuplicatePairs(notes, true) != findDuplicatePairsQuadratic(notes, true) ||
+            findDuplicatePairs(notes, false) != findDuplicatePairsQuadratic(notes, false))
+        {
+            return false;
+        }
+
+        Array<float> deltas, deltasQuadratic;
+        if (findNotesEndingInside(notes, deltas) != findNotesEndingInsideQuadratic(notes, deltasQuadratic) ||
+            deltas != deltasQuadratic)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+#endif
+
+static Array<SweepNote> getSelectionNotes(Lasso &selection)
+{
+#if JUCE_DEBUG
+    static const bool sweepsAreValid = sweepsMatchQuadraticLoops();
+    jassert(sweepsAreValid);
+#endif
+
+    Array<SweepNote> result;
+    result.ensureStorageAllocated(selection.getNumSelected());
+
+    for (int i = 0; i < selection.getNumSelected(); ++i)
+    {
+        const NoteComponent *nc = static_cast<NoteComponent *>(selection.getSelectedItem(i));
+        result.add({ i, nc->getKey(), nc->getBeat(), nc->getBeat() + nc->getLength() });
+    }
+
+    return result;
+}
+
+static void removeDuplicatesInSelection(Lasso &selection,
+    bool partialOverlapsAlso, bool &didCheckpoint, bool shouldCheckpoint)
+{
+    const Array<std::pair<int, int>> matchingPairs(
+        findDuplicatePairs(getSelectionNotes(selection), partialOverlapsAlso));
+
+    HashMap<MidiEvent::Id, Note> deferredRemoval;
+    HashMap<MidiEvent::Id, Note> unremovableNotes;
+
+    for (const auto &pair : matchingPairs)
+    {
+        const NoteComponent *nc = static_cast<NoteComponent *>(selection.getSelectedItem(pair.first));
+        const NoteComponent *nc2 = static_cast<NoteComponent *>(selection.getSelectedItem(pair.second));
+
+        const bool isOriginalNote = unremovableNotes.contains(nc2->getNote().getId());
+
+        if (! isOriginalNote)
+        {
+            unremovableNotes.set(nc->getNote().getId(), nc->getNote());
+            deferredRemoval.set(nc2->getNote().getId(), nc2->getNote());
+        }
+    }
+
+    PianoChangeGroup removalGroup;
+    HashMap<MidiEvent::Id, Note>::Iterator deferredRemovalIterator(deferredRemoval);
+    while (deferredRemovalIterator.next())
+    {
+        removalGroup.add(deferredRemovalIterator.getValue());
+    }
+
+    applyPianoRemovals(removalGroup, didCheckpoint, shouldCheckpoint);
+}
+
+
 void PianoRollToolbox::snapSelection(Lasso &selection, float snapsPerBeat, bool shouldCheckpoint)
 {
     if (selection.getNumSelected() == 0)
@@ -670,6 +1152,8 @@ void PianoRollToolbox::snapSelection(Lasso &selection, float snapsPerBeat, bool
     bool didCheckpoint = false;
     
     PianoChangeGroup groupBefore, groupAfter;
+    groupBefore.ensureStorageAllocated(selection.getNumSelected());
+    groupAfter.ensureStorageAllocated(selection.getNumSelected());
     
     for (int i = 0; i < selection.getNumSelected(); ++i)
     {
@@ -737,45 +1221,21 @@ void PianoRollToolbox::removeOverlaps(Lasso &selection, bool shouldCheckpoint)
     //    ---------
     // ------------
     
-    // todo repeat while does any changes
-    
     bool step1HasChanges = false;
     
     do
     {
         PianoChangeGroup group1Before, group1After;
         
+        // для каждой ноты найти ноту, которая полностью перекрывает ее на максимальную длину
+        const Array<float> deltas(findEnclosingNoteDeltas(getSelectionNotes(selection)));
+        
         for (int i = 0; i < selection.getNumSelected(); ++i)
         {
-            NoteComponent *nc = static_cast<NoteComponent *>(selection.getSelectedItem(i));
-            
-            // для каждой ноты найти ноту, которая полностью перекрывает ее на максимальную длину
-            
-            float deltaBeats = -FLT_MAX;
-            const Note *overlappingNote = nullptr;
-            
-            for (int j = 0; j < selection.getNumSelected(); ++j)
+            if (deltas.getUnchecked(i) != -FLT_MAX)
             {
-                NoteComponent *nc2 = static_cast<NoteComponent *>(selection.getSelectedItem(j));
-                
-                if (nc->getKey() == nc2->getKey() &&
-                    nc->getBeat() > nc2->getBeat() &&
-                    (nc->getBeat() + nc->getLength()) < (nc2->getBeat() + nc2->getLength()))
-                {
-                    const float currentDelta = (nc2->getBeat() + nc2->getLength()) - (nc->getBeat() + nc->getLength());
-                    
-                    if (deltaBeats < currentDelta)
-                    {
-                        deltaBeats = currentDelta;
-                        overlappingNote = &nc2->getNote();
-                    }
-                }
-            }
-            
-            if (overlappingNote != nullptr)
-            {
-                //Logger::writeToLog("edit1");
-                const float newLength = nc->getLength() + deltaBeats;
+                NoteComponent *nc = static_cast<NoteComponent *>(selection.getSelectedItem(i));
+                const float newLength = nc->getLength() + deltas.getUnchecked(i);
                 group1Before.add(nc->getNote());
                 group1After.add(nc->getNote().withLength(newLength));
             }
@@ -800,39 +1260,20 @@ void PianoRollToolbox::removeOverlaps(Lasso &selection, bool shouldCheckpoint)
         step2HasChanges = false;
         PianoChangeGroup group2Before, group2After;
         
+        // для каждой ноты найти ноту, которая начинается раньше и заканчивается внутри нее
+        Array<float> deltas;
+        const Array<int> overlappingNotes(findNotesEndingInside(getSelectionNotes(selection), deltas));
+        
         for (int i = 0; i < selection.getNumSelected(); ++i)
         {
-            NoteComponent *nc = static_cast<NoteComponent *>(selection.getSelectedItem(i));
-            
-            // для каждой ноты найти ноту, которая полностью перекрывает ее на максимальную длину
-            
-            float deltaBeats = -FLT_MAX;
-            const NoteComponent *overlappingNote = nullptr;
-            
-            for (int j = 0; j < selection.getNumSelected(); ++j)
+            if (overlappingNotes.getUnchecked(i) >= 0)
             {
-                NoteComponent *nc2 = static_cast<NoteComponent *>(selection.getSelectedItem(j));
+                const NoteComponent *overlappingNote =
+                    static_cast<NoteComponent *>(selection.getSelectedItem(overlappingNotes.getUnchecked(i)));
                 
-                if (nc->getKey() == nc2->getKey() &&
-                    nc->getBeat() > nc2->getBeat() &&
-                    nc->getBeat() < (nc2->getBeat() + nc2->getLength()) &&
-                    (nc->getBeat() + nc->getLength()) > (nc2->getBeat() + nc2->getLength()))
-                {
-                    const float currentDelta = (nc->getBeat() + nc->getLength()) - (nc2->getBeat() + nc2->getLength());
-                    
-                    if (deltaBeats < currentDelta)
-                    {
-                        deltaBeats = currentDelta;
-                        overlappingNote = nc2;
-                    }
-                }
-            }
-            
-            if (overlappingNote != nullptr)
-            {
                 //Logger::writeToLog("edit2");
                 group2Before.add(overlappingNote->getNote());
-                group2After.add(overlappingNote->getNote().withDeltaLength(deltaBeats));
+                group2After.add(overlappingNote->getNote().withDeltaLength(deltas.getUnchecked(i)));
             }
         }
         
@@ -855,37 +1296,15 @@ void PianoRollToolbox::removeOverlaps(Lasso &selection, bool shouldCheckpoint)
         step3HasChanges = false;
         PianoChangeGroup group3Before, group3After;
         
+        // для каждой ноты найти ноту, которая перекрывает ее максимально
+        const Array<float> overlaps(findLaterNoteOverlaps(getSelectionNotes(selection)));
+        
         for (int i = 0; i < selection.getNumSelected(); ++i)
         {
-            NoteComponent *nc = static_cast<NoteComponent *>(selection.getSelectedItem(i));
-            
-            // для каждой ноты найти ноту, которая перекрывает ее максимально
-            
-            float overlappingBeats = -FLT_MAX;
-            const NoteComponent *overlappingNote = nullptr;
-            
-            for (int j = 0; j < selection.getNumSelected(); ++j)
-            {
-                NoteComponent *nc2 = static_cast<NoteComponent *>(selection.getSelectedItem(j));
-                
-                if (nc->getKey() == nc2->getKey() &&
-                    nc->getBeat() < nc2->getBeat() &&
-                    (nc->getBeat() + nc->getLength()) >= (nc2->getBeat() + nc2->getLength()))
-                {
-                    // >0 : has overlap
-                    const float overlapsWith = (nc->getBeat() + nc->getLength()) - nc2->getBeat();
-                    
-                    if (overlapsWith > overlappingBeats)
-                    {
-                        overlappingBeats = overlapsWith;
-                        overlappingNote = nc2;
-                    }
-                }
-            }
-            
-            if (overlappingNote != nullptr)
+            if (overlaps.getUnchecked(i) != -FLT_MAX)
             {
-                const float newLength = nc->getLength() - overlappingBeats;
+                NoteComponent *nc = static_cast<NoteComponent *>(selection.getSelectedItem(i));
+                const float newLength = nc->getLength() - overlaps.getUnchecked(i);
                 //Logger::writeToLog("edit3 " + String(nc->getNote().getLength()) + ":" + String(newLength));
                 group3Before.add(nc->getNote());
                 group3After.add(nc->getNote().withLength(newLength));
@@ -897,56 +1316,8 @@ void PianoRollToolbox::removeOverlaps(Lasso &selection, bool shouldCheckpoint)
     while (step3HasChanges);
     
     
-    // remove duplicates
-    
-    HashMap<MidiEvent::Id, Note> deferredRemoval;
-    HashMap<MidiEvent::Id, Note> unremovableNotes;
-    
-    for (int i = 0; i < selection.getNumSelected(); ++i)
-    {
-        NoteComponent *nc = static_cast<NoteComponent *>(selection.getSelectedItem(i));
-        
-        for (int j = 0; j < selection.getNumSelected(); ++j)
-        {
-            if (i == j)
-            {
-                continue;
-            }
-            
-            NoteComponent *nc2 = static_cast<NoteComponent *>(selection.getSelectedItem(j));
-            
-            // full overlap
-            //const bool isOverlappingNote = (nc->getKey() == nc2->getKey() &&
-            //                                nc->getBeat() >= nc2->getBeat() &&
-            //                                (nc->getBeat() + nc->getLength()) <= (nc2->getBeat() + nc2->getLength()));
-
-            // partial overlaps also
-            const bool isOverlappingNote = (nc->getKey() == nc2->getKey() &&
-                                            nc->getBeat() >= nc2->getBeat() &&
-                                            nc->getBeat() < (nc2->getBeat() + nc2->getLength()));
-            
-            const bool startsFromTheSameBeat = (nc->getKey() == nc2->getKey() &&
-                                                nc->getBeat() == nc2->getBeat());
-            
-            const bool isOriginalNote = unremovableNotes.contains(nc2->getNote().getId());
-            
-            if (! isOriginalNote &&
-                (isOverlappingNote || startsFromTheSameBeat))
-            {
-                unremovableNotes.set(nc->getNote().getId(), nc->getNote());
-                deferredRemoval.set(nc2->getNote().getId(), nc2->getNote());
-            }
-        }
-    }
-    
-    PianoChangeGroup removalGroup;
-    HashMap<MidiEvent::Id, Note>::Iterator deferredRemovalIterator(deferredRemoval);
-    while (deferredRemovalIterator.next())
-    {
-        removalGroup.add(deferredRemovalIterator.getValue());
-    }
-
-    applyPianoRemovals(removalGroup, didCheckpoint, shouldCheckpoint);
+    // remove duplicates, partial overlaps also
+    removeDuplicatesInSelection(selection, true, didCheckpoint, shouldCheckpoint);
 }
 
 void PianoRollToolbox::removeDuplicates(Lasso &selection, bool shouldCheckpoint)
@@ -954,51 +1325,10 @@ void PianoRollToolbox::removeDuplicates(Lasso &selection, bool shouldCheckpoint)
     if (selection.getNumSelected() == 0)
     { return; }
     
-    HashMap<MidiEvent::Id, Note> deferredRemoval;
-    HashMap<MidiEvent::Id, Note> unremovableNotes;
-    
     bool didCheckpoint = false;
 
-    for (int i = 0; i < selection.getNumSelected(); ++i)
-    {
-        NoteComponent *nc = static_cast<NoteComponent *>(selection.getSelectedItem(i));
-        
-        for (int j = 0; j < selection.getNumSelected(); ++j)
-        {
-            if (i == j)
-            {
-                continue;
-            }
-            
-            NoteComponent *nc2 = static_cast<NoteComponent *>(selection.getSelectedItem(j));
-            
-            // full overlap
-            const bool isOverlappingNote = (nc->getKey() == nc2->getKey() &&
-                                            nc->getBeat() >= nc2->getBeat() &&
-                                            (nc->getBeat() + nc->getLength()) <= (nc2->getBeat() + nc2->getLength()));
-
-            const bool startsFromTheSameBeat = (nc->getKey() == nc2->getKey() &&
-                                                nc->getBeat() == nc2->getBeat());
-            
-            const bool isOriginalNote = unremovableNotes.contains(nc2->getNote().getId());
-
-            if (! isOriginalNote &&
-                (isOverlappingNote || startsFromTheSameBeat))
-            {
-                unremovableNotes.set(nc->getNote().getId(), nc->getNote());
-                deferredRemoval.set(nc2->getNote().getId(), nc2->getNote());
-            }
-        }
-    }
-    
-    PianoChangeGroup removalGroup;
-    HashMap<MidiEvent::Id, Note>::Iterator deferredRemovalIterator(deferredRemoval);
-    while (deferredRemovalIterator.next())
-    {
-        removalGroup.add(deferredRemovalIterator.getValue());
-    }
-    
-    applyPianoRemovals(removalGroup, didCheckpoint, shouldCheckpoint);
+    // full overlaps only
+    removeDuplicatesInSelection(selection, false, didCheckpoint, shouldCheckpoint);
 }
 
 
@@ -1346,6 +1676,8 @@ void PianoRollToolbox::randomizeVolume(Lasso &selection, float factor, bool shou
     Random random(Time::currentTimeMillis());
 
     PianoChangeGroup groupBefore, groupAfter;
+    groupBefore.ensureStorageAllocated(selection.getNumSelected());
+    groupAfter.ensureStorageAllocated(selection.getNumSelected());
     
     for (int i = 0; i < selection.getNumSelected(); ++i)
     {
@@ -1378,6 +1710,8 @@ void PianoRollToolbox::fadeOutVolume(Lasso &selection, float factor, bool should
     float maxBeat = -FLT_MAX;
     bool didCheckpoint = false;
     PianoChangeGroup groupBefore, groupAfter;
+    groupBefore.ensureStorageAllocated(selection.getNumSelected());
+    groupAfter.ensureStorageAllocated(selection.getNumSelected());
     
     for (int i = 0; i < selection.getNumSelected(); ++i)
     {
@@ -1439,6 +1773,8 @@ void PianoRollToolbox::changeVolumeLinear(Lasso &selection, float volumeDelta)
         jassert(pianoLayer);
 
         PianoChangeGroup groupBefore, groupAfter;
+        groupBefore.ensureStorageAllocated(layerSelection->size());
+        groupAfter.ensureStorageAllocated(layerSelection->size());
 
         for (int i = 0; i < layerSelection->size(); ++i)
         {
@@ -1466,6 +1802,8 @@ void PianoRollToolbox::changeVolumeMultiplied(Lasso &selection, float volumeFact
         jassert(pianoLayer);
 
         PianoChangeGroup groupBefore, groupAfter;
+        groupBefore.ensureStorageAllocated(layerSelection->size());
+        groupAfter.ensureStorageAllocated(layerSelection->size());
         
         //const double t1 = Time::getMillisecondCounterHiRes();
         
@@ -1511,6 +1849,8 @@ void PianoRollToolbox::changeVolumeSine(Lasso &selection, float volumeFactor)
         jassert(pianoLayer);
         
         PianoChangeGroup groupBefore, groupAfter;
+        groupBefore.ensureStorageAllocated(layerSelection->size());
+        groupAfter.ensureStorageAllocated(layerSelection->size());
         
         for (int i = 0; i < layerSelection->size(); ++i)
         {
@@ -1550,6 +1890,7 @@ void PianoRollToolbox::deleteSelection(Lasso &selection)
         jassert(pianoLayer);
         
         PianoChangeGroup notesToDelete;
+        notesToDelete.ensureStorageAllocated(layerSelection->size());
         
         for (int i = 0; i < layerSelection->size(); ++i)
         {
@@ -1557,10 +1898,7 @@ void PianoRollToolbox::deleteSelection(Lasso &selection)
             notesToDelete.add(nc->getNote());
         }
         
-        for (auto && i : notesToDelete)
-        {
-            pianoLayer->remove(i, true);
-        }
+        pianoLayer->removeGroup(notesToDelete, true);
     }
 }
 
@@ -1583,6 +1921,8 @@ void PianoRollToolbox::shiftKeyRelative(Lasso &selection,
 
         const int numSelected = layerSelection->size();
         PianoChangeGroup groupBefore, groupAfter;
+        groupBefore.ensureStorageAllocated(numSelected);
+        groupAfter.ensureStorageAllocated(numSelected);
         
         for (int i = 0; i < numSelected; ++i)
         {
@@ -1633,6 +1973,8 @@ void PianoRollToolbox::shiftBeatRelative(Lasso &selection, float deltaBeat, bool
 
         const int numSelected = layerSelection->size();
         PianoChangeGroup groupBefore, groupAfter;
+        groupBefore.ensureStorageAllocated(numSelected);
+        groupAfter.ensureStorageAllocated(numSelected);
         
         for (int i = 0; i < numSelected; ++i)
         {
@@ -1678,13 +2020,20 @@ void PianoRollToolbox::inverseChord(Lasso &selection,
 
         const int numSelected = layerSelection->size();
         
-        // step 1. sort selection
+        // step 1. sort selection (once, instead of inserting each note in a sorted position)
         PianoChangeGroup selectedNotes;
+        selectedNotes.ensureStorageAllocated(numSelected);
         
         for (int i = 0; i < numSelected; ++i)
         {
             NoteComponent *nc = static_cast<NoteComponent *>(layerSelection->getUnchecked(i));
-            selectedNotes.addSorted(nc->getNote(), nc->getNote());
+            selectedNotes.add(nc->getNote());
+        }
+        
+        if (numSelected > 0)
+        {
+            Note comparator(selectedNotes.getReference(0));
+            selectedNotes.sort(comparator);
         }
         
         // step 2. detect target keys (upper or lower)
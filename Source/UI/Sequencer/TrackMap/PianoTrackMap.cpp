@@ -25,62 +25,6 @@
 #include "AnnotationEvent.h"
 #include "MidiTrack.h"
 
-class TrackMapNoteComponent : public Component
-{
-public:
-
-    TrackMapNoteComponent(PianoTrackMap &parent, const Note &event) :
-        note(event),
-        map(parent),
-        dx(0.f),
-        dw(0.f)
-    {
-        this->setOpaque(false);
-        this->setInterceptsMouseClicks(false, false);
-        this->setWantsKeyboardFocus(false);
-        this->setPaintingIsUnclipped(true);
-    }
-
-    inline int getKey() const noexcept           { return this->note.getKey(); }
-    inline float getBeat() const noexcept        { return this->note.getBeat(); }
-    inline float getLength() const noexcept      { return this->note.getLength(); }
-    inline float getVelocity() const noexcept    { return this->note.getVelocity(); }
-
-    void setRealBounds(float x, int y, float w, int h)
-    {
-#if HELIO_DESKTOP
-        this->dx = x - float(int(x));
-        this->dw = w - float(int(w));
-#endif
-        this->setBounds(int(x), y, int(w), h);
-    }
-    
-    void paint(Graphics &g) override
-    {
-        g.setColour(this->note.getColour().
-                    interpolatedWith(Colours::white, .35f).
-                    withAlpha(this->note.getVelocity() * .3f + .4f));
-
-#if HELIO_DESKTOP
-        g.drawHorizontalLine(0, this->dx, float(this->getWidth()) + this->dw + this->dx);
-#elif HELIO_MOBILE
-        g.drawHorizontalLine(0, 0, float(this->getWidth()));
-#endif
-    }
-
-private:
-
-    const Note &note;
-
-    PianoTrackMap &map;
-    
-    float dx;
-    
-    float dw;
-
-};
-
-
 PianoTrackMap::PianoTrackMap(ProjectTreeItem &parentProject, HybridRoll &parentRoll) :
     project(parentProject),
     roll(parentRoll),
@@ -88,11 +32,11 @@ PianoTrackMap::PianoTrackMap(ProjectTreeItem &parentProject, HybridRoll &parentR
     projectLastBeat(0.f),
     rollFirstBeat(0.f),
     rollLastBeat(0.f),
-    componentHeight(1.f)
+    mapImageIsOutdated(true),
+    hasDirtyRows(false)
 {
     this->setOpaque(false);
     this->setInterceptsMouseClicks(false, false);
-    this->reloadTrackMap();
     this->project.addListener(this);
 }
 
@@ -106,18 +50,38 @@ PianoTrackMap::~PianoTrackMap()
 // Component
 //===----------------------------------------------------------------------===//
 
-void PianoTrackMap::resized()
+void PianoTrackMap::paint(Graphics &g)
 {
-    this->componentHeight = float(this->getHeight()) / 128.f;
-    
-    this->setVisible(false);
+    if (this->getWidth() <= 0 || this->getHeight() <= 0 ||
+        this->rollLastBeat <= this->rollFirstBeat)
+    {
+        return;
+    }
+
+    // While the scroller animates the bounds, the image is only scaled;
+    // it is redrawn at the new size when it gets too blurry or too coarse
+    const float scaleX = this->mapImage.isValid() ?
+        float(this->getWidth()) / float(this->mapImage.getWidth()) : 0.f;
 
-    for (int i = 0; i < this->eventComponents.size(); ++i)
+    if (this->mapImageIsOutdated ||
+        this->mapImage.getHeight() != this->getHeight() ||
+        scaleX < 0.5f || scaleX > 2.f)
     {
-        this->applyNoteBounds(this->eventComponents.getUnchecked(i));
+        this->reloadTrackMap();
     }
+    else if (this->hasDirtyRows)
+    {
+        this->redrawDirtyRows();
+    }
+
+    g.setImageResamplingQuality(Graphics::mediumResamplingQuality);
+    g.drawImageTransformed(this->mapImage,
+        AffineTransform::scale(float(this->getWidth()) / float(this->mapImage.getWidth()), 1.f));
+}
 
-    this->setVisible(true);
+void PianoTrackMap::resized()
+{
+    this->repaint();
 }
 
 
@@ -129,56 +93,38 @@ void PianoTrackMap::onChangeMidiEvent(const MidiEvent &oldEvent, const MidiEvent
 {
     if (!dynamic_cast<const Note *>(&oldEvent)) { return; }
 
-    const Note &note = static_cast<const Note &>(oldEvent);
-    const Note &newNote = static_cast<const Note &>(newEvent);
-
-    if (TrackMapNoteComponent *component = this->componentsHashTable[note])
-    {
-        //component->setVisible(false);
-        this->applyNoteBounds(component);
-        //component->repaint(); // for volume changes
-        //component->setVisible(true);
-
-        this->componentsHashTable.set(newNote, component);
-    }
+    this->invalidateNote(static_cast<const Note &>(oldEvent));
+    this->invalidateNote(static_cast<const Note &>(newEvent));
+    this->repaint();
 }
 
 void PianoTrackMap::onAddMidiEvent(const MidiEvent &event)
 {
     if (!dynamic_cast<const Note *>(&event)) { return; }
 
-    const Note &note = static_cast<const Note &>(event);
-
-    auto component = new TrackMapNoteComponent(*this, note);
-    this->addAndMakeVisible(component);
-    this->applyNoteBounds(component);
-    component->toFront(false);
-
-    //this->eventAnimator.fadeIn(component, 150);
-    this->eventComponents.add(component);
-
-    this->componentsHashTable.set(note, component);
+    if (! this->mapImageIsOutdated && this->mapImage.isValid())
+    {
+        // nothing to erase, so just draw it over
+        Graphics g(this->mapImage);
+        this->drawNote(g, static_cast<const Note &>(event));
+        this->repaint();
+    }
 }
 
 void PianoTrackMap::onRemoveMidiEvent(const MidiEvent &event)
 {
     if (!dynamic_cast<const Note *>(&event)) { return; }
 
-    const Note &note = static_cast<const Note &>(event);
-
-    if (TrackMapNoteComponent *component = this->componentsHashTable[note])
-    {
-        //this->eventAnimator.fadeOut(component, 150);
-        this->removeChildComponent(component);
-        this->componentsHashTable.remove(note);
-        this->eventComponents.removeObject(component, true);
-    }
+    this->invalidateNote(static_cast<const Note &>(event));
+    this->repaint();
 }
 
 void PianoTrackMap::onChangeTrackProperties(MidiTrack *const track)
 {
     if (!dynamic_cast<const PianoSequence *>(track->getSequence())) { return; }
 
+    // colour might have changed
+    this->mapImageIsOutdated = true;
     this->repaint();
 }
 
@@ -186,8 +132,8 @@ void PianoTrackMap::onResetTrackContent(MidiTrack *const track)
 {
     if (!dynamic_cast<const PianoSequence *>(track->getSequence())) { return; }
 
-    this->reloadTrackMap();
-
+    this->mapImageIsOutdated = true;
+    this->repaint();
 }
 
 void PianoTrackMap::onAddTrack(MidiTrack *const track)
@@ -196,7 +142,8 @@ void PianoTrackMap::onAddTrack(MidiTrack *const track)
 
     if (track->getSequence()->size() > 0)
     {
-        this->reloadTrackMap();
+        this->mapImageIsOutdated = true;
+        this->repaint();
     }
 }
 
@@ -206,15 +153,10 @@ void PianoTrackMap::onRemoveTrack(MidiTrack *const track)
 
     for (int i = 0; i < track->getSequence()->size(); ++i)
     {
-        const Note &note = static_cast<const Note &>(*track->getSequence()->getUnchecked(i));
-
-        if (TrackMapNoteComponent *component = this->componentsHashTable[note])
-        {
-            this->removeChildComponent(component);
-            this->componentsHashTable.remove(note);
-            this->eventComponents.removeObject(component, true);
-        }
+        this->invalidateNote(static_cast<const Note &>(*track->getSequence()->getUnchecked(i)));
     }
+
+    this->repaint();
 }
 
 void PianoTrackMap::onChangeProjectBeatRange(float firstBeat, float lastBeat)
@@ -227,7 +169,8 @@ void PianoTrackMap::onChangeViewBeatRange(float firstBeat, float lastBeat)
 {
     this->rollFirstBeat = firstBeat;
     this->rollLastBeat = lastBeat;
-    this->resized();
+    this->mapImageIsOutdated = true;
+    this->repaint();
 }
 
 
@@ -237,52 +180,116 @@ void PianoTrackMap::onChangeViewBeatRange(float firstBeat, float lastBeat)
 
 void PianoTrackMap::reloadTrackMap()
 {
-    for (int i = 0; i < this->eventComponents.size(); ++i)
+    if (this->mapImage.getWidth() != this->getWidth() ||
+        this->mapImage.getHeight() != this->getHeight())
     {
-        this->removeChildComponent(this->eventComponents.getUnchecked(i));
+        this->mapImage = Image(Image::ARGB, this->getWidth(), this->getHeight(), true);
+    }
+    else
+    {
+        this->mapImage.clear(this->mapImage.getBounds());
     }
 
-    this->eventComponents.clear();
-    this->componentsHashTable.clear();
+    this->dirtyRows.clearQuick();
+    this->dirtyRows.insertMultiple(0, Range<int>(), this->mapImage.getHeight());
+    this->hasDirtyRows = false;
+    this->mapImageIsOutdated = false;
 
-    const auto &tracks = this->project.getTracks();
+    Graphics g(this->mapImage);
 
-    this->setVisible(false);
+    for (auto track : this->project.getTracks())
+    {
+        if (!dynamic_cast<const PianoSequence *>(track->getSequence())) { continue; }
 
-    for (auto track : tracks)
+        for (const auto event : *track->getSequence())
+        {
+            this->drawNote(g, static_cast<const Note &>(*event));
+        }
+    }
+}
+
+void PianoTrackMap::redrawDirtyRows()
+{
+    for (int y = 0; y < this->dirtyRows.size(); ++y)
     {
-        for (int j = 0; j < track->getSequence()->size(); ++j)
+        const Range<int> &dirtyRange = this->dirtyRows.getReference(y);
+        if (! dirtyRange.isEmpty())
         {
-            MidiEvent *event = track->getSequence()->getUnchecked(j);
+            this->mapImage.clear({ dirtyRange.getStart(), y, dirtyRange.getLength(), 1 });
+        }
+    }
 
-            if (Note *note = dynamic_cast<Note *>(event))
-            {
-                auto noteComponent = new TrackMapNoteComponent(*this, *note);
+    Graphics g(this->mapImage);
+
+    for (auto track : this->project.getTracks())
+    {
+        if (!dynamic_cast<const PianoSequence *>(track->getSequence())) { continue; }
+
+        for (const auto event : *track->getSequence())
+        {
+            const Note &note = static_cast<const Note &>(*event);
+            const Rectangle<int> bounds(this->getNoteBounds(note).getSmallestIntegerContainer());
 
-                this->eventComponents.add(noteComponent);
-                this->componentsHashTable.set(*note, noteComponent);
+            if (! isPositiveAndBelow(bounds.getY(), this->dirtyRows.size()))
+            { continue; }
 
-                //const bool &belongsToActiveLayer = noteComponent->belongsToLayer(this->activeLayer);
-                //noteComponent->setActive(belongsToActiveLayer);
-                this->addAndMakeVisible(noteComponent);
+            const Range<int> &dirtyRange = this->dirtyRows.getReference(bounds.getY());
+            if (dirtyRange.intersects(bounds.getHorizontalRange()))
+            {
+                // only touch the cleared pixels, the rest are already drawn
+                Graphics::ScopedSaveState state(g);
+                g.reduceClipRegion(dirtyRange.getStart(), bounds.getY(), dirtyRange.getLength(), 1);
+                this->drawNote(g, note);
             }
         }
     }
 
-    this->resized();
-    this->setVisible(true);
+    for (auto &dirtyRange : this->dirtyRows)
+    {
+        dirtyRange = Range<int>();
+    }
+
+    this->hasDirtyRows = false;
 }
 
-void PianoTrackMap::applyNoteBounds(TrackMapNoteComponent *nc)
+Rectangle<float> PianoTrackMap::getNoteBounds(const Note &note) const
 {
     const float rollLengthInBeats = (this->rollLastBeat - this->rollFirstBeat);
-    const float projectLengthInBeats = (this->projectLastBeat - this->projectFirstBeat);
+    const float mapWidth = float(this->mapImage.getWidth());
+    const float mapHeight = float(this->mapImage.getHeight());
+
+    const float x = mapWidth * ((note.getBeat() - this->rollFirstBeat) / rollLengthInBeats);
+    const float w = mapWidth * (note.getLength() / rollLengthInBeats);
+    const int y = int(mapHeight) - int(note.getKey() * (mapHeight / 128.f));
 
-    const float beat = (nc->getBeat() - this->rollFirstBeat);
-    const float mapWidth = float(this->getWidth()) * (projectLengthInBeats / rollLengthInBeats);
+    return { x, float(y), jmax(1.f, w), 1.f };
+}
+
+void PianoTrackMap::drawNote(Graphics &g, const Note &note) const
+{
+    g.setColour(note.getColour().
+                interpolatedWith(Colours::white, .35f).
+                withAlpha(note.getVelocity() * .3f + .4f));
+
+    g.fillRect(this->getNoteBounds(note));
+}
+
+void PianoTrackMap::invalidateNote(const Note &note)
+{
+    if (this->mapImageIsOutdated || ! this->mapImage.isValid())
+    {
+        return; // will be redrawn completely anyway
+    }
+
+    const Rectangle<int> bounds(this->getNoteBounds(note).getSmallestIntegerContainer());
+    const Range<int> noteRange(bounds.getHorizontalRange().getIntersectionWith({ 0, this->mapImage.getWidth() }));
+
+    if (! isPositiveAndBelow(bounds.getY(), this->dirtyRows.size()) || noteRange.isEmpty())
+    {
+        return;
+    }
 
-    const float x = (mapWidth * (beat / projectLengthInBeats));
-    const float w = (mapWidth * (nc->getLength() / projectLengthInBeats));
-    const int y = this->getHeight() - int(nc->getKey() * this->componentHeight);
-    nc->setRealBounds(x, y, jmax(1.f, w), 1);
+    Range<int> &dirtyRange = this->dirtyRows.getReference(bounds.getY());
+    dirtyRange = dirtyRange.isEmpty() ? noteRange : dirtyRange.getUnionWith(noteRange);
+    this->hasDirtyRows = true;
 }
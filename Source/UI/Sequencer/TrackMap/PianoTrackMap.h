@@ -22,8 +22,10 @@
 
 class HybridRoll;
 class ProjectTreeItem;
-class TrackMapNoteComponent;
 
+// The mini-map of all piano tracks, drawn as a single cached image:
+// note events only redraw the rows they touch, and when the map bounds
+// are animated by the scroller, the image is just scaled and translated
 class PianoTrackMap :
     public Component,
     public ProjectListener
@@ -37,6 +39,7 @@ public:
     // Component
     //===------------------------------------------------------------------===//
 
+    void paint(Graphics &g) override;
     void resized() override;
 
     //===------------------------------------------------------------------===//
@@ -57,8 +60,12 @@ public:
 
 private:
 
-    void applyNoteBounds(TrackMapNoteComponent *nc);
     void reloadTrackMap();
+    void redrawDirtyRows();
+
+    Rectangle<float> getNoteBounds(const Note &note) const;
+    void drawNote(Graphics &g, const Note &note) const;
+    void invalidateNote(const Note &note);
 
     float projectFirstBeat;
     float projectLastBeat;
@@ -66,12 +73,14 @@ private:
     float rollFirstBeat;
     float rollLastBeat;
     
-    float componentHeight;
-    
     HybridRoll &roll;
     ProjectTreeItem &project;
     
-    OwnedArray<TrackMapNoteComponent> eventComponents;
-    HashMap<Note, TrackMapNoteComponent *, NoteHashFunction> componentsHashTable;
+    Image mapImage;
+    bool mapImageIsOutdated;
+
+    // dirty horizontal ranges, one per image row, in image pixels
+    Array<Range<int>> dirtyRows;
+    bool hasDirtyRows;
     
 };
@@ -28,6 +28,7 @@
 
 #include "ProjectTreeItem.h"
 #include "PianoTrackMap.h"
+#include "HelioProfiler.h"
 #include <float.h>
 
 
@@ -222,6 +223,7 @@ void TrackScroller::toggleStretchingMapAlaSublime()
 
 void TrackScroller::resized()
 {
+    HELIO_PROFILE_SCOPE("TrackScroller::resized");
     const auto p = this->getIndicatorBounds();
     const auto hp = p.toType<int>();
     this->helperRectangle->setBounds(hp.withTop(0).withBottom(this->getHeight()));
@@ -237,6 +239,7 @@ void TrackScroller::resized()
 
 void TrackScroller::paintOverChildren(Graphics& g)
 {
+    HELIO_PROFILE_SCOPE("TrackScroller::paintOverChildren");
     g.setColour(this->findColour(TrackScroller::borderDarkLineColourId));
     g.drawHorizontalLine(0, 0.f, float(this->getWidth()));
     
@@ -278,6 +281,7 @@ void TrackScroller::mouseWheelMove(const MouseEvent &event, const MouseWheelDeta
 
 void TrackScroller::onMidiRollMoved(HybridRoll *targetRoll)
 {
+    HELIO_PROFILE_SCOPE("TrackScroller::onMidiRollMoved");
     if (this->roll == targetRoll && !this->isTimerRunning())
     {
         this->triggerAsyncUpdate();
@@ -286,6 +290,7 @@ void TrackScroller::onMidiRollMoved(HybridRoll *targetRoll)
 
 void TrackScroller::onMidiRollResized(HybridRoll *targetRoll)
 {
+    HELIO_PROFILE_SCOPE("TrackScroller::onMidiRollResized");
     if (this->roll == targetRoll && !this->isTimerRunning())
     {
         this->triggerAsyncUpdate();
@@ -371,6 +376,7 @@ void TrackScroller::timerCallback()
 
 void TrackScroller::handleAsyncUpdate()
 {
+    HELIO_PROFILE_SCOPE("TrackScroller::handleAsyncUpdate");
     const auto p = this->getIndicatorBounds();
     const auto hp = p.toType<int>();
     this->helperRectangle->setBounds(hp.withTop(0).withBottom(this->getHeight()));
@@ -64,6 +64,81 @@ HelioTheme::HelioTheme() :
 
 HelioTheme::~HelioTheme()
 {
+    this->cancelRollBgRenders();
+}
+
+//===----------------------------------------------------------------------===//
+// Roll backgrounds cache
+//===----------------------------------------------------------------------===//
+
+class HelioTheme::RollBgRenderJob final : public ThreadPoolJob
+{
+public:
+
+    RollBgRenderJob(HelioTheme &theme, int rowHeight) :
+        ThreadPoolJob("Roll background"),
+        theme(theme),
+        rowHeight(rowHeight) {}
+
+    JobStatus runJob() override
+    {
+        CachedImage::Ptr pattern(PianoRoll::renderRowsPattern(this->theme, this->rowHeight));
+
+        {
+            const SpinLock::ScopedLockType lock(this->theme.rollBgCacheLock);
+            this->theme.rollBgCache.set(this->rowHeight, pattern);
+        }
+
+        // Let the rolls replace their placeholder backgrounds
+        MessageManager::callAsync([]()
+        {
+            for (int i = 0; i < Desktop::getInstance().getNumComponents(); ++i)
+            {
+                Desktop::getInstance().getComponent(i)->repaint();
+            }
+        });
+
+        return jobHasFinished;
+    }
+
+private:
+
+    HelioTheme &theme;
+    const int rowHeight;
+
+};
+
+CachedImage::Ptr HelioTheme::getRollBgCache(int rowHeight)
+{
+    {
+        const SpinLock::ScopedLockType lock(this->rollBgCacheLock);
+        if (this->rollBgCache.contains(rowHeight))
+        {
+            // Will be nullptr while still rendering
+            return this->rollBgCache[rowHeight];
+        }
+
+        this->rollBgCache.set(rowHeight, nullptr);
+    }
+
+    if (this->rollBgRenderer == nullptr)
+    {
+        this->rollBgRenderer = new ThreadPool(1);
+    }
+
+    this->rollBgRenderer->addJob(new RollBgRenderJob(*this, rowHeight), true);
+    return nullptr;
+}
+
+void HelioTheme::cancelRollBgRenders()
+{
+    if (this->rollBgRenderer != nullptr)
+    {
+        this->rollBgRenderer->removeAllJobs(true, 1000);
+    }
+
+    const SpinLock::ScopedLockType lock(this->rollBgCacheLock);
+    this->rollBgCache.clear();
 }
 
 void HelioTheme::drawNoise(Component *target, Graphics &g, float alphaMultiply /*= 1.f*/)
@@ -807,10 +882,19 @@ void HelioTheme::initResources()
 
 void HelioTheme::initColours(const ::ColourScheme &colours)
 {
+    // Renderers read the colours being changed here
+    this->cancelRollBgRenders();
+
     // A hack for icon base colors
     this->setColour(Icons::iconColourId, colours.getIconBaseColour());
     this->setColour(Icons::iconShadowColourId, colours.getIconShadowColour());
 
+    // Only the app's theme is worth pre-rendering icons for, not the theme previews
+    if (App::Helio()->getTheme() == this)
+    {
+        Icons::prerenderAtlas();
+    }
+
     // Sliders
     this->setColour(Slider::rotarySliderOutlineColourId, Colours::transparentBlack);
     this->setColour(Slider::rotarySliderFillColourId, colours.getTextColour());
@@ -931,16 +1015,8 @@ void HelioTheme::updateBackgroundRenders(bool force)
     {
         Icons::clearPrerenderedCache();
         this->getPanelsBgCache().clear();
-        this->getRollBgCache().clear();
+        this->cancelRollBgRenders();
     }
-    
-#if PIANOROLL_HAS_PRERENDERED_BACKGROUND
-    PianoRoll::repaintBackgroundsCache(*this);
-#endif
-
-#if PATTERNROLL_HAS_PRERENDERED_BACKGROUND
-    PatternRoll::repaintBackgroundsCache(*this);
-#endif
 
 #if PANEL_A_HAS_PRERENDERED_BACKGROUND
     PanelBackgroundA::updateRender(*this);
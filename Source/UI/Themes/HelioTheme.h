@@ -216,10 +216,10 @@ public:
         return this->panelsBgCache;
     }
     
-    HashMap<int, CachedImage::Ptr> &getRollBgCache() noexcept
-    {
-        return this->rollBgCache;
-    }
+    // Returns the rows pattern of the given row height, if it is ready;
+    // otherwise starts rendering it in background and returns nullptr,
+    // so that the rolls paint their rows themselves until it is done
+    CachedImage::Ptr getRollBgCache(int rowHeight);
     
 protected:
     
@@ -232,7 +232,12 @@ protected:
     
     HashMap<String, CachedImage::Ptr> panelsBgCache;
     HashMap<int, CachedImage::Ptr> rollBgCache;
-    //HashMap<int, CachedImage::Ptr> iconsCache; // todo?
+    SpinLock rollBgCacheLock;
+
+    class RollBgRenderJob;
+    ScopedPointer<ThreadPool> rollBgRenderer;
+
+    void cancelRollBgRenders();
     
     JUCE_LEAK_DETECTOR(HelioTheme);
 
@@ -20,6 +20,7 @@
 #include "BinaryData.h"
 #include "App.h"
 #include "HelioTheme.h"
+#include "FileUtils.h"
 
 const String Icons::empty = "empty";
 const String Icons::menu = "menu";
@@ -123,8 +124,13 @@ struct BuiltInImageData
 
 static HashMap<String, BuiltInImageData> builtInImages;
 
+static void clearParsedDrawables();
+static void clearIconsAtlas();
+
 void Icons::clearBuiltInImages()
 {
+    clearIconsAtlas();
+    clearParsedDrawables();
     builtInImages.clear();
 }
 
@@ -277,6 +283,42 @@ static const Path extractPathFromDrawable(const Drawable *d)
     return Path();
 }
 
+// Parsing SVG is slow, so every icon is parsed only once,
+// and the renderers make their own copies of the parsed drawables
+static OwnedArray<Drawable> parsedDrawables;
+static HashMap<String, Drawable *> parsedDrawablesByName;
+static CriticalSection parsedDrawablesLock;
+
+static HashMap<String, Path> iconPaths;
+
+static void clearParsedDrawables()
+{
+    const ScopedLock lock(parsedDrawablesLock);
+    parsedDrawablesByName.clear();
+    parsedDrawables.clear();
+    iconPaths.clear();
+}
+
+static Drawable *createDrawableCopy(const String &name)
+{
+    const ScopedLock lock(parsedDrawablesLock);
+
+    if (! parsedDrawablesByName.contains(name))
+    {
+        if (! builtInImages.contains(name))
+        {
+            return nullptr;
+        }
+
+        Drawable *drawable = Drawable::createFromImageData(builtInImages[name].data, builtInImages[name].numBytes);
+        parsedDrawables.add(drawable);
+        parsedDrawablesByName.set(name, drawable);
+    }
+
+    Drawable *drawable = parsedDrawablesByName[name];
+    return (drawable != nullptr) ? drawable->createCopy() : nullptr;
+}
+
 static Image renderVector(const String &name, int maxSize,
     const Colour &iconBaseColour, const Colour &iconShadeColour)
 {
@@ -288,7 +330,12 @@ static Image renderVector(const String &name, int maxSize,
     Image resultImage(Image::ARGB, maxSize, maxSize, true);
     Graphics g(resultImage);
     
-    ScopedPointer<Drawable> drawableSVG(Drawable::createFromImageData(builtInImages[name].data, builtInImages[name].numBytes));
+    ScopedPointer<Drawable> drawableSVG(createDrawableCopy(name));
+    if (drawableSVG == nullptr)
+    {
+        return resultImage;
+    }
+
     drawableSVG->replaceColour(Colours::black, iconBaseColour);
 
     Rectangle<int> area(0, 0, maxSize, maxSize);
@@ -318,76 +365,348 @@ static Image renderVector(const String &name, int maxSize,
 
 ScopedPointer<Drawable> Icons::getDrawableByName(const String &name)
 {
-    if (!builtInImages.contains(name))
+    return createDrawableCopy(name);
+}
+
+Path Icons::getPathByName(const String &name)
+{
+    // the same lock as for the drawables, since both are cleared together
+    const ScopedLock lock(parsedDrawablesLock);
+
+    if (! iconPaths.contains(name))
     {
-        return nullptr;
+        ScopedPointer<Drawable> drawableSVG(createDrawableCopy(name));
+        iconPaths.set(name, (drawableSVG != nullptr) ? extractPathFromDrawable(drawableSVG) : Path());
     }
-    
-    return Drawable::createFromImageData(builtInImages[name].data, builtInImages[name].numBytes);
+
+    return iconPaths[name];
 }
 
-Path Icons::getPathByName(const String &name)
+//===----------------------------------------------------------------------===//
+// Icons atlas
+//===----------------------------------------------------------------------===//
+
+const int kRoundFactor = 8;
+const int kAtlasMaxSize = 64;
+
+static int getRetinaFactor()
 {
-    if (!builtInImages.contains(name))
+#if JUCE_ANDROID
+    return 2;
+#else
+    return int(Desktop::getInstance().getDisplays().getMainDisplay().scale);
+#endif
+}
+
+static int getFixedSize(int maxSize)
+{
+    return int(floorf(float(maxSize) / float(kRoundFactor))) * kRoundFactor * getRetinaFactor();
+}
+
+static String getIconKey(const String &name, int fixedSize)
+{
+    return name + "@" + String(fixedSize);
+}
+
+// All built-in icons pre-rendered for the given colours and display scale
+// in every size up to kAtlasMaxSize: one shelf image per size, one icon after another.
+// Each shelf is saved to the config folder as a png, so the next launch
+// with the same theme only needs to decode the shelves instead of rendering all the vectors;
+// the missing ones are rendered in the background thread.
+class IconsAtlas final : private Thread
+{
+public:
+
+    IconsAtlas() : Thread("Icons atlas") {}
+
+    ~IconsAtlas() override
+    {
+        this->stop();
+    }
+
+    void prerender(const Colour &iconBaseColour, const Colour &iconShadeColour, int retinaFactor)
+    {
+        if (this->matches(iconBaseColour, iconShadeColour, retinaFactor))
+        {
+            return;
+        }
+
+        this->reset();
+
+        this->baseColour = iconBaseColour;
+        this->shadeColour = iconShadeColour;
+        this->scale = retinaFactor;
+
+        StringArray names;
+        for (HashMap<String, BuiltInImageData>::Iterator i(builtInImages); i.next();)
+        {
+            names.add(i.getKey());
+        }
+
+        names.sort(false);
+
+        this->names = names;
+        this->nameIndices.clear();
+        for (int i = 0; i < names.size(); ++i)
+        {
+            this->nameIndices.set(names[i], i);
+        }
+
+        const String hash = String::toHexString((names.joinIntoString(",") +
+            App::getAppReadableVersion() +
+            String(iconBaseColour.getARGB()) +
+            String(iconShadeColour.getARGB())).hashCode64());
+
+        this->filePrefix = "icons-" + hash + "@" + String(retinaFactor) + "x-";
+        this->directory = FileUtils::getConfigSlot(this->filePrefix).getParentDirectory();
+
+        this->removeStaleShelves();
+
+        // Decoding the cached shelves is cheap enough to do it right away
+        for (int size = kRoundFactor; size <= kAtlasMaxSize; size += kRoundFactor)
+        {
+            const int fixedSize = size * retinaFactor;
+            const Image shelf(this->loadCachedShelf(fixedSize));
+
+            const SpinLock::ScopedLockType lock(this->imageLock);
+            if (shelf.isValid())
+            {
+                this->shelves.set(fixedSize, shelf);
+            }
+            else
+            {
+                this->pendingSizes.add(fixedSize);
+            }
+        }
+
+        if (this->pendingSizes.size() > 0)
+        {
+            this->startThread(3);
+        }
+    }
+
+    void reset()
     {
-        return Path();
+        this->stop();
+
+        const SpinLock::ScopedLockType lock(this->imageLock);
+        this->shelves.clear();
+        this->pendingSizes.clearQuick();
+        this->scale = 0;
+    }
+
+    bool matches(const Colour &iconBaseColour, const Colour &iconShadeColour, int retinaFactor) const noexcept
+    {
+        return this->scale == retinaFactor &&
+            this->baseColour == iconBaseColour &&
+            this->shadeColour == iconShadeColour;
     }
 
-    ScopedPointer<Drawable> drawableSVG(Drawable::createFromImageData(builtInImages[name].data, builtInImages[name].numBytes));
-    return Path(extractPathFromDrawable(drawableSVG));
+    // Returns a null image, if there is no such icon in the atlas,
+    // or if its shelf is still being rendered
+    Image find(const String &name, int fixedSize) const
+    {
+        if (! this->nameIndices.contains(name))
+        {
+            return Image();
+        }
+
+        const SpinLock::ScopedLockType lock(this->imageLock);
+
+        if (! this->shelves.contains(fixedSize))
+        {
+            return Image();
+        }
+
+        const Rectangle<int> region(this->nameIndices[name] * fixedSize, 0, fixedSize, fixedSize);
+        return this->shelves[fixedSize].getClippedImage(region);
+    }
+
+private:
+
+    // Lets the thread finish the icon it is rendering, instead of killing it
+    void stop()
+    {
+        this->signalThreadShouldExit();
+        this->waitForThreadToExit(-1);
+    }
+
+    void run() override
+    {
+        while (! this->threadShouldExit())
+        {
+            int fixedSize = 0;
+
+            {
+                const SpinLock::ScopedLockType lock(this->imageLock);
+                if (this->pendingSizes.size() == 0)
+                {
+                    return;
+                }
+
+                fixedSize = this->pendingSizes.getFirst();
+            }
+
+            const Image shelf(this->renderShelf(fixedSize));
+
+            if (! shelf.isValid())
+            {
+                return; // the thread is asked to exit
+            }
+
+            FileOutputStream out(this->getShelfFile(fixedSize));
+            if (out.openedOk())
+            {
+                PNGImageFormat().writeImageToStream(shelf, out);
+            }
+
+            const SpinLock::ScopedLockType lock(this->imageLock);
+            this->shelves.set(fixedSize, shelf);
+            this->pendingSizes.removeFirstMatchingValue(fixedSize);
+        }
+    }
+
+    // Removes the shelves of other themes and scales
+    void removeStaleShelves() const
+    {
+        Array<File> cachedFiles;
+        this->directory.findChildFiles(cachedFiles, File::findFiles, false, "icons-*.png");
+
+        for (auto &cachedFile : cachedFiles)
+        {
+            if (! cachedFile.getFileName().startsWith(this->filePrefix))
+            {
+                cachedFile.deleteFile();
+            }
+        }
+    }
+
+    // Returns a null image, if there is no valid shelf of this size in the cache
+    Image loadCachedShelf(int fixedSize) const
+    {
+        const File shelfFile(this->getShelfFile(fixedSize));
+        if (! shelfFile.existsAsFile())
+        {
+            return Image();
+        }
+
+        const Image cached(ImageFileFormat::loadFrom(shelfFile));
+
+        if (! cached.isValid() ||
+            cached.getWidth() != jmax(1, this->names.size() * fixedSize) ||
+            cached.getHeight() != fixedSize)
+        {
+            shelfFile.deleteFile();
+            return Image();
+        }
+
+        return cached.convertedToFormat(Image::ARGB);
+    }
+
+    // Returns a null image, if the thread is asked to exit
+    Image renderShelf(int fixedSize) const
+    {
+        Image shelf(Image::ARGB, jmax(1, this->names.size() * fixedSize), fixedSize, true);
+        Graphics g(shelf);
+
+        for (int i = 0; i < this->names.size(); ++i)
+        {
+            if (this->threadShouldExit())
+            {
+                return Image();
+            }
+
+            const Image icon(renderVector(this->names[i], fixedSize, this->baseColour, this->shadeColour));
+            g.drawImageAt(icon, i * fixedSize, 0);
+        }
+
+        return shelf;
+    }
+
+    File getShelfFile(int fixedSize) const
+    {
+        return this->directory.getChildFile(this->filePrefix + String(fixedSize) + ".png");
+    }
+
+    Colour baseColour;
+    Colour shadeColour;
+    int scale = 0;
+
+    // only changed while the thread is stopped
+    File directory;
+    String filePrefix;
+    StringArray names;
+    HashMap<String, int> nameIndices;
+
+    mutable SpinLock imageLock;
+    HashMap<int, Image> shelves;
+    Array<int> pendingSizes;
+
+    JUCE_DECLARE_NON_COPYABLE(IconsAtlas)
+};
+
+static IconsAtlas iconsAtlas;
+
+static void clearIconsAtlas()
+{
+    iconsAtlas.reset();
 }
 
+// Icons for non-atlas sizes and colours are rendered on demand and cached here
 static HashMap<String, Image> prerenderedVectors;
 
+void Icons::prerenderAtlas()
+{
+    iconsAtlas.prerender(App::Helio()->getTheme()->findColour(Icons::iconColourId),
+        App::Helio()->getTheme()->findColour(Icons::iconShadowColourId),
+        getRetinaFactor());
+}
+
 void Icons::clearPrerenderedCache()
 {
     prerenderedVectors.clear();
 }
 
-const int kRoundFactor = 8;
-
-Image Icons::findByName(const String &name, int maxSize)
+static Image findOrRenderIcon(const String &name, int maxSize,
+    const Colour &iconBaseColour, const Colour &iconShadeColour)
 {
-    const Desktop::Displays::Display &dis = Desktop::getInstance().getDisplays().getMainDisplay();
+    const int fixedSize = getFixedSize(maxSize);
 
-#if JUCE_ANDROID
-    const int retinaFactor = 2;
-#else
-    const int retinaFactor = int(dis.scale);
-#endif
+    if (iconsAtlas.matches(iconBaseColour, iconShadeColour, getRetinaFactor()))
+    {
+        const Image image(iconsAtlas.find(name, fixedSize));
+        if (image.isValid())
+        {
+            return image;
+        }
+    }
+
+    const String nameKey = getIconKey(name, fixedSize) +
+        String::toHexString(int(iconBaseColour.getARGB())) +
+        String::toHexString(int(iconShadeColour.getARGB()));
 
-    const int fixedSize = int(floorf(float(maxSize) / float(kRoundFactor))) * kRoundFactor * retinaFactor;
-    const String nameKey = name + "@" + String(fixedSize);
-    
     if (prerenderedVectors.contains(nameKey))
     {
         return prerenderedVectors[nameKey];
     }
-    
-    const Colour iconBaseColour(App::Helio()->getTheme()->findColour(Icons::iconColourId));
-    const Colour iconShadeColour(App::Helio()->getTheme()->findColour(Icons::iconShadowColourId));
+
     Image prerenderedImage = renderVector(name, fixedSize, iconBaseColour, iconShadeColour);
     prerenderedVectors.set(nameKey, prerenderedImage);
-
     return prerenderedImage;
 }
 
-Image Icons::findByName(const String &name, int maxSize, LookAndFeel &lf)
+Image Icons::findByName(const String &name, int maxSize)
 {
-    const Desktop::Displays::Display &dis = Desktop::getInstance().getDisplays().getMainDisplay();
-
-#if JUCE_ANDROID
-    const int retinaFactor = 2;
-#else
-    const int retinaFactor = int(dis.scale);
-#endif
-
-    const int fixedSize = int(floorf(float(maxSize) / float(kRoundFactor))) * kRoundFactor * retinaFactor;
+    return findOrRenderIcon(name, maxSize,
+        App::Helio()->getTheme()->findColour(Icons::iconColourId),
+        App::Helio()->getTheme()->findColour(Icons::iconShadowColourId));
+}
 
-    const Colour iconBaseColour(lf.findColour(Icons::iconColourId));
-    const Colour iconShadeColour(lf.findColour(Icons::iconShadowColourId));
-    Image prerenderedImage = renderVector(name, fixedSize, iconBaseColour, iconShadeColour);
-    return prerenderedImage;
+Image Icons::findByName(const String &name, int maxSize, LookAndFeel &lf)
+{
+    return findOrRenderIcon(name, maxSize,
+        lf.findColour(Icons::iconColourId),
+        lf.findColour(Icons::iconShadowColourId));
 }
 
 void Icons::drawImageRetinaAware(const Image &image, Graphics &g, int cx, int cy)
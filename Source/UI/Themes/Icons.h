@@ -123,6 +123,7 @@ public:
     static void clearBuiltInImages();
     static void setupBuiltInImages();
     
+    static void prerenderAtlas();
     static void clearPrerenderedCache();
     
     static Image findByName(const String &name, int maxSize);